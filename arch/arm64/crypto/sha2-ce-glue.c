@@ -32,6 +32,10 @@ struct sha256_ce_state {
 asmlinkage void sha2_ce_transform(struct sha256_ce_state *sst, u8 const *src,
 				  int blocks);
 
+asmlinkage void sha2_ce_transform2x(u32 *state_a, u32 *state_b,
+				    u8 const *src_a, u8 const *src_b,
+				    int blocks);
+
 static int sha256_ce_update(struct shash_desc *desc, const u8 *data,
 			    unsigned int len)
 {
@@ -73,6 +77,72 @@ static int sha256_ce_finup(struct shash_desc *desc, const u8 *data,
 	return sha256_base_finish(desc, out);
 }
 
+/*
+ * Two messages of the same length on top of the same state, as dm-verity
+ * hashes its salted data blocks, interleaved through sha2_ce_transform2x.
+ * The partial block left in the state and the padding are assembled here,
+ * so the asm only ever sees whole blocks.
+ */
+static int sha256_ce_finup_mb(struct shash_desc *desc,
+			      const u8 * const data[], unsigned int len,
+			      u8 * const outs[], unsigned int num_msgs)
+{
+	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
+	unsigned int partial = sctx->sst.count % SHA256_BLOCK_SIZE;
+	u64 bits = (sctx->sst.count + len) << 3;
+	u8 buf[2][2 * SHA256_BLOCK_SIZE];
+	u32 state[2][SHA256_DIGEST_SIZE / 4];
+	const u8 *src[2] = { data[0], data[1] };
+	unsigned int n, i, j;
+
+	if (WARN_ON_ONCE(num_msgs != 2))
+		return -EOPNOTSUPP;
+	/* short messages are mostly padding, not worth interleaving */
+	if (len < SHA256_BLOCK_SIZE)
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < 2; i++)
+		memcpy(state[i], sctx->sst.state, sizeof(state[i]));
+
+	kernel_neon_begin_partial(28);
+
+	if (partial) {
+		n = SHA256_BLOCK_SIZE - partial;
+		for (i = 0; i < 2; i++) {
+			memcpy(buf[i], sctx->sst.buf, partial);
+			memcpy(buf[i] + partial, src[i], n);
+			src[i] += n;
+		}
+		sha2_ce_transform2x(state[0], state[1], buf[0], buf[1], 1);
+		len -= n;
+	}
+
+	n = len / SHA256_BLOCK_SIZE;
+	if (n) {
+		sha2_ce_transform2x(state[0], state[1], src[0], src[1], n);
+		for (i = 0; i < 2; i++)
+			src[i] += n * SHA256_BLOCK_SIZE;
+		len %= SHA256_BLOCK_SIZE;
+	}
+
+	n = len < SHA256_BLOCK_SIZE - sizeof(bits) ? 1 : 2;
+	for (i = 0; i < 2; i++) {
+		memcpy(buf[i], src[i], len);
+		buf[i][len] = 0x80;
+		memset(buf[i] + len + 1, 0, n * SHA256_BLOCK_SIZE - len - 1);
+		put_unaligned_be64(bits, buf[i] + n * SHA256_BLOCK_SIZE -
+				   sizeof(bits));
+	}
+	sha2_ce_transform2x(state[0], state[1], buf[0], buf[1], n);
+
+	kernel_neon_end();
+
+	for (i = 0; i < 2; i++)
+		for (j = 0; j < crypto_shash_digestsize(desc->tfm) / 4; j++)
+			put_unaligned_be32(state[i][j], outs[i] + j * 4);
+	return 0;
+}
+
 static int sha256_ce_final(struct shash_desc *desc, u8 *out)
 {
 	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
@@ -89,6 +159,8 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
+	.mb_max_msgs		= 2,
 	.descsize		= sizeof(struct sha256_ce_state),
 	.digestsize		= SHA224_DIGEST_SIZE,
 	.base			= {
@@ -104,6 +176,8 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
+	.mb_max_msgs		= 2,
 	.descsize		= sizeof(struct sha256_ce_state),
 	.digestsize		= SHA256_DIGEST_SIZE,
 	.base			= {
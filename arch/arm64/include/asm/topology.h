@@ -43,6 +43,14 @@ extern int arch_better_capacity(unsigned int cpu);
 void arch_build_cpu_topology_domain(void);
 #endif
 
+struct sched_group_energy;
+extern int arch_register_cpu_energy(int cpu,
+				    const struct sched_group_energy *core,
+				    const struct sched_group_energy *cluster);
+/* enabled once a registered energy model is in the sched domains */
+struct static_key_false;
+extern struct static_key_false arch_cpu_energy_key;
+
 #ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
 extern inline
 int mtk_idle_power(int idle_state, int cid, void *argu, int);
@@ -13,13 +13,16 @@
 
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
+#include <linux/cpuset.h>
 #include <linux/init.h>
+#include <linux/jump_label.h>
 #include <linux/percpu.h>
 #include <linux/node.h>
 #include <linux/nodemask.h>
 #include <linux/of.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <asm/cputype.h>
 #include <asm/topology.h>
@@ -675,6 +678,41 @@ static struct sched_group_energy energy_core_2 = {
 #endif
 };
 
+/*
+ * Energy model registered at runtime by the platform cpufreq driver. It is
+ * built from the real OPP table and voltages and overrides the static tables
+ * above once present.
+ */
+static const struct sched_group_energy *plat_energy_core[3];
+static const struct sched_group_energy *plat_energy_cluster[3];
+
+DEFINE_STATIC_KEY_FALSE(arch_cpu_energy_key);
+
+static void plat_energy_rebuild_fn(struct work_struct *work)
+{
+	rebuild_sched_domains();
+	static_branch_enable(&arch_cpu_energy_key);
+}
+static DECLARE_WORK(plat_energy_rebuild_work, plat_energy_rebuild_fn);
+
+int arch_register_cpu_energy(int cpu, const struct sched_group_energy *core,
+			     const struct sched_group_energy *cluster)
+{
+	int cluster_id = cpu_topology[cpu].cluster_id;
+
+	if (cluster_id < 0 || cluster_id >= ARRAY_SIZE(plat_energy_core))
+		return -EINVAL;
+
+	WRITE_ONCE(plat_energy_core[cluster_id], core);
+	WRITE_ONCE(plat_energy_cluster[cluster_id], cluster);
+
+	/* sched groups cache their sge pointer, rebuild them to pick it up */
+	schedule_work(&plat_energy_rebuild_work);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(arch_register_cpu_energy);
+
 /* sd energy functions */
 inline
 const struct sched_group_energy *cpu_cluster_energy(int cpu)
@@ -687,6 +725,10 @@ const struct sched_group_energy *cpu_cluster_energy(int cpu)
 	struct upower_tbl *ptr_tbl;
 #endif
 
+	if (cluster_id >= 0 && cluster_id < ARRAY_SIZE(plat_energy_cluster) &&
+	    plat_energy_cluster[cluster_id])
+		return plat_energy_cluster[cluster_id];
+
 	if (cluster_id == 0)
 		cpu_cluster_ptr = &energy_cluster_0;
 	else if (cluster_id == 1)
@@ -721,6 +763,10 @@ const struct sched_group_energy *cpu_core_energy(int cpu)
 	struct upower_tbl *ptr_tbl;
 #endif
 
+	if (cluster_id >= 0 && cluster_id < ARRAY_SIZE(plat_energy_core) &&
+	    plat_energy_core[cluster_id])
+		return plat_energy_core[cluster_id];
+
 	if (cluster_id == 0)
 		cpu_core_ptr = &energy_core_0;
 	else if (cluster_id == 1)
@@ -166,6 +166,36 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	struct shash_alg *shash = crypto_shash_alg(tfm);
+	unsigned int i;
+	int err;
+
+	if (num_msgs > 1 && num_msgs <= shash->mb_max_msgs) {
+		err = shash->finup_mb(desc, data, len, outs, num_msgs);
+		if (err != -EOPNOTSUPP)
+			return err;
+	}
+
+	for (i = 0; i < num_msgs; i++) {
+		SHASH_DESC_ON_STACK(d, tfm);
+
+		d->tfm = tfm;
+		d->flags = desc->flags;
+		memcpy(shash_desc_ctx(d), shash_desc_ctx(desc),
+		       crypto_shash_descsize(tfm));
+		err = crypto_shash_finup(d, data[i], len, outs[i]);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_digest_unaligned(struct shash_desc *desc, const u8 *data,
 				  unsigned int len, u8 *out)
 {
@@ -605,6 +635,9 @@ static int shash_prepare_alg(struct shash_alg *alg)
 	}
 	if (!alg->setkey)
 		alg->setkey = shash_no_setkey;
+	/* the buffers of finup_mb are not realigned */
+	if (!alg->finup_mb || !alg->mb_max_msgs || base->cra_alignmask)
+		alg->mb_max_msgs = 1;
 
 	return 0;
 }
@@ -135,7 +135,8 @@ static bool driver_deferred_probe_enable = false;
  *
  * This functions moves all devices from the pending list to the active
  * list and schedules the deferred probe workqueue to process them.  It
- * should be called anytime a driver is successfully bound to a device.
+ * should be called anytime a driver is successfully bound to a device,
+ * and when the probes held back until the end of boot are released.
  *
  * Note, there is a race condition in multi-threaded probe. In the case where
  * more than one device is probing at the same time, it is possible for one
@@ -148,7 +149,7 @@ static bool driver_deferred_probe_enable = false;
  * changes in the midst of a probe, then deferred processing should be triggered
  * again.
  */
-static void driver_deferred_probe_trigger(void)
+void driver_deferred_probe_trigger(void)
 {
 	if (!driver_deferred_probe_enable)
 		return;
@@ -280,6 +281,7 @@ EXPORT_SYMBOL_GPL(device_bind_driver);
 #define TIME_LOG_START()
 #define TIME_LOG_END()
 #define bootprof_probe(ts, dev, drv, probe)
+#define bootprof_probe_held(drv) false
 #endif
 
 static atomic_t probe_count = ATOMIC_INIT(0);
@@ -434,10 +436,25 @@ EXPORT_SYMBOL_GPL(wait_for_device_probe);
 int driver_probe_device(struct device_driver *drv, struct device *dev)
 {
 	int ret = 0;
+	int local_trigger_count = atomic_read(&deferred_trigger_count);
 
 	if (!device_is_registered(dev))
 		return -ENODEV;
 
+	/*
+	 * Drivers that are not needed to reach the launcher wait on the
+	 * deferred probe list until bootprof sees the end of boot.
+	 */
+	if (bootprof_probe_held(drv)) {
+		dev_dbg(dev, "probe of %s held until boot completes\n",
+			drv->name);
+		driver_deferred_probe_add(dev);
+		/* Released while we were adding it? */
+		if (local_trigger_count != atomic_read(&deferred_trigger_count))
+			driver_deferred_probe_trigger();
+		return 0;
+	}
+
 	pr_debug("bus: '%s': %s: matched device %s with driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
 
@@ -454,6 +471,24 @@ int driver_probe_device(struct device_driver *drv, struct device *dev)
 	return ret;
 }
 
+/*
+ * driver_async_probe= takes a comma separated list of driver names that
+ * are probed from the async domain, in parallel with the rest of the
+ * initcalls, as if they had set PROBE_PREFER_ASYNCHRONOUS.
+ */
+#define ASYNC_DRV_NAMES_MAX_LEN	256
+static char async_probe_drv_names[ASYNC_DRV_NAMES_MAX_LEN];
+
+static int __init save_async_options(char *buf)
+{
+	if (strlen(buf) >= ASYNC_DRV_NAMES_MAX_LEN)
+		pr_warn("Too long list of driver names for 'driver_async_probe'!\n");
+
+	strlcpy(async_probe_drv_names, buf, ASYNC_DRV_NAMES_MAX_LEN);
+	return 1;
+}
+__setup("driver_async_probe=", save_async_options);
+
 bool driver_allows_async_probing(struct device_driver *drv)
 {
 	switch (drv->probe_type) {
@@ -467,6 +502,9 @@ bool driver_allows_async_probing(struct device_driver *drv)
 		if (module_requested_async_probing(drv->owner))
 			return true;
 
+		if (parse_option_str(async_probe_drv_names, drv->name))
+			return true;
+
 		return false;
 	}
 }
@@ -14,15 +14,18 @@
 
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/i2c.h>
+#include <linux/i2c-mt65xx.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -31,6 +34,7 @@
 #include <linux/platform_device.h>
 #include <linux/scatterlist.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 
 #define I2C_RS_TRANSFER			(1 << 4)
@@ -81,6 +85,26 @@
 
 #define I2C_DRV_NAME		"i2c-mt65xx"
 
+/* clock stretching and start/stop overhead on top of the bus time */
+#define I2C_POLL_SLACK_US	20
+
+#define I2C_LAT_BUCKETS		12	/* <1us .. <1024us, more */
+
+enum mtk_i2c_xfer_mode {
+	I2C_MODE_POLL,
+	I2C_MODE_IRQ,
+	I2C_MODE_DMA,
+	I2C_MODES,
+};
+
+/*
+ * FIFO transfers expected to finish within this many microseconds are
+ * busy-waited instead of sleeping on the interrupt, 0 disables polling.
+ */
+static unsigned int poll_max_us = 250;
+module_param(poll_max_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(poll_max_us, "Longest FIFO transfer to busy-wait for (us)");
+
 enum DMA_REGS_OFFSET {
 	OFFSET_INT_FLAG = 0x0,
 	OFFSET_INT_EN = 0x04,
@@ -169,7 +193,13 @@ struct mtk_i2c {
 	u16 high_speed_reg;
 	unsigned char auto_restart;
 	bool ignore_restart_irq;
+	bool batch;			/* clocks held by a transfer batch */
 	const struct mtk_i2c_compatible *dev_comp;
+
+	/* latency of each transaction, by mode */
+	u32 lat_hist[I2C_MODES][I2C_LAT_BUCKETS];
+	u32 poll_timeouts;
+	struct dentry *debugfs;
 };
 
 static const struct i2c_adapter_quirks mt6577_i2c_quirks = {
@@ -433,9 +463,51 @@ static inline u32 mtk_i2c_set_4g_mode(dma_addr_t addr)
 	return (addr & BIT_ULL(32)) ? I2C_DMA_4G_MODE : I2C_DMA_CLR_FLAG;
 }
 
+/*
+ * Bus time of a FIFO transaction in microseconds, 9 clocks for every data
+ * and address byte.
+ */
+static unsigned int mtk_i2c_fifo_time_us(struct mtk_i2c *i2c,
+					 struct i2c_msg *msgs)
+{
+	unsigned int bytes = msgs->len + 1;
+
+	if (i2c->op == I2C_MASTER_WRRD)
+		bytes += (msgs + 1)->len + 1;
+
+	return DIV_ROUND_UP(bytes * 9 * USEC_PER_SEC, i2c->speed_hz);
+}
+
+static bool mtk_i2c_poll_complete(struct mtk_i2c *i2c, u16 restart_flag,
+				  unsigned int timeout_us)
+{
+	u16 intr_stat;
+
+	if (readw_poll_timeout(i2c->base + OFFSET_INTR_STAT, intr_stat,
+			       intr_stat & (I2C_TRANSAC_COMP | restart_flag),
+			       0, timeout_us))
+		return false;
+
+	/* the ack error status is latched until the completion, as in irq */
+	writew(intr_stat, i2c->base + OFFSET_INTR_STAT);
+	i2c->irq_stat |= intr_stat;
+
+	return true;
+}
+
+static void mtk_i2c_account(struct mtk_i2c *i2c, enum mtk_i2c_xfer_mode mode,
+			    ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+
+	i2c->lat_hist[mode][min_t(int, fls64(us), I2C_LAT_BUCKETS - 1)]++;
+}
+
 static int mtk_i2c_do_transfer(struct mtk_i2c *i2c, struct i2c_msg *msgs,
 			       int num, int left_num)
 {
+	ktime_t start = ktime_get();
+	unsigned int poll_us = 0;
 	bool dma_en;
 	u8 *data_buf;
 	u16 data_len;
@@ -483,9 +555,24 @@ static int mtk_i2c_do_transfer(struct mtk_i2c *i2c, struct i2c_msg *msgs,
 	       I2C_TRANSAC_COMP, i2c->base + OFFSET_INTR_STAT);
 	writew(I2C_FIFO_ADDR_CLR, i2c->base + OFFSET_FIFO_ADDR_CLR);
 
+	/*
+	 * Short FIFO transfers complete in less time than it takes to sleep
+	 * and be woken up by the interrupt, so they are polled for.
+	 */
+	if (!i2c->ignore_restart_irq && msgs->len <= I2C_FIFO_SIZE &&
+	    (i2c->op != I2C_MASTER_WRRD || (msgs + 1)->len <= I2C_FIFO_SIZE)) {
+		poll_us = mtk_i2c_fifo_time_us(i2c, msgs);
+		poll_us += poll_us / 2 + I2C_POLL_SLACK_US;
+		if (poll_us > poll_max_us)
+			poll_us = 0;
+	}
+
 	/* Enable interrupt */
-	writew(restart_flag | I2C_HS_NACKERR | I2C_ACKERR |
-	       I2C_TRANSAC_COMP, i2c->base + OFFSET_INTR_MASK);
+	if (!poll_us)
+		writew(restart_flag | I2C_HS_NACKERR | I2C_ACKERR |
+		       I2C_TRANSAC_COMP, i2c->base + OFFSET_INTR_MASK);
+	else
+		writew(0, i2c->base + OFFSET_INTR_MASK);
 
 	/* Set transfer and transaction len */
 	if (i2c->op == I2C_MASTER_WRRD) {
@@ -593,8 +680,23 @@ static int mtk_i2c_do_transfer(struct mtk_i2c *i2c, struct i2c_msg *msgs,
 	if (dma_en && i2c->op == I2C_MASTER_RD)
 		writel(I2C_DMA_START_EN, i2c->pdmabase + OFFSET_EN);
 
-	ret = wait_for_completion_timeout(&i2c->msg_complete,
-					  i2c->adap.timeout);
+	if (poll_us && !mtk_i2c_poll_complete(i2c, restart_flag, poll_us)) {
+		/*
+		 * The slave is stretching the clock, sleep on the interrupt.
+		 * A completion that raced with the timeout is still latched
+		 * in OFFSET_INTR_STAT and fires as soon as it is unmasked.
+		 */
+		i2c->poll_timeouts++;
+		poll_us = 0;
+		writew(restart_flag | I2C_HS_NACKERR | I2C_ACKERR |
+		       I2C_TRANSAC_COMP, i2c->base + OFFSET_INTR_MASK);
+	}
+
+	if (poll_us)
+		ret = 1;
+	else
+		ret = wait_for_completion_timeout(&i2c->msg_complete,
+						  i2c->adap.timeout);
 
 	/* Clear interrupt mask */
 	writew(~(restart_flag | I2C_HS_NACKERR | I2C_ACKERR |
@@ -615,6 +717,9 @@ static int mtk_i2c_do_transfer(struct mtk_i2c *i2c, struct i2c_msg *msgs,
 		}
 	}
 
+	mtk_i2c_account(i2c, dma_en ? I2C_MODE_DMA :
+			poll_us ? I2C_MODE_POLL : I2C_MODE_IRQ, start);
+
 	if (ret == 0) {
 		dev_dbg(i2c->dev, "addr: %x, transfer timeout\n", msgs->addr);
 		mtk_i2c_init_hw(i2c);
@@ -657,9 +762,11 @@ static int mtk_i2c_transfer(struct i2c_adapter *adap,
 	int left_num = num;
 	struct mtk_i2c *i2c = i2c_get_adapdata(adap);
 
-	ret = mtk_i2c_clock_enable(i2c);
-	if (ret)
-		return ret;
+	if (!i2c->batch) {
+		ret = mtk_i2c_clock_enable(i2c);
+		if (ret)
+			return ret;
+	}
 
 	i2c->auto_restart = i2c->dev_comp->auto_restart;
 
@@ -710,7 +817,8 @@ static int mtk_i2c_transfer(struct i2c_adapter *adap,
 	ret = num;
 
 err_exit:
-	mtk_i2c_clock_disable(i2c);
+	if (!i2c->batch)
+		mtk_i2c_clock_disable(i2c);
 	return ret;
 }
 
@@ -756,6 +864,120 @@ static const struct i2c_algorithm mtk_i2c_algorithm = {
 	.functionality = mtk_i2c_functionality,
 };
 
+/**
+ * mtk_i2c_transfer_batch - run independent transactions in one window
+ * @adap: adapter to use
+ * @msgs: messages of all the transactions, back to back
+ * @nums: number of messages in each transaction
+ * @nr: number of transactions
+ *
+ * Every transaction ends with a stop condition, as if it was passed to
+ * i2c_transfer() on its own, but on an i2c-mt65xx adapter the bus lock is
+ * taken and the clocks are enabled once for the whole batch.
+ *
+ * Returns the number of transactions completed, or a negative errno if
+ * the first one failed.
+ */
+int mtk_i2c_transfer_batch(struct i2c_adapter *adap, struct i2c_msg *msgs,
+			   const u8 *nums, int nr)
+{
+	struct mtk_i2c *i2c;
+	int i, ret = 0;
+
+	if (adap->algo != &mtk_i2c_algorithm) {
+		for (i = 0; i < nr; msgs += nums[i++]) {
+			ret = i2c_transfer(adap, msgs, nums[i]);
+			if (ret < 0)
+				break;
+		}
+		return i ? i : ret;
+	}
+
+	i2c = i2c_get_adapdata(adap);
+
+	i2c_lock_adapter(adap);
+	ret = mtk_i2c_clock_enable(i2c);
+	if (ret) {
+		i2c_unlock_adapter(adap);
+		return ret;
+	}
+
+	i2c->batch = true;
+	for (i = 0; i < nr; msgs += nums[i++]) {
+		ret = __i2c_transfer(adap, msgs, nums[i]);
+		if (ret < 0)
+			break;
+	}
+	i2c->batch = false;
+
+	mtk_i2c_clock_disable(i2c);
+	i2c_unlock_adapter(adap);
+
+	return i ? i : ret;
+}
+EXPORT_SYMBOL_GPL(mtk_i2c_transfer_batch);
+
+#ifdef CONFIG_DEBUG_FS
+static const char * const mtk_i2c_mode_names[I2C_MODES] = {
+	"poll", "irq", "dma",
+};
+
+static int mtk_i2c_latency_show(struct seq_file *m, void *v)
+{
+	struct mtk_i2c *i2c = m->private;
+	int i, j;
+
+	seq_printf(m, "poll timeouts: %u\n", i2c->poll_timeouts);
+	seq_puts(m, "mode \\ us");
+	for (j = 0; j < I2C_LAT_BUCKETS - 1; j++)
+		seq_printf(m, " %7lu", 1UL << j);
+	seq_puts(m, "    more\n");
+	for (i = 0; i < I2C_MODES; i++) {
+		seq_printf(m, "%-9s", mtk_i2c_mode_names[i]);
+		for (j = 0; j < I2C_LAT_BUCKETS; j++)
+			seq_printf(m, " %7u", i2c->lat_hist[i][j]);
+		seq_puts(m, "\n");
+	}
+	return 0;
+}
+
+static int mtk_i2c_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtk_i2c_latency_show, inode->i_private);
+}
+
+/* any write clears the histograms */
+static ssize_t mtk_i2c_latency_write(struct file *file,
+				     const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct mtk_i2c *i2c = file_inode(file)->i_private;
+
+	memset(i2c->lat_hist, 0, sizeof(i2c->lat_hist));
+	i2c->poll_timeouts = 0;
+	return count;
+}
+
+static const struct file_operations mtk_i2c_latency_fops = {
+	.open		= mtk_i2c_latency_open,
+	.read		= seq_read,
+	.write		= mtk_i2c_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mtk_i2c_init_debugfs(struct mtk_i2c *i2c)
+{
+	i2c->debugfs = debugfs_create_dir(dev_name(&i2c->adap.dev), NULL);
+	if (IS_ERR_OR_NULL(i2c->debugfs))
+		return;
+	debugfs_create_file("latency", S_IRUGO | S_IWUSR, i2c->debugfs, i2c,
+			    &mtk_i2c_latency_fops);
+}
+#else
+static inline void mtk_i2c_init_debugfs(struct mtk_i2c *i2c) {}
+#endif
+
 static int mtk_i2c_parse_dt(struct device_node *np, struct mtk_i2c *i2c)
 {
 	int ret;
@@ -916,6 +1138,7 @@ static int mtk_i2c_probe(struct platform_device *pdev)
 	}
 
 	platform_set_drvdata(pdev, i2c);
+	mtk_i2c_init_debugfs(i2c);
 
 	return 0;
 }
@@ -924,6 +1147,7 @@ static int mtk_i2c_remove(struct platform_device *pdev)
 {
 	struct mtk_i2c *i2c = platform_get_drvdata(pdev);
 
+	debugfs_remove_recursive(i2c->debugfs);
 	i2c_del_adapter(&i2c->adap);
 
 	return 0;
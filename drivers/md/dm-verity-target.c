@@ -19,6 +19,7 @@
 
 #include <linux/module.h>
 #include <linux/reboot.h>
+#include <linux/vmalloc.h>
 
 #define DM_MSG_PREFIX			"verity"
 
@@ -32,8 +33,9 @@
 #define DM_VERITY_OPT_LOGGING		"ignore_corruption"
 #define DM_VERITY_OPT_RESTART		"restart_on_corruption"
 #define DM_VERITY_OPT_IGN_ZEROES	"ignore_zero_blocks"
+#define DM_VERITY_OPT_AT_MOST_ONCE	"check_at_most_once"
 
-#define DM_VERITY_OPTS_MAX		(2 + DM_VERITY_OPTS_FEC)
+#define DM_VERITY_OPTS_MAX		(3 + DM_VERITY_OPTS_FEC)
 
 static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
@@ -102,6 +104,14 @@ static int verity_hash_init(struct dm_verity *v, struct shash_desc *desc)
 	desc->tfm = v->tfm;
 	desc->flags = CRYPTO_TFM_REQ_MAY_SLEEP;
 
+	if (likely(v->initial_hashstate)) {
+		r = crypto_shash_import(desc, v->initial_hashstate);
+
+		if (unlikely(r < 0))
+			DMERR("crypto_shash_import failed: %d", r);
+		return r;
+	}
+
 	r = crypto_shash_init(desc);
 
 	if (unlikely(r < 0)) {
@@ -394,6 +404,148 @@ static int verity_bv_zero(struct dm_verity *v, struct dm_verity_io *io,
 	return 0;
 }
 
+/*
+ * Hash the data block at iter. A block that sits in one bio_vec, the
+ * common case, is hashed with a single finup on top of the salted state
+ * so the hash driver can run update and finalization in one pass.
+ */
+static int verity_hash_data_block(struct dm_verity *v, struct dm_verity_io *io,
+				  struct bvec_iter *iter, u8 *digest)
+{
+	struct shash_desc *desc = verity_io_hash_desc(v, io);
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_bio_data_size);
+	struct bio_vec bv = bio_iter_iovec(bio, *iter);
+	unsigned todo = 1 << v->data_dev_block_bits;
+	u64 start = ktime_get_ns();
+	u8 *page;
+	int r;
+
+	r = verity_hash_init(v, desc);
+	if (unlikely(r < 0))
+		return r;
+
+	if (likely(v->version >= 1 && bv.bv_len >= todo)) {
+		page = kmap_atomic(bv.bv_page);
+		r = crypto_shash_finup(desc, page + bv.bv_offset, todo, digest);
+		kunmap_atomic(page);
+
+		if (unlikely(r < 0)) {
+			DMERR("crypto_shash_finup failed: %d", r);
+			return r;
+		}
+
+		bio_advance_iter(bio, iter, todo);
+	} else {
+		r = verity_for_bv_block(v, io, iter, verity_bv_hash_update);
+		if (unlikely(r < 0))
+			return r;
+
+		r = verity_hash_final(v, desc, digest);
+		if (unlikely(r < 0))
+			return r;
+	}
+
+	atomic64_inc(&v->hashed_blocks);
+	atomic64_add(ktime_get_ns() - start, &v->hash_ns);
+
+	return 0;
+}
+
+/*
+ * Compare the hash of a data block with the one from the tree, and try to
+ * correct it on a mismatch. @start is where the block is in the bio.
+ */
+static int verity_check_data_block(struct dm_verity_io *io, sector_t block,
+				   const u8 *real_digest, const u8 *want_digest,
+				   struct bvec_iter *start)
+{
+	struct dm_verity *v = io->v;
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_bio_data_size);
+
+	if (likely(memcmp(real_digest, want_digest, v->digest_size) == 0)) {
+		if (v->validated_blocks && likely(!bio->bi_error))
+			set_bit(block, v->validated_blocks);
+		return 0;
+	}
+
+	/* corrected or not, this block must be checked again */
+	if (v->validated_blocks)
+		clear_bit(block, v->validated_blocks);
+
+	/* FEC checks its result against verity_io_want_digest() */
+	if (want_digest != verity_io_want_digest(v, io))
+		memcpy(verity_io_want_digest(v, io), want_digest,
+		       v->digest_size);
+
+	if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
+			      block, NULL, start) == 0)
+		return 0;
+	else if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA, block))
+		return -EIO;
+
+	return 0;
+}
+
+/* A data block waiting in verity_verify_io() for one to be hashed with */
+struct verity_pending_block {
+	sector_t block;
+	struct bvec_iter start;
+	struct bio_vec bv;
+	u8 want_digest[DM_VERITY_MB_DIGEST_SIZE];
+	u8 real_digest[DM_VERITY_MB_DIGEST_SIZE];
+};
+
+/*
+ * Hash the pending data blocks, each within one bio_vec, with a single
+ * crypto_shash_finup_mb() and check them.
+ */
+static int verity_verify_pending(struct dm_verity_io *io,
+				 struct verity_pending_block *pend,
+				 unsigned n)
+{
+	struct dm_verity *v = io->v;
+	struct shash_desc *desc = verity_io_hash_desc(v, io);
+	unsigned todo = 1 << v->data_dev_block_bits;
+	const u8 *data[DM_VERITY_MB_BLOCKS];
+	u8 *outs[DM_VERITY_MB_BLOCKS];
+	u8 *pages[DM_VERITY_MB_BLOCKS];
+	u64 start = ktime_get_ns();
+	unsigned i;
+	int r;
+
+	r = verity_hash_init(v, desc);
+	if (unlikely(r < 0))
+		return r;
+
+	for (i = 0; i < n; i++) {
+		pages[i] = kmap_atomic(pend[i].bv.bv_page);
+		data[i] = pages[i] + pend[i].bv.bv_offset;
+		outs[i] = pend[i].real_digest;
+	}
+	r = crypto_shash_finup_mb(desc, data, todo, outs, n);
+	while (i--)
+		kunmap_atomic(pages[i]);
+
+	if (unlikely(r < 0)) {
+		DMERR("crypto_shash_finup_mb failed: %d", r);
+		return r;
+	}
+
+	atomic64_add(n, &v->hashed_blocks);
+	atomic64_add(ktime_get_ns() - start, &v->hash_ns);
+
+	for (i = 0; i < n; i++) {
+		r = verity_check_data_block(io, pend[i].block,
+					    pend[i].real_digest,
+					    pend[i].want_digest,
+					    &pend[i].start);
+		if (unlikely(r < 0))
+			return r;
+	}
+
+	return 0;
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -401,14 +553,25 @@ static int verity_verify_io(struct dm_verity_io *io)
 {
 	bool is_zero;
 	struct dm_verity *v = io->v;
+	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_bio_data_size);
+	struct verity_pending_block pend[DM_VERITY_MB_BLOCKS];
 	struct bvec_iter start;
-	unsigned b;
+	unsigned todo = 1 << v->data_dev_block_bits;
+	unsigned b, n_pend = 0;
+	int r;
 
 	for (b = 0; b < io->n_blocks; b++) {
-		int r;
-		struct shash_desc *desc = verity_io_hash_desc(v, io);
+		sector_t cur_block = io->block + b;
+
+		/* a failed read must go through FEC, never trust the bitmap */
+		if (v->validated_blocks && likely(!bio->bi_error) &&
+		    test_bit(cur_block, v->validated_blocks)) {
+			bio_advance_iter(bio, &io->iter, todo);
+			atomic64_inc(&v->validated_hits);
+			continue;
+		}
 
-		r = verity_hash_for_block(v, io, io->block + b,
+		r = verity_hash_for_block(v, io, cur_block,
 					  verity_io_want_digest(v, io),
 					  &is_zero);
 		if (unlikely(r < 0))
@@ -427,33 +590,57 @@ static int verity_verify_io(struct dm_verity_io *io)
 			continue;
 		}
 
-		r = verity_hash_init(v, desc);
-		if (unlikely(r < 0))
-			return r;
-
 		start = io->iter;
-		r = verity_for_bv_block(v, io, &io->iter, verity_bv_hash_update);
+		if (v->hash_mb && bio_iter_iovec(bio, io->iter).bv_len >= todo) {
+			struct verity_pending_block *p = &pend[n_pend++];
+
+			p->block = cur_block;
+			p->start = start;
+			p->bv = bio_iter_iovec(bio, io->iter);
+			memcpy(p->want_digest, verity_io_want_digest(v, io),
+			       v->digest_size);
+			bio_advance_iter(bio, &io->iter, todo);
+
+			if (n_pend < DM_VERITY_MB_BLOCKS)
+				continue;
+			n_pend = 0;
+			r = verity_verify_pending(io, pend, DM_VERITY_MB_BLOCKS);
+			if (unlikely(r < 0))
+				return r;
+			continue;
+		}
+
+		r = verity_hash_data_block(v, io, &io->iter,
+					   verity_io_real_digest(v, io));
 		if (unlikely(r < 0))
 			return r;
 
-		r = verity_hash_final(v, desc, verity_io_real_digest(v, io));
+		r = verity_check_data_block(io, cur_block,
+					    verity_io_real_digest(v, io),
+					    verity_io_want_digest(v, io),
+					    &start);
 		if (unlikely(r < 0))
 			return r;
-
-		if (likely(memcmp(verity_io_real_digest(v, io),
-				  verity_io_want_digest(v, io), v->digest_size) == 0))
-			continue;
-		else if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
-					   io->block + b, NULL, &start) == 0)
-			continue;
-		else if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
-					   io->block + b))
-			return -EIO;
 	}
 
+	if (n_pend)
+		return verity_verify_pending(io, pend, n_pend);
+
 	return 0;
 }
 
+static void verity_invalidate_io(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	unsigned b;
+
+	if (!v->validated_blocks)
+		return;
+
+	for (b = 0; b < io->n_blocks; b++)
+		clear_bit(io->block + b, v->validated_blocks);
+}
+
 /*
  * End one "io" structure with a given error.
  */
@@ -473,8 +660,11 @@ static void verity_finish_io(struct dm_verity_io *io, int error)
 static void verity_work(struct work_struct *w)
 {
 	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
+	int r = verity_verify_io(io);
 
-	verity_finish_io(io, verity_verify_io(io));
+	if (r)
+		verity_invalidate_io(io);
+	verity_finish_io(io, r);
 }
 
 static void verity_end_io(struct bio *bio)
@@ -482,6 +672,7 @@ static void verity_end_io(struct bio *bio)
 	struct dm_verity_io *io = bio->bi_private;
 
 	if (bio->bi_error && !verity_fec_is_enabled(io->v)) {
+		verity_invalidate_io(io);
 		verity_finish_io(io, bio->bi_error);
 		return;
 	}
@@ -595,7 +786,9 @@ int verity_map(struct dm_target *ti, struct bio *bio)
 EXPORT_SYMBOL_GPL(verity_map);
 
 /*
- * Status: V (valid) or C (corruption found)
+ * Status: V (valid) or C (corruption found), followed by the number of data
+ * blocks served from the validated bitmap, the number of data blocks hashed
+ * and the time spent hashing them in ns.
  */
 void verity_status(struct dm_target *ti, status_type_t type,
 			  unsigned status_flags, char *result, unsigned maxlen)
@@ -607,7 +800,10 @@ void verity_status(struct dm_target *ti, status_type_t type,
 
 	switch (type) {
 	case STATUSTYPE_INFO:
-		DMEMIT("%c", v->hash_failed ? 'C' : 'V');
+		DMEMIT("%c %llu %llu %llu", v->hash_failed ? 'C' : 'V',
+		       (unsigned long long)atomic64_read(&v->validated_hits),
+		       (unsigned long long)atomic64_read(&v->hashed_blocks),
+		       (unsigned long long)atomic64_read(&v->hash_ns));
 		break;
 	case STATUSTYPE_TABLE:
 		DMEMIT("%u %s %s %u %u %llu %llu %s ",
@@ -634,6 +830,8 @@ void verity_status(struct dm_target *ti, status_type_t type,
 			args += DM_VERITY_OPTS_FEC;
 		if (v->zero_digest)
 			args++;
+		if (v->validated_blocks)
+			args++;
 		if (!args)
 			return;
 		DMEMIT(" %u", args);
@@ -652,6 +850,8 @@ void verity_status(struct dm_target *ti, status_type_t type,
 		}
 		if (v->zero_digest)
 			DMEMIT(" " DM_VERITY_OPT_IGN_ZEROES);
+		if (v->validated_blocks)
+			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE);
 		sz = verity_fec_status_table(v, sz, result, maxlen);
 		break;
 	}
@@ -705,6 +905,8 @@ void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	vfree(v->validated_blocks);
+	kfree(v->initial_hashstate);
 	kfree(v->salt);
 	kfree(v->root_digest);
 	kfree(v->zero_digest);
@@ -757,6 +959,63 @@ out:
 	return r;
 }
 
+static int verity_alloc_most_once(struct dm_verity *v)
+{
+	struct dm_target *ti = v->ti;
+
+	/* the bit set can't be larger than INT_MAX bits */
+	if (v->data_blocks > INT_MAX) {
+		ti->error = "device too large to use check_at_most_once";
+		return -E2BIG;
+	}
+
+	v->validated_blocks = vzalloc(BITS_TO_LONGS(v->data_blocks) *
+				      sizeof(unsigned long));
+	if (!v->validated_blocks) {
+		ti->error = "failed to allocate bitset for check_at_most_once";
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Salt is hashed first in version 1, so every hash starts from the same
+ * state. Export it once instead of rehashing the salt for each block.
+ */
+static int verity_alloc_initial_hashstate(struct dm_verity *v)
+{
+	struct shash_desc *desc;
+	int r;
+
+	if (!v->version || !v->salt_size)
+		return 0;
+
+	desc = kmalloc(v->shash_descsize, GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+
+	r = verity_hash_init(v, desc);
+	if (r)
+		goto out;
+
+	v->initial_hashstate = kmalloc(crypto_shash_statesize(v->tfm),
+				       GFP_KERNEL);
+	if (!v->initial_hashstate) {
+		r = -ENOMEM;
+		goto out;
+	}
+
+	r = crypto_shash_export(desc, v->initial_hashstate);
+	if (r) {
+		kfree(v->initial_hashstate);
+		v->initial_hashstate = NULL;
+	}
+out:
+	kfree(desc);
+	return r;
+}
+
 static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v)
 {
 	int r;
@@ -795,6 +1054,12 @@ static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v)
 			}
 			continue;
 
+		} else if (!strcasecmp(arg_name, DM_VERITY_OPT_AT_MOST_ONCE)) {
+			r = verity_alloc_most_once(v);
+			if (r)
+				return r;
+			continue;
+
 		} else if (verity_is_fec_opt_arg(arg_name)) {
 			r = verity_fec_parse_opt_args(as, v, &argc, arg_name);
 			if (r)
@@ -944,6 +1209,10 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	}
 	v->shash_descsize =
 		sizeof(struct shash_desc) + crypto_shash_descsize(v->tfm);
+	/* the salt goes last in version 0, so blocks share no state there */
+	v->hash_mb = v->version >= 1 &&
+		     crypto_shash_mb_max_msgs(v->tfm) >= DM_VERITY_MB_BLOCKS &&
+		     v->digest_size <= DM_VERITY_MB_DIGEST_SIZE;
 
 	v->root_digest = kmalloc(v->digest_size, GFP_KERNEL);
 	if (!v->root_digest) {
@@ -974,6 +1243,12 @@ int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
+	r = verity_alloc_initial_hashstate(v);
+	if (r) {
+		ti->error = "Cannot compute initial hash state";
+		goto bad;
+	}
+
 	argv += 10;
 	argc -= 10;
 
@@ -1063,7 +1338,7 @@ EXPORT_SYMBOL_GPL(verity_ctr);
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 3, 0},
+	.version	= {1, 4, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
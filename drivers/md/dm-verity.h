@@ -17,6 +17,9 @@
 #include <crypto/hash.h>
 
 #define DM_VERITY_MAX_LEVELS		63
+/* data blocks hashed together with crypto_shash_finup_mb() */
+#define DM_VERITY_MB_BLOCKS		2
+#define DM_VERITY_MB_DIGEST_SIZE	64
 
 enum verity_mode {
 	DM_VERITY_MODE_EIO,
@@ -51,6 +54,7 @@ struct dm_verity {
 	unsigned char hash_per_block_bits;	/* log2(hashes in hash block) */
 	unsigned char levels;	/* the number of tree levels */
 	unsigned char version;
+	bool hash_mb;		/* hash data blocks in pairs */
 	unsigned digest_size;	/* digest size for the current hash algorithm */
 	unsigned shash_descsize;/* the size of temporary space for crypto */
 	int hash_failed;	/* set to 1 if hash of any block failed */
@@ -63,6 +67,13 @@ struct dm_verity {
 	sector_t hash_level_block[DM_VERITY_MAX_LEVELS];
 
 	struct dm_verity_fec *fec;	/* forward error correction */
+
+	void *initial_hashstate;	/* exported hash state after the salt */
+	unsigned long *validated_blocks; /* bitset of blocks validated once */
+
+	atomic64_t validated_hits;	/* data blocks not rehashed */
+	atomic64_t hashed_blocks;	/* data blocks hashed */
+	atomic64_t hash_ns;		/* time spent hashing data blocks */
 };
 
 struct dm_verity_io {
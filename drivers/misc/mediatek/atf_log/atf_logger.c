@@ -14,6 +14,7 @@
 #include <linux/module.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/mm.h>
 #include <linux/cdev.h>
 #include <linux/miscdevice.h>
 #include <linux/platform_device.h>
@@ -33,6 +34,8 @@
 #include <linux/atomic.h>
 #include <linux/irq.h>
 #include <linux/syscore_ops.h>
+#include <linux/slab.h>
+#include <uapi/linux/atf_log.h>
 #include <mt-plat/mtk_secure_api.h>
 
 /*#define ATF_LOGGER_DEBUG*/
@@ -49,20 +52,6 @@ static const struct of_device_id atf_logger_of_ids[] = {
 	{}
 };
 
-#ifdef __aarch64__
-static void *_memcpy(void *dest, const void *src, size_t count)
-{
-	char *tmp = dest;
-	const char *s = src;
-
-	while (count--)
-		*tmp++ = *s++;
-	return dest;
-}
-
-#define memcpy _memcpy
-#endif
-
 union atf_log_ctl_t {
 	struct {
 		unsigned int atf_buf_addr;          /*  0x00 */
@@ -109,6 +98,16 @@ static unsigned int index_to_pos(unsigned int index)
 	return (atf_buf_phy_ctl + ATF_LOG_CTRL_BUF_SIZE) + index;
 }
 
+/*
+ * The log ring is shared with the secure world through a write-combined
+ * mapping, so copy it out with the IO accessors: byte reads up to an
+ * 8-byte boundary, 64-bit reads for the bulk and byte reads for the tail.
+ */
+static void atf_log_copy(unsigned char *dst, unsigned int index, size_t len)
+{
+	memcpy_fromio(dst, (const void __iomem *)(atf_log_vir_addr + index), len);
+}
+
 static size_t atf_log_dump_nolock(unsigned char *buffer, struct ipanic_atf_log_rec *rec, size_t size)
 {
 	unsigned int len;
@@ -130,12 +129,12 @@ static size_t atf_log_dump_nolock(unsigned char *buffer, struct ipanic_atf_log_r
 		size = least;
 	len = min(size, (size_t)(atf_log_len - rec->start_idx));
 	if (size == len) {
-		memcpy(buffer, atf_log_vir_addr + rec->start_idx, size);
+		atf_log_copy(buffer, rec->start_idx, size);
 	} else {
 		size_t right = atf_log_len - rec->start_idx;
 
-		memcpy(buffer, atf_log_vir_addr + rec->start_idx, right);
-		memcpy(buffer, atf_log_vir_addr, size - right);
+		atf_log_copy(buffer, rec->start_idx, right);
+		atf_log_copy(buffer + right, 0, size - right);
 	}
 	rec->start_idx += size;
 	rec->start_idx %= atf_log_len;
@@ -196,7 +195,8 @@ static ssize_t atf_log_write(struct file *file, const char __user *buf, size_t c
 	return 1;
 }
 
-static ssize_t do_read_log_to_usr(char __user *buf, size_t count)
+/* Called with atf_log_lock held, @buf is a kernel bounce buffer */
+static ssize_t do_read_log(unsigned char *buf, size_t count)
 {
 	size_t copy_len = 0;
 	size_t right = 0;
@@ -217,8 +217,7 @@ static ssize_t do_read_log_to_usr(char __user *buf, size_t count)
 	if (local_write_index > local_read_index) {
 		/* write (right) - read (left) */
 		/* --------R-------W-----------*/
-		if (copy_to_user(buf, atf_log_vir_addr + local_read_index, count))
-			return -EFAULT;
+		atf_log_copy(buf, local_read_index, count);
 	} else {
 		/* turn around to the head */
 		/* --------W-------R-----------*/
@@ -227,14 +226,11 @@ static ssize_t do_read_log_to_usr(char __user *buf, size_t count)
 		/* check buf space is enough to copy */
 		if (count > right) {
 			/* if space is enough to copy */
-			if (copy_to_user(buf, atf_log_vir_addr + local_read_index, right))
-				return -EFAULT;
-			if (copy_to_user((buf + right), atf_log_vir_addr, count - right))
-				return -EFAULT;
+			atf_log_copy(buf, local_read_index, right);
+			atf_log_copy(buf + right, 0, count - right);
 		} else {
 			/* if count is only enough to copy right or count, just copy right or count */
-			if (copy_to_user(buf, atf_log_vir_addr + local_read_index, count))
-				return -EFAULT;
+			atf_log_copy(buf, local_read_index, count);
 		}
 	}
 
@@ -286,6 +282,7 @@ static ssize_t atf_log_read(struct file *file, char __user *buf, size_t count, l
 	ssize_t ret;
 	unsigned int write_pos;
 	unsigned int read_pos;
+	unsigned char *kbuf;
 	DEFINE_WAIT(wait);
 
 start:
@@ -321,10 +318,22 @@ start:
 		goto start;
 	}
 
+	/* the ring is IO memory, and no user copy may fault under the lock */
+	count = min_t(size_t, count, PAGE_SIZE);
+	kbuf = kmalloc(count, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+
 	atf_log_lock();
-	ret = do_read_log_to_usr(buf, count);
+	ret = do_read_log(kbuf, count);
 	atf_log_unlock();
 
+	if (ret > 0 && copy_to_user(buf, kbuf, ret))
+		ret = -EFAULT;
+	kfree(kbuf);
+	if (ret < 0)
+		return ret;
+
 	/* update the file pos */
 	*f_pos += ret;
 	return ret;
@@ -344,9 +353,58 @@ static unsigned int atf_log_poll(struct file *file, poll_table *wait)
 	return ret;
 }
 
+static size_t atf_log_consume(size_t count)
+{
+	unsigned int local_write_index;
+	unsigned int local_read_index;
+	size_t avail;
+
+	atf_log_lock();
+	local_write_index = pos_to_index(atf_buf_vir_ctl->info.atf_write_pos);
+	local_read_index = pos_to_index(atf_buf_vir_ctl->info.atf_read_pos);
+	avail = (local_write_index + atf_log_len - local_read_index) % atf_log_len;
+	if (count > avail)
+		count = avail;
+	local_read_index = (local_read_index + count) % atf_log_len;
+	atf_buf_vir_ctl->info.atf_read_pos = index_to_pos(local_read_index);
+	atf_log_unlock();
+
+	return count;
+}
+
 static long atf_log_ioctl(struct file *flip, unsigned int cmd, unsigned long arg)
 {
-	return 0;
+	struct atf_log_mmap_info info;
+
+	switch (cmd) {
+	case ATF_LOG_IOC_INFO:
+		info.data_offset = ATF_LOG_CTRL_BUF_SIZE;
+		info.data_size = atf_log_len;
+		info.pos_base = atf_buf_phy_ctl + ATF_LOG_CTRL_BUF_SIZE;
+		if (copy_to_user((void __user *)arg, &info, sizeof(info)))
+			return -EFAULT;
+		return 0;
+	case ATF_LOG_IOC_CONSUME:
+		return atf_log_consume(arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int atf_log_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (!atf_log_len)
+		return -ENODEV;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+	/* keep the attributes in line with the kernel's ioremap_wc() alias */
+	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+
+	return vm_iomap_memory(vma, atf_buf_phy_ctl,
+			       ATF_LOG_CTRL_BUF_SIZE + atf_log_len);
 }
 
 static const struct file_operations atf_log_fops = {
@@ -355,6 +413,7 @@ static const struct file_operations atf_log_fops = {
 	.compat_ioctl = atf_log_ioctl,
 	.poll       = atf_log_poll,
 	.read       = atf_log_read,
+	.mmap       = atf_log_mmap,
 	.open       = atf_log_open,
 	.release    = atf_log_release,
 	.write      = atf_log_write,
@@ -512,6 +571,7 @@ static const struct file_operations proc_atf_log_file_operations = {
 	.compat_ioctl = atf_log_ioctl,
 	.release = atf_log_release,
 	.poll   = atf_log_poll,
+	.mmap   = atf_log_mmap,
 };
 
 static void atf_time_sync_resume(void)
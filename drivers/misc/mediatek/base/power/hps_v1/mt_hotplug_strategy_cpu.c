@@ -94,6 +94,26 @@ unsigned int hps_cpu_get_nr_heavy_task(void)
 #endif
 }
 
+#ifdef CONFIG_MTK_SCHED_RQAVG_US
+/*
+ * heavy task count changed: kick hps right away when it grows, falling
+ * counts are left to the periodic decision so that the down hysteresis
+ * still applies
+ */
+static int hps_cpu_heavy_task_notify(struct notifier_block *nb,
+			unsigned long nr_heavy, void *data)
+{
+	if (hps_ctxt.enabled && nr_heavy > hps_ctxt.cur_nr_heavy_task)
+		hps_task_wakeup_nolock();
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block hps_cpu_heavy_task_nb = {
+	.notifier_call = hps_cpu_heavy_task_notify,
+};
+#endif
+
 void hps_cpu_get_tlp(unsigned int *avg, unsigned int *iowait_avg)
 {
 #ifdef CONFIG_MTK_SCHED_RQAVG_KS
@@ -231,6 +251,10 @@ int hps_cpu_init(void)
 		hps_ctxt.little_cpu_id_min, hps_ctxt.little_cpu_id_max,
 		hps_ctxt.big_cpu_id_min, hps_ctxt.big_cpu_id_max);
 
+#ifdef CONFIG_MTK_SCHED_RQAVG_US
+	register_heavy_task_notifier(&hps_cpu_heavy_task_nb);
+#endif
+
 	return r;
 }
 
@@ -243,6 +267,10 @@ int hps_cpu_deinit(void)
 
 	log_info("hps_cpu_deinit\n");
 
+#ifdef CONFIG_MTK_SCHED_RQAVG_US
+	unregister_heavy_task_notifier(&hps_cpu_heavy_task_nb);
+#endif
+
 	return r;
 }
 
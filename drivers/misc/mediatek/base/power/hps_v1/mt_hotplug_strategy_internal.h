@@ -271,6 +271,8 @@ extern unsigned int sched_get_percpu_load(
 			int cpu, bool reset, bool use_maxfreq);
 /* definition in mediatek/kernel/kernel/sched/rq_stats.c */
 extern unsigned int sched_get_nr_heavy_task(void);
+extern int register_heavy_task_notifier(struct notifier_block *nb);
+extern int unregister_heavy_task_notifier(struct notifier_block *nb);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
 
 #ifdef __cplusplus
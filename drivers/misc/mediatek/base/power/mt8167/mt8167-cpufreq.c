@@ -23,6 +23,8 @@
 #include <linux/regulator/consumer.h>
 #include <linux/slab.h>
 #include <linux/thermal.h>
+#include "mach/mtk_thermal.h"
+#include "mtk_cpu_energy.h"
 #include "mtk_power_throttle.h"
 #include "mtk_static_power.h"
 
@@ -52,6 +54,7 @@ struct mtk_cpu_dvfs_info {
 	struct clk *inter_clk;
 	struct clk *arm_clk;
 	struct thermal_cooling_device *cdev;
+	struct mtk_cpu_energy *energy;
 	struct mutex lock;
 	struct notifier_block opp_nb;
 	struct list_head list_head;
@@ -229,13 +232,14 @@ unsigned long event, void *data)
 	if (event == OPP_EVENT_ADJUST_VOLTAGE) {
 		rcu_read_lock();
 		freq = dev_pm_opp_get_freq(opp);
+		volt = dev_pm_opp_get_voltage(opp);
 		rcu_read_unlock();
 
+		/* keep the scheduler energy model on the adjusted voltage */
+		mtk_cpu_energy_update_opp(info->energy, freq, volt);
+
 		mutex_lock(&info->lock);
 		if (info->opp_freq == freq) {
-			rcu_read_lock();
-			volt = dev_pm_opp_get_voltage(opp);
-			rcu_read_unlock();
 			ret = mtk_cpufreq_set_voltage(info, volt);
 			if (ret)
 				dev_err(info->cpu_dev, "failed to scale voltage: %d\n", ret);
@@ -356,19 +360,24 @@ static int mtk_cpufreq_set_target(struct cpufreq_policy *policy,
 #define DYNAMIC_POWER "dynamic-power-coefficient"
 #define STATIC_POWER "static-power-coefficient"
 
+/*
+ * Static power of the online cpus in @cpumask at @voltage (mV), in mW.
+ * mt_spower characterizes the whole A35 cluster at the current Tj, so the
+ * leakage is shared out per powered core.
+ */
 int plat_static_func(cpumask_t *cpumask, int interval, unsigned long voltage, u32 *power)
 {
-	unsigned int total_power = 0;
+	int nr_cpus = cpumask_weight(cpumask);
+	int temp = get_immediate_ts1_wrap() / 1000;
+	int leakage;
 
-	#if 0
-	/* cluster power + core power */
-	/* total_power = (CA53_LEAKAGE_POWER_BASE*num+CA53_N_LEAKAGE_POWER_BASE) */
-	/* *(vol/vol_base)*(vol/vol_base)*(vol/vol_base); */
-	total_power = (CA53_LEAKAGE_POWER_BASE * num + CA53_N_LEAKAGE_POWER_BASE * (num ? 1 : 0))
-	    * vol / vol_base * vol / vol_base * vol / vol_base;
-	#endif
+	leakage = mt_spower_get_leakage(MT_SPOWER_CA7, voltage, temp);
+	if (leakage < 0)
+		leakage = 0;
 
-	return total_power;
+	*power = leakage * nr_cpus / num_possible_cpus();
+
+	return 0;
 }
 
 static void mtk_cpufreq_ready(struct cpufreq_policy *policy)
@@ -381,10 +390,19 @@ static void mtk_cpufreq_ready(struct cpufreq_policy *policy)
 	if (WARN_ON(!np))
 		return;
 
-	if (of_find_property(np, "#cooling-cells", NULL)) {
-		of_property_read_u32(np, DYNAMIC_POWER, &capacitance);
-		of_property_read_u32(np, STATIC_POWER, &static_capacitance);
+	of_property_read_u32(np, DYNAMIC_POWER, &capacitance);
+	of_property_read_u32(np, STATIC_POWER, &static_capacitance);
+
+	/* thermal power budgets are split on the same model */
+	if (capacitance)
+		mt_cpufreq_set_power_model(capacitance, plat_static_func);
 
+	/* per-OPP energy model at the (PTP adjusted) OPP voltages */
+	info->energy = mtk_cpu_energy_register(info->cpu_dev,
+					       policy->related_cpus,
+					       capacitance);
+
+	if (of_find_property(np, "#cooling-cells", NULL)) {
 		info->cdev = of_cpufreq_power_cooling_register(np,
 						policy->related_cpus,
 						capacitance,
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+/*
+ * Scheduler energy model for the mt8167 CPU cluster.
+ *
+ * One capacity state is built per cpufreq OPP. Dynamic power follows the
+ * same C * f * V^2 model as the power cooling device, using the
+ * "dynamic-power-coefficient" of the cpu node, and static power comes from
+ * the efuse based leakage table (mt_spower). Voltages are the ones currently
+ * programmed in the OPP table, so the model tracks the PTP adjusted values
+ * through the OPP notifier of mt8167-cpufreq.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/pm_opp.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <asm/topology.h>
+#include "mach/mtk_thermal.h"
+#include "mtk_static_power.h"
+#include "mtk_cpu_energy.h"
+
+/* Tj used for leakage when the thermal driver has no reading yet */
+#define ENERGY_REF_TEMP		65
+/* Same state count as the static tables in arch topology */
+#define ENERGY_NR_IDLE_STATES	7
+
+struct mtk_cpu_energy {
+	struct device *cpu_dev;
+	struct cpumask cpus;
+	u32 dyn_coeff;
+	unsigned int nr_opp;
+	unsigned long *freq_hz;
+	struct capacity_state *core_caps;
+	struct capacity_state *cluster_caps;
+	struct idle_state core_idle[ENERGY_NR_IDLE_STATES];
+	struct idle_state cluster_idle[ENERGY_NR_IDLE_STATES];
+	struct sched_group_energy core_sge;
+	struct sched_group_energy cluster_sge;
+	struct mutex lock;
+	unsigned int nr_updates;
+};
+
+static struct dentry *energy_debugfs_root;
+
+static int energy_temp(void)
+{
+	int temp = get_immediate_ts1_wrap() / 1000;
+
+	return temp > 0 ? temp : ENERGY_REF_TEMP;
+}
+
+/* per core power in mW at the given OPP */
+static void energy_fill_opp(struct mtk_cpu_energy *em, int idx,
+			    unsigned long volt_uv, int temp)
+{
+	unsigned long freq_mhz = em->freq_hz[idx] / 1000000;
+	unsigned long volt_mv = volt_uv / 1000;
+	int nr_cpus = cpumask_weight(&em->cpus);
+	u64 dyn;
+	int lkg;
+
+	dyn = (u64)em->dyn_coeff * freq_mhz * volt_mv * volt_mv;
+	do_div(dyn, 1000000000);
+
+	/* mt_spower returns the leakage of the whole A35 cluster */
+	lkg = mt_spower_get_leakage(MT_SPOWER_CA7, volt_mv, temp);
+	if (lkg < 0)
+		lkg = 0;
+	lkg /= nr_cpus;
+
+	WRITE_ONCE(em->core_caps[idx].volt, volt_uv / 10);
+	WRITE_ONCE(em->core_caps[idx].dyn_pwr, (unsigned int)dyn);
+	WRITE_ONCE(em->core_caps[idx].lkg_pwr[0], lkg);
+	WRITE_ONCE(em->cluster_caps[idx].volt, volt_uv / 10);
+
+	/*
+	 * A core in WFI keeps leaking at the cluster voltage; take the lowest
+	 * OPP as the reference since idle cpus do not hold the OPP up.
+	 */
+	if (idx == 0) {
+		WRITE_ONCE(em->core_idle[0].power, lkg);
+		WRITE_ONCE(em->core_idle[1].power, lkg);
+	}
+}
+
+void mtk_cpu_energy_update_opp(struct mtk_cpu_energy *em,
+			       unsigned long freq_hz, unsigned long volt_uv)
+{
+	int i;
+
+	if (!em)
+		return;
+
+	mutex_lock(&em->lock);
+	for (i = 0; i < em->nr_opp; i++) {
+		if (em->freq_hz[i] == freq_hz) {
+			energy_fill_opp(em, i, volt_uv, energy_temp());
+			em->nr_updates++;
+			break;
+		}
+	}
+	mutex_unlock(&em->lock);
+}
+
+static int energy_model_show(struct seq_file *m, void *v)
+{
+	struct mtk_cpu_energy *em = m->private;
+	int i;
+
+	mutex_lock(&em->lock);
+	seq_printf(m, "cpus=%*pbl dyn_coeff=%u updates=%u\n",
+		   cpumask_pr_args(&em->cpus), em->dyn_coeff, em->nr_updates);
+	seq_puts(m, "idx freq_khz volt_mv cap dyn_mw lkg_mw cost\n");
+	for (i = 0; i < em->nr_opp; i++) {
+		struct capacity_state *cs = &em->core_caps[i];
+		unsigned int pwr = cs->dyn_pwr + cs->lkg_pwr[0];
+
+		/* cost: power spent per unit of delivered capacity, x1024 */
+		seq_printf(m, "%3d %8lu %7u %4llu %6u %6u %5llu\n",
+			   i, em->freq_hz[i] / 1000, cs->volt / 100, cs->cap,
+			   cs->dyn_pwr, cs->lkg_pwr[0],
+			   div64_u64((u64)pwr << SCHED_CAPACITY_SHIFT, cs->cap));
+	}
+	seq_printf(m, "idle_mw wfi=%lu\n", em->core_idle[1].power);
+	mutex_unlock(&em->lock);
+
+	return 0;
+}
+
+static int energy_model_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, energy_model_show, inode->i_private);
+}
+
+static const struct file_operations energy_model_fops = {
+	.open = energy_model_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/*
+ * Energy of the cluster for a given per-cpu utilization pattern, following
+ * the same busy/idle split as sched_group_energy(). Written as
+ * "<util cpu0> <util cpu1> ..." and read back per OPP for validation
+ * against measurements.
+ */
+static unsigned long estimate_util[NR_CPUS];
+
+static int energy_estimate_show(struct seq_file *m, void *v)
+{
+	struct mtk_cpu_energy *em = m->private;
+	unsigned long max_util = 0;
+	int cpu, i;
+
+	for_each_cpu(cpu, &em->cpus)
+		max_util = max(max_util, estimate_util[cpu]);
+
+	mutex_lock(&em->lock);
+	seq_puts(m, "idx freq_khz fits energy\n");
+	for (i = 0; i < em->nr_opp; i++) {
+		struct capacity_state *cs = &em->core_caps[i];
+		unsigned long busy_pwr = cs->dyn_pwr + cs->lkg_pwr[0];
+		unsigned long energy = 0;
+
+		for_each_cpu(cpu, &em->cpus) {
+			unsigned long norm;
+
+			norm = min_t(unsigned long, SCHED_CAPACITY_SCALE,
+				     (estimate_util[cpu] << SCHED_CAPACITY_SHIFT) /
+				     cs->cap);
+			energy += (norm * busy_pwr +
+				   (SCHED_CAPACITY_SCALE - norm) *
+				   em->core_idle[1].power) >> SCHED_CAPACITY_SHIFT;
+		}
+		seq_printf(m, "%3d %8lu %4d %6lu\n", i, em->freq_hz[i] / 1000,
+			   cs->cap >= max_util, energy);
+	}
+	mutex_unlock(&em->lock);
+
+	return 0;
+}
+
+static ssize_t energy_estimate_write(struct file *file, const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct mtk_cpu_energy *em =
+		((struct seq_file *)file->private_data)->private;
+	char buf[64], *p = buf, *tok;
+	unsigned long util;
+	int cpu;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	for_each_cpu(cpu, &em->cpus) {
+		tok = strsep(&p, " \t\n");
+		if (!tok || !*tok || kstrtoul(tok, 0, &util))
+			util = 0;
+		estimate_util[cpu] = min_t(unsigned long, util,
+					   SCHED_CAPACITY_SCALE);
+	}
+
+	return count;
+}
+
+static int energy_estimate_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, energy_estimate_show, inode->i_private);
+}
+
+static const struct file_operations energy_estimate_fops = {
+	.open = energy_estimate_open,
+	.read = seq_read,
+	.write = energy_estimate_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void energy_debugfs_init(struct mtk_cpu_energy *em)
+{
+	if (!energy_debugfs_root) {
+		energy_debugfs_root = debugfs_create_dir("cpu_energy", NULL);
+		if (!energy_debugfs_root) {
+			pr_err("%s: can not create debugfs 'cpu_energy'\n",
+			       __func__);
+			return;
+		}
+	}
+
+	debugfs_create_file("model", 0444, energy_debugfs_root, em,
+			    &energy_model_fops);
+	debugfs_create_file("estimate", 0644, energy_debugfs_root, em,
+			    &energy_estimate_fops);
+}
+
+struct mtk_cpu_energy *mtk_cpu_energy_register(struct device *cpu_dev,
+					       const struct cpumask *cpus,
+					       u32 dyn_coeff)
+{
+	struct mtk_cpu_energy *em;
+	struct dev_pm_opp *opp;
+	unsigned long rate, max_cap;
+	unsigned long *volt_uv;
+	int cpu = cpumask_first(cpus);
+	int count, i, temp, ret;
+
+	if (!dyn_coeff)
+		return NULL;
+
+	rcu_read_lock();
+	count = dev_pm_opp_get_opp_count(cpu_dev);
+	rcu_read_unlock();
+	if (count <= 0)
+		return NULL;
+
+	em = kzalloc(sizeof(*em), GFP_KERNEL);
+	if (!em)
+		return NULL;
+
+	em->freq_hz = kcalloc(count, sizeof(*em->freq_hz), GFP_KERNEL);
+	volt_uv = kcalloc(count, sizeof(*volt_uv), GFP_KERNEL);
+	em->core_caps = kcalloc(count, sizeof(*em->core_caps), GFP_KERNEL);
+	em->cluster_caps = kcalloc(count, sizeof(*em->cluster_caps),
+				   GFP_KERNEL);
+	if (!em->freq_hz || !volt_uv || !em->core_caps || !em->cluster_caps)
+		goto err_free;
+
+	em->cpu_dev = cpu_dev;
+	cpumask_copy(&em->cpus, cpus);
+	em->dyn_coeff = dyn_coeff;
+	mutex_init(&em->lock);
+
+	/* OPPs in ascending order, as the scheduler expects cap_states */
+	rcu_read_lock();
+	for (i = 0, rate = 0; i < count; i++, rate++) {
+		opp = dev_pm_opp_find_freq_ceil(cpu_dev, &rate);
+		if (IS_ERR(opp))
+			break;
+		em->freq_hz[i] = rate;
+		volt_uv[i] = dev_pm_opp_get_voltage(opp);
+	}
+	rcu_read_unlock();
+	if (i == 0)
+		goto err_free;
+
+	em->nr_opp = i;
+	max_cap = topology_max_cpu_capacity(cpu);
+	temp = energy_temp();
+
+	for (i = 0; i < em->nr_opp; i++) {
+		em->core_caps[i].cap = div64_u64((u64)max_cap * em->freq_hz[i],
+					em->freq_hz[em->nr_opp - 1]);
+		/*
+		 * Shared MCUSYS power is not characterized separately; it is
+		 * folded into the per core numbers, so the cluster level only
+		 * carries the capacity steps.
+		 */
+		em->cluster_caps[i].cap = em->core_caps[i].cap;
+		energy_fill_opp(em, i, volt_uv[i], temp);
+	}
+	kfree(volt_uv);
+	volt_uv = NULL;
+
+	em->core_sge.nr_idle_states = ENERGY_NR_IDLE_STATES;
+	em->core_sge.idle_states = em->core_idle;
+	em->core_sge.nr_cap_states = em->nr_opp;
+	em->core_sge.cap_states = em->core_caps;
+	em->core_sge.lkg_idx = 0;
+
+	em->cluster_sge.nr_idle_states = ENERGY_NR_IDLE_STATES;
+	em->cluster_sge.idle_states = em->cluster_idle;
+	em->cluster_sge.nr_cap_states = em->nr_opp;
+	em->cluster_sge.cap_states = em->cluster_caps;
+	em->cluster_sge.lkg_idx = 0;
+
+	ret = arch_register_cpu_energy(cpu, &em->core_sge, &em->cluster_sge);
+	if (ret) {
+		pr_err("%s: failed to register energy model for cpu%d: %d\n",
+		       __func__, cpu, ret);
+		goto err_free;
+	}
+
+	energy_debugfs_init(em);
+
+	pr_info("%s: cpu%d energy model with %u OPPs registered\n",
+		__func__, cpu, em->nr_opp);
+
+	return em;
+
+err_free:
+	kfree(volt_uv);
+	kfree(em->cluster_caps);
+	kfree(em->core_caps);
+	kfree(em->freq_hz);
+	kfree(em);
+	return NULL;
+}
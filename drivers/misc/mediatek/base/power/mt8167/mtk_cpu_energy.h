@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#ifndef __MTK_CPU_ENERGY_H__
+#define __MTK_CPU_ENERGY_H__
+
+#include <linux/cpumask.h>
+#include <linux/device.h>
+
+struct mtk_cpu_energy;
+
+#ifdef CONFIG_MTK_CPU_ENERGY_MODEL
+extern struct mtk_cpu_energy *mtk_cpu_energy_register(struct device *cpu_dev,
+					const struct cpumask *cpus,
+					u32 dyn_coeff);
+extern void mtk_cpu_energy_update_opp(struct mtk_cpu_energy *em,
+				      unsigned long freq_hz,
+				      unsigned long volt_uv);
+#else
+static inline struct mtk_cpu_energy *mtk_cpu_energy_register(
+		struct device *cpu_dev, const struct cpumask *cpus,
+		u32 dyn_coeff)
+{
+	return NULL;
+}
+
+static inline void mtk_cpu_energy_update_opp(struct mtk_cpu_energy *em,
+					     unsigned long freq_hz,
+					     unsigned long volt_uv)
+{
+}
+#endif
+
+#endif
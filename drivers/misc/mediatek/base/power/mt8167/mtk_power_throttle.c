@@ -15,6 +15,7 @@
 #include <linux/slab.h> /* kzalloc */
 #include "mtk_static_power.h"	/* static power */
 #include <linux/cpufreq.h>
+#include <linux/cpumask.h>
 #include "mtk_power_throttle.h"
 #include "mt_hotplug_strategy.h"
 #include "mach/mtk_thermal.h"
@@ -24,6 +25,10 @@ static unsigned long clipped_freq;
 static unsigned int limited_max_ncpu;
 static unsigned int limited_max_freq;
 
+/* power model of the cpu node, see mt_cpufreq_set_power_model() */
+static u32 cpu_dyn_coeff;
+static get_static_t cpu_static_func;
+
 #define NR_MAX_OPP_TBL  8
 #define NR_MAX_CPU      4
 
@@ -120,6 +125,29 @@ struct mt_cpu_freq_info opp_tbl_default[] = {
 	OP(0, 0),
 };
 
+/* power of ncpu + 1 cores at oppidx from the dynamic/static power coefficients */
+static int _power_model_calculation(struct mt_cpu_dvfs *p, int oppidx, int ncpu)
+{
+	unsigned long mhz = p->opp_tbl[oppidx].cpufreq_khz / 1000;
+	unsigned long mv = p->opp_tbl[oppidx].cpufreq_volt / 1000;
+	u32 p_static = 0;
+	cpumask_t cpus;
+	u64 p_dynamic;
+	int i;
+
+	/* C * f * V^2 per core, the same model as the cpufreq power cooling device */
+	p_dynamic = (u64)cpu_dyn_coeff * mhz * mv * mv;
+	do_div(p_dynamic, 1000000000);
+
+	cpumask_clear(&cpus);
+	for (i = 0; i <= ncpu; i++)
+		cpumask_set_cpu(i, &cpus);
+	if (cpu_static_func)
+		cpu_static_func(&cpus, 0, mv, &p_static);
+
+	return (int)p_dynamic * (ncpu + 1) + p_static;
+}
+
 static void _power_calculation(struct mt_cpu_dvfs *p, int oppidx, int ncpu)
 {
 /* TBD, need MN confirm */
@@ -131,6 +159,12 @@ static void _power_calculation(struct mt_cpu_dvfs *p, int oppidx, int ncpu)
 	int	p_dynamic = 0, p_leakage = 0;
 	int possible_cpu = NR_MAX_CPU;
 	int	temp;
+	int power;
+
+	if (cpu_dyn_coeff) {
+		power = _power_model_calculation(p, oppidx, ncpu);
+		goto out;
+	}
 
 	ref_freq  = CA35_REF_FREQ;
 	ref_volt  = CA35_REF_VOLT;
@@ -146,12 +180,15 @@ static void _power_calculation(struct mt_cpu_dvfs *p, int oppidx, int ncpu)
 	p->opp_tbl[oppidx].cpufreq_volt / ref_volt +
 	p_leakage;
 
+	power = p_dynamic * (ncpu + 1) / possible_cpu;
+
+out:
 	p->power_tbl[NR_MAX_OPP_TBL * (possible_cpu - 1 - ncpu) + oppidx].cpufreq_ncpu
 		= ncpu + 1;
 	p->power_tbl[NR_MAX_OPP_TBL * (possible_cpu - 1 - ncpu) + oppidx].cpufreq_khz
 		= p->opp_tbl[oppidx].cpufreq_khz;
 	p->power_tbl[NR_MAX_OPP_TBL * (possible_cpu - 1 - ncpu) + oppidx].cpufreq_power
-		= ((p_dynamic * (ncpu + 1) / possible_cpu < 0)?0:p_dynamic * (ncpu + 1) / possible_cpu);
+		= (power < 0) ? 0 : power;
 }
 
 void init_mt_cpu_dvfs(struct mt_cpu_dvfs *p)
@@ -185,12 +222,12 @@ int setup_power_table(struct mt_cpu_dvfs *p)
 
 	WARN_ON(p == NULL);
 
-	if (p->power_tbl)
-		goto out;
-
-	/* allocate power table */
 	memset((void *)pwr_eff_tbl, 0, sizeof(pwr_eff_tbl));
-	p->power_tbl = kzalloc(p->nr_opp_tbl * possible_cpu * sizeof(struct mt_cpu_power_info), GFP_KERNEL);
+
+	/* allocate power table, it is recalculated in place on model updates */
+	if (!p->power_tbl)
+		p->power_tbl = kzalloc(p->nr_opp_tbl * possible_cpu * sizeof(struct mt_cpu_power_info),
+				       GFP_KERNEL);
 
 	if (p->power_tbl == NULL) {
 		ret = -ENOMEM;
@@ -333,6 +370,7 @@ void mt_cpufreq_thermal_protect(unsigned int limited_power)
 
 	WARN_ON(p == NULL);
 
+	p->thermal_protect_limited_power = limited_power;
 	possible_cpu = NR_MAX_CPU;
 
 	/* no limited */
@@ -376,3 +414,39 @@ void mt_cpufreq_thermal_protect(unsigned int limited_power)
 	cpufreq_update_policy(0);
 }
 
+/*
+ * Switch the power table from the reference CA35 figures to the power model
+ * of the cpu node: @dyn_coeff is the dynamic-power-coefficient and
+ * @static_func the static power callback handed to the power cooling device.
+ */
+void mt_cpufreq_set_power_model(u32 dyn_coeff, get_static_t static_func)
+{
+	cpu_dyn_coeff = dyn_coeff;
+	cpu_static_func = static_func;
+
+	if (power_table_ready) {
+		setup_power_table(&cpu_dvfs);
+		/* re-apply the current limit against the new table */
+		if (cpu_dvfs.thermal_protect_limited_power)
+			mt_cpufreq_thermal_protect(cpu_dvfs.thermal_protect_limited_power);
+	}
+}
+
+/* Power of the online cpus at the current frequency, 0 if unknown */
+unsigned int mt_cpufreq_get_cur_power(void)
+{
+	unsigned int cur_khz = cpufreq_quick_get(0);
+	unsigned int ncpu = num_online_cpus();
+	int i;
+
+	if (power_table_ready == 0)
+		return 0;
+
+	for (i = 0; i < cpu_dvfs.nr_power_tbl; i++) {
+		if (cpu_dvfs.power_tbl[i].cpufreq_khz == cur_khz &&
+		    cpu_dvfs.power_tbl[i].cpufreq_ncpu == ncpu)
+			return cpu_dvfs.power_tbl[i].cpufreq_power;
+	}
+
+	return 0;
+}
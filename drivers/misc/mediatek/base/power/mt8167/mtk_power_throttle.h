@@ -14,6 +14,8 @@
 #ifndef MT_POWERTHROTTLE_H
 #define MT_POWERTHROTTLE_H
 
+#include <linux/cpu_cooling.h>
+
 struct mt_cpu_freq_info {
 	unsigned int cpufreq_khz;
 	unsigned int cpufreq_volt;  /* mv * 1000 */
@@ -31,5 +33,17 @@ extern int setup_power_table_tk(void);
 extern void dump_power_table(void);
 extern void mt_cpufreq_thermal_protect(unsigned int limited_power);
 extern void dump_power_table(void);
+extern void mt_cpufreq_set_power_model(u32 dyn_coeff, get_static_t static_func);
+extern unsigned int mt_cpufreq_get_cur_power(void);
+
+/* GPU power at the current OPP and loading, in mtk_ts_cpu.c */
+#ifdef CONFIG_THERMAL
+extern unsigned int mtk_thermal_get_gpu_power(void);
+#else
+static inline unsigned int mtk_thermal_get_gpu_power(void)
+{
+	return 0;
+}
+#endif
 #endif
 
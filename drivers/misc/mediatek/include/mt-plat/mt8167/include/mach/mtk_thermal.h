@@ -315,6 +315,9 @@ extern int is_cpu_power_min(void);	/* in mtk_ts_cpu.c */
 extern int get_cpu_target_tj(void);
 extern int get_cpu_target_offset(void);
 
+extern int cl_cam_get_request_power(void);	/* in mtk_cooler_cam.c */
+extern void cl_cam_set_power_budget(int budget);	/* in mtk_cooler_cam.c */
+
 extern int mtktscpu_debug_log;
 
 #endif
@@ -328,10 +328,7 @@ int m4u_dealloc_mva(M4U_MODULE_ID_ENUM eModuleID,
 mva_info_t *m4u_delete_from_garbage_list(M4U_MOUDLE_STRUCT *p_m4u_module,
 						struct file *a_pstFile);
 int m4u_cache_sync_init(void);
-struct page *m4u_cache_get_page(unsigned long va);
 int __m4u_cache_sync_kernel(const void *start, size_t size, int direction);
-void *m4u_cache_map_page_va(struct page *page);
-void m4u_cache_unmap_page_va(unsigned long va);
 int __m4u_cache_sync_user(unsigned long start, size_t size, int direction);
 int m4u_do_dma_cache_maint(M4U_MODULE_ID_ENUM eModuleID, const void *va, size_t size, int direction);
 int m4u_dma_cache_maint(M4U_MODULE_ID_ENUM eModuleID,
@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) 2015 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Binary memory log
+ *
+ * The first page of the mapping holds struct mlog_bin_header, the record
+ * ring follows at data_offset. Every sample is one record:
+ *
+ *   struct mlog_bin_rec           16 bytes, len covers the whole record
+ *   MLOG_NR_GLOBAL values         meminfo, vmstat, normal/high buddyinfo
+ *   process entries               terminated by a zero pid
+ *
+ * Values are LEB128 varints. In a keyframe record they are absolute, in
+ * the other records globals are zigzag-encoded deltas against the previous
+ * record. A process entry is
+ *
+ *   pid, flags, score_adj (zigzag), rss, rswap, swap_in, swap_out, fm_flt
+ *
+ * with the five counters absolute when MLOG_BIN_P_ABS is set and deltas
+ * against that pid's previous entry otherwise; MLOG_BIN_P_GONE entries
+ * stop after the flags. Only processes whose rss, swap or score_adj moved
+ * are emitted. Readers drop their process table at every keyframe, which
+ * is also how exited processes disappear.
+ *
+ * The producer first publishes reserve, the end of the record it is about
+ * to write, then writes the record and publishes head (bytes ever written)
+ * with release ordering. A reader consumes [tail, head) modulo data_size:
+ * it loads head with acquire ordering, copies a record, issues a read
+ * barrier and loads reserve. The copy is only valid if reserve - tail is
+ * still within data_size, otherwise the reader restarts from the last
+ * keyframe.
+ *
+ * Records are encoded into a staging buffer while walking the processes
+ * under RCU, mlog_bin_lock only covers the copy into the ring. A sample
+ * that finds another one in progress is dropped.
+ */
+
+#include <linux/types.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/rcupdate.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/wait.h>
+
+#include "mlog_internal.h"
+#include "mlog_bin.h"
+
+#define MLOG_BIN_MAGIC          0x474f4c4d	/* "MLOG" */
+#define MLOG_BIN_VERSION        2
+#define MLOG_BIN_DATA_SHIFT     17		/* 128kB */
+#define MLOG_BIN_DATA_SIZE      (1 << MLOG_BIN_DATA_SHIFT)
+#define MLOG_BIN_DATA_MASK      (MLOG_BIN_DATA_SIZE - 1)
+/* cap one record so that a keyframe never wraps over itself */
+#define MLOG_BIN_REC_MAX        (MLOG_BIN_DATA_SIZE / 4)
+/* room for the process entry that crosses MLOG_BIN_REC_MAX */
+#define MLOG_BIN_STAGE_SIZE     (MLOG_BIN_REC_MAX + 256)
+
+#define MLOG_BIN_REC_MAGIC      0x424d
+
+#define MLOG_BIN_F_KEYFRAME     (1 << 0)
+#define MLOG_BIN_F_TRUNCATED    (1 << 1)
+
+#define MLOG_BIN_P_ABS          (1 << 0)
+#define MLOG_BIN_P_GONE         (1 << 1)
+
+struct mlog_bin_header {
+	__u32 magic;
+	__u16 version;
+	__u16 nr_global;
+	__u32 data_offset;
+	__u32 data_size;
+	__u64 head;		/* producer index, bytes ever written */
+	__u64 keyframe;		/* head value at the start of the last keyframe */
+	__u64 reserve;		/* end of the record being written */
+};
+
+struct mlog_bin_rec {
+	__u16 magic;
+	__u8 type;
+	__u8 flags;
+	__u32 len;
+	__u64 ts;		/* local_clock() in ns */
+};
+
+bool mlog_bin_enable;
+static uint mlog_bin_keyframe_intval = 32;
+
+static DEFINE_SPINLOCK(mlog_bin_lock);
+static DECLARE_WAIT_QUEUE_HEAD(mlog_bin_wait);
+static void *mlog_bin_area;
+static struct mlog_bin_header *mlog_bin_hdr;
+static u8 *mlog_bin_data;
+static u8 *mlog_bin_stage;
+
+/* ring position, protected by mlog_bin_lock */
+static u64 mlog_bin_head;
+
+/* encoder state, owned by the sampler holding mlog_bin_busy */
+static unsigned long mlog_bin_busy;
+static size_t mlog_bin_pos;
+static unsigned int mlog_bin_samples;
+static unsigned int mlog_bin_gen;
+static unsigned long mlog_bin_prev[MLOG_NR_GLOBAL];
+static bool mlog_bin_restart;
+
+static inline void mlog_bin_put_u8(u8 v)
+{
+	mlog_bin_stage[mlog_bin_pos++] = v;
+}
+
+static void mlog_bin_put_uvar(u64 v)
+{
+	while (v >= 0x80) {
+		mlog_bin_put_u8(v | 0x80);
+		v >>= 7;
+	}
+	mlog_bin_put_u8(v);
+}
+
+static void mlog_bin_put_svar(s64 v)
+{
+	mlog_bin_put_uvar(((u64)v << 1) ^ (u64)(v >> 63));
+}
+
+static void mlog_bin_put_value(unsigned long cur, unsigned long prev, bool abs)
+{
+	if (abs)
+		mlog_bin_put_uvar(cur);
+	else
+		mlog_bin_put_svar((long)(cur - prev));
+}
+
+static void mlog_bin_put_at(u64 pos, const void *src, size_t len)
+{
+	size_t off = pos & MLOG_BIN_DATA_MASK;
+	size_t n = min_t(size_t, len, MLOG_BIN_DATA_SIZE - off);
+
+	memcpy(mlog_bin_data + off, src, n);
+	memcpy(mlog_bin_data, (const u8 *)src + n, len - n);
+}
+
+/* @p is trylocked, so p->mm is stable */
+static void mlog_bin_proc(struct task_struct *p)
+{
+	struct mlog_mm_snapshot *snap = &p->mm->mlog_snap;
+	int adj = p->signal->oom_score_adj;
+	unsigned long rss = P2K(get_mm_rss(p->mm));
+	unsigned long rswap = P2K(get_mm_counter(p->mm, MM_SWAPENTS));
+	unsigned long prev_rss = snap->rss;
+	unsigned long prev_rswap = snap->rswap;
+	unsigned long swap_in, swap_out, fm_flt;
+	bool abs;
+
+	/* fast path: nothing moved since this mm was last sampled */
+	if (snap->pid == p->pid && snap->gen == mlog_bin_gen &&
+	    snap->adj == adj && snap->rss == rss && snap->rswap == rswap)
+		return;
+
+	abs = snap->pid != p->pid || snap->gen != mlog_bin_gen || !snap->emitted;
+
+	snap->pid = p->pid;
+	snap->gen = mlog_bin_gen;
+	snap->adj = adj;
+	snap->rss = rss;
+	snap->rswap = rswap;
+
+	if (!mlog_proc_wanted(p, adj)) {
+		if (!abs) {
+			mlog_bin_put_uvar(p->pid);
+			mlog_bin_put_u8(MLOG_BIN_P_GONE);
+		}
+		snap->emitted = false;
+		return;
+	}
+
+	mlog_proc_faults(p, &swap_in, &swap_out, &fm_flt);
+
+	mlog_bin_put_uvar(p->pid);
+	mlog_bin_put_u8(abs ? MLOG_BIN_P_ABS : 0);
+	mlog_bin_put_svar(adj);
+	mlog_bin_put_value(rss, prev_rss, abs);
+	mlog_bin_put_value(rswap, prev_rswap, abs);
+	mlog_bin_put_value(swap_in, snap->swap_in, abs);
+	mlog_bin_put_value(swap_out, snap->swap_out, abs);
+	mlog_bin_put_value(fm_flt, snap->fm_flt, abs);
+
+	snap->swap_in = swap_in;
+	snap->swap_out = swap_out;
+	snap->fm_flt = fm_flt;
+	snap->emitted = true;
+}
+
+void mlog_bin_sample(int type)
+{
+	unsigned long v[MLOG_NR_GLOBAL];
+	struct mlog_bin_rec rec;
+	struct task_struct *tsk;
+	u64 start;
+	bool key;
+	int i;
+
+	if (!mlog_bin_area)
+		return;
+
+	if (test_and_set_bit_lock(0, &mlog_bin_busy))
+		return;
+
+	rec.ts = local_clock();
+	mlog_collect_global(v);
+
+	if (xchg(&mlog_bin_restart, false))
+		mlog_bin_samples = 0;
+	key = mlog_bin_samples++ % max(mlog_bin_keyframe_intval, 1U) == 0;
+	if (key)
+		mlog_bin_gen++;
+
+	mlog_bin_pos = sizeof(rec);
+	rec.flags = key ? MLOG_BIN_F_KEYFRAME : 0;
+
+	for (i = 0; i < MLOG_NR_GLOBAL; ++i) {
+		mlog_bin_put_value(v[i], mlog_bin_prev[i], key);
+		mlog_bin_prev[i] = v[i];
+	}
+
+	rcu_read_lock();
+	for_each_process(tsk) {
+		struct task_struct *p;
+
+		if (tsk->flags & PF_KTHREAD)
+			continue;
+
+		/* the remaining processes are picked up by the next sample */
+		if (mlog_bin_pos > MLOG_BIN_REC_MAX) {
+			rec.flags |= MLOG_BIN_F_TRUNCATED;
+			break;
+		}
+
+		p = find_trylock_task_mm(tsk);
+		if (!p)
+			continue;
+
+		if (p->signal)
+			mlog_bin_proc(p);
+
+		task_unlock(p);
+	}
+	rcu_read_unlock();
+	mlog_bin_put_uvar(0);
+
+	rec.magic = MLOG_BIN_REC_MAGIC;
+	rec.type = type;
+	rec.len = mlog_bin_pos;
+	memcpy(mlog_bin_stage, &rec, sizeof(rec));
+
+	spin_lock_bh(&mlog_bin_lock);
+	start = mlog_bin_head;
+	mlog_bin_head += rec.len;
+
+	/* readers recheck reserve after copying, see the top of this file */
+	WRITE_ONCE(mlog_bin_hdr->reserve, mlog_bin_head);
+	smp_wmb();
+	mlog_bin_put_at(start, mlog_bin_stage, rec.len);
+
+	if (key)
+		WRITE_ONCE(mlog_bin_hdr->keyframe, start);
+	/* publish the record, pairs with the reader's load-acquire of head */
+	smp_store_release(&mlog_bin_hdr->head, mlog_bin_head);
+	spin_unlock_bh(&mlog_bin_lock);
+
+	clear_bit_unlock(0, &mlog_bin_busy);
+
+	if (waitqueue_active(&mlog_bin_wait))
+		wake_up_interruptible(&mlog_bin_wait);
+}
+
+int mlog_bin_open(struct inode *inode, struct file *file)
+{
+	u64 *seen;
+
+	if (!mlog_bin_area)
+		return -ENOMEM;
+
+	seen = kmalloc(sizeof(*seen), GFP_KERNEL);
+	if (!seen)
+		return -ENOMEM;
+
+	*seen = READ_ONCE(mlog_bin_hdr->head);
+	file->private_data = seen;
+	return nonseekable_open(inode, file);
+}
+
+int mlog_bin_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+int mlog_bin_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, mlog_bin_area, vma->vm_pgoff);
+}
+
+/* POLLIN once per batch of records published since the previous POLLIN */
+unsigned int mlog_bin_poll(struct file *file, poll_table *wait)
+{
+	u64 *seen = file->private_data;
+	u64 head;
+
+	poll_wait(file, &mlog_bin_wait, wait);
+
+	head = smp_load_acquire(&mlog_bin_hdr->head);
+	if (head == *seen)
+		return 0;
+
+	*seen = head;
+	return POLLIN | POLLRDNORM;
+}
+
+void mlog_bin_init(void)
+{
+	mlog_bin_stage = vmalloc(MLOG_BIN_STAGE_SIZE);
+	if (!mlog_bin_stage) {
+		pr_err("[mlog] no memory for binary log\n");
+		return;
+	}
+
+	mlog_bin_area = vmalloc_user(PAGE_SIZE + MLOG_BIN_DATA_SIZE);
+	if (!mlog_bin_area) {
+		pr_err("[mlog] no memory for binary log\n");
+		vfree(mlog_bin_stage);
+		mlog_bin_stage = NULL;
+		return;
+	}
+
+	mlog_bin_hdr = mlog_bin_area;
+	mlog_bin_data = (u8 *)mlog_bin_area + PAGE_SIZE;
+
+	mlog_bin_hdr->magic = MLOG_BIN_MAGIC;
+	mlog_bin_hdr->version = MLOG_BIN_VERSION;
+	mlog_bin_hdr->nr_global = MLOG_NR_GLOBAL;
+	mlog_bin_hdr->data_offset = PAGE_SIZE;
+	mlog_bin_hdr->data_size = MLOG_BIN_DATA_SIZE;
+}
+
+void mlog_bin_exit(void)
+{
+	vfree(mlog_bin_area);
+	mlog_bin_area = NULL;
+	vfree(mlog_bin_stage);
+	mlog_bin_stage = NULL;
+}
+
+static int do_bin_enable_handler(const char *val, const struct kernel_param *kp)
+{
+	const int ret = param_set_bool(val, kp);
+
+	/* restart the stream on a keyframe */
+	WRITE_ONCE(mlog_bin_restart, true);
+	return ret;
+}
+
+static const struct kernel_param_ops param_ops_bin_enable = {
+	.set = &do_bin_enable_handler,
+	.get = &param_get_bool,
+	.free = NULL,
+};
+
+module_param_cb(bin_enable, &param_ops_bin_enable, &mlog_bin_enable, S_IRUGO | S_IWUSR);
+__MODULE_PARM_TYPE(bin_enable, bool);
+module_param_named(bin_keyframe_intval, mlog_bin_keyframe_intval, uint, S_IRUGO | S_IWUSR);
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2015 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _MLOG_BIN_H
+#define _MLOG_BIN_H
+
+#include <linux/fs.h>
+#include <linux/poll.h>
+
+extern bool mlog_bin_enable;
+
+extern void mlog_bin_init(void);
+extern void mlog_bin_exit(void);
+extern void mlog_bin_sample(int type);
+
+extern int mlog_bin_open(struct inode *inode, struct file *file);
+extern int mlog_bin_release(struct inode *inode, struct file *file);
+extern int mlog_bin_mmap(struct file *file, struct vm_area_struct *vma);
+extern unsigned int mlog_bin_poll(struct file *file, poll_table *wait);
+
+#endif
@@ -26,6 +26,7 @@
 
 #include "mlog_internal.h"
 #include "mlog_dump.h"
+#include "mlog_bin.h"
 
 static int mlog_open(struct inode *inode, struct file *file)
 {
@@ -90,9 +91,17 @@ static const struct file_operations proc_dmlog_operations = {
 	.release = dmlog_release,
 };
 
+static const struct file_operations proc_mlog_bin_operations = {
+	.open = mlog_bin_open,
+	.mmap = mlog_bin_mmap,
+	.poll = mlog_bin_poll,
+	.release = mlog_bin_release,
+};
+
 void mlog_init_procfs(void)
 {
 	debugfs_create_file("mlog_fmt", S_IRUGO, NULL, NULL, &mlog_fmt_proc_fops);
 	debugfs_create_file("mlog", S_IRUGO, NULL, NULL, &proc_mlog_operations);
 	debugfs_create_file("dmlog", S_IRUGO, NULL, NULL, &proc_dmlog_operations);
+	debugfs_create_file("mlog_bin", S_IRUGO, NULL, NULL, &proc_mlog_bin_operations);
 }
@@ -15,6 +15,8 @@
 #define _MLOG_INTERNAL_H
 
 #include <linux/printk.h>
+#include <linux/mmzone.h>
+#include <linux/sched.h>
 
 #define MLOG_DEBUG
 
@@ -24,4 +26,18 @@
 #define MLOG_PRINTK(args...)    do { } while (0)
 #endif
 
+#define P2K(x) (((unsigned long)x) << (PAGE_SHIFT - 10))
+
+/* fixed-size global sample: meminfo, vmstat events, normal/high buddyinfo */
+#define MLOG_NR_MEMINFO     14
+#define MLOG_NR_VMSTAT      3
+#define MLOG_NR_BUDDYINFO   (2 * MAX_ORDER)
+#define MLOG_NR_GLOBAL      (MLOG_NR_MEMINFO + MLOG_NR_VMSTAT + MLOG_NR_BUDDYINFO)
+
+extern int mlog_collect_global(unsigned long *v);
+extern struct task_struct *find_trylock_task_mm(struct task_struct *t);
+extern bool mlog_proc_wanted(struct task_struct *p, int oom_score_adj);
+extern void mlog_proc_faults(struct task_struct *p, unsigned long *swap_in,
+		unsigned long *swap_out, unsigned long *fm_flt);
+
 #endif
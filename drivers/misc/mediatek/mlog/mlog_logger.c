@@ -49,10 +49,10 @@
 
 #include "mlog_internal.h"
 #include "mlog_logger.h"
+#include "mlog_bin.h"
 
 #define CONFIG_MLOG_BUF_SHIFT   16	/* 64KB for 32bit, 128kB for 64bit */
 
-#define P2K(x) (((unsigned long)x) << (PAGE_SHIFT - 10))
 #define B2K(x) (((unsigned long)x) >> (10))
 
 
@@ -470,7 +470,7 @@ static void mlog_reset_buffer(void)
 #define mtkpasr_show_page_reserved(void) (0)
 #endif
 
-static void mlog_meminfo(void)
+static void mlog_get_meminfo(unsigned long *v)
 {
 	unsigned long memfree;
 	unsigned long swapfree;
@@ -522,60 +522,78 @@ static void mlog_meminfo(void)
 	ion = B2K((unsigned long)ion_mm_heap_total_memory());
 #endif
 
-	spin_lock_bh(&mlogbuf_lock);
-	mlog_emit_32(memfree);
-	mlog_emit_32(swapfree);
-	mlog_emit_32(cached);
+	v[0] = memfree;
+	v[1] = swapfree;
+	v[2] = cached;
 
 	/* kernel memory usage */
-	mlog_emit_32(kernel_stack);
-	mlog_emit_32(page_table);
-	mlog_emit_32(slab);
+	v[3] = kernel_stack;
+	v[4] = page_table;
+	v[5] = slab;
 	/* hardware memory usage */
-	mlog_emit_32(gpuuse);
-	mlog_emit_32(gpu_page_cache);
-	mlog_emit_32(mlock);
-	mlog_emit_32(zram);
-	mlog_emit_32(active);
-	mlog_emit_32(inactive);
-	mlog_emit_32(shmem);
-	mlog_emit_32(ion);
+	v[6] = gpuuse;
+	v[7] = gpu_page_cache;
+	v[8] = mlock;
+	v[9] = zram;
+	v[10] = active;
+	v[11] = inactive;
+	v[12] = shmem;
+	v[13] = ion;
+}
+
+static void mlog_meminfo(void)
+{
+	unsigned long v[MLOG_NR_MEMINFO];
+	int i;
+
+	mlog_get_meminfo(v);
+
+	spin_lock_bh(&mlogbuf_lock);
+	for (i = 0; i < MLOG_NR_MEMINFO; ++i)
+		mlog_emit_32(v[i]);
 	spin_unlock_bh(&mlogbuf_lock);
 }
 
-static void mlog_vmstat(void)
+static void mlog_get_vmstat(unsigned long *v)
 {
 	int cpu;
-	unsigned long v[NR_VM_EVENT_ITEMS];
 
-	memset(v, 0, NR_VM_EVENT_ITEMS * sizeof(unsigned long));
+	v[0] = v[1] = v[2] = 0;
 
 	for_each_online_cpu(cpu) {
 		struct vm_event_state *this = &per_cpu(vm_event_states, cpu);
 
-		v[PSWPIN] += this->event[PSWPIN];
-		v[PSWPOUT] += this->event[PSWPOUT];
-		v[PGFMFAULT] += this->event[PGFMFAULT];
+		v[0] += this->event[PSWPIN];
+		v[1] += this->event[PSWPOUT];
+		v[2] += this->event[PGFMFAULT];
 	}
+}
 
-	spin_lock_bh(&mlogbuf_lock);
-	mlog_emit_32(v[PSWPIN]);
-	mlog_emit_32(v[PSWPOUT]);
-	mlog_emit_32(v[PGFMFAULT]);
+static void mlog_vmstat(void)
+{
+	unsigned long v[MLOG_NR_VMSTAT];
+	int i;
+
+	mlog_get_vmstat(v);
 
+	spin_lock_bh(&mlogbuf_lock);
+	for (i = 0; i < MLOG_NR_VMSTAT; ++i)
+		mlog_emit_32(v[i]);
 	spin_unlock_bh(&mlogbuf_lock);
 }
 
-/* static void mlog_buddyinfo(void) */
-void mlog_buddyinfo(void)
+/* normal zone orders in v[0..MAX_ORDER), high zone orders after them */
+static void mlog_get_buddyinfo(unsigned long *v)
 {
 	int i;
 	struct zone *zone;
 	struct zone *node_zones;
 	unsigned int order;
 	int zone_nr = 0;
-	unsigned long normal_nr_free[MAX_ORDER] = {0};
-	unsigned long high_nr_free[MAX_ORDER] = {0};
+	unsigned long *normal_nr_free = v;
+	unsigned long *high_nr_free = v + MAX_ORDER;
+
+	memset(v, 0, MLOG_NR_BUDDYINFO * sizeof(unsigned long));
 
 	for_each_online_node(i) {
 		pg_data_t *pgdat = NODE_DATA(i);
@@ -612,20 +630,30 @@ void mlog_buddyinfo(void)
 		high_nr_free[MAX_ORDER - 1] += (mtkpasr_show_page_reserved() >> (MAX_ORDER - 1));
 
 #endif
+}
 
-	spin_lock_bh(&mlogbuf_lock);
-
-	for (order = 0; order < MAX_ORDER; ++order)
-		mlog_emit_32(normal_nr_free[order]);
-
-
-	for (order = 0; order < MAX_ORDER; ++order)
-		mlog_emit_32(high_nr_free[order]);
+/* static void mlog_buddyinfo(void) */
+void mlog_buddyinfo(void)
+{
+	unsigned long v[MLOG_NR_BUDDYINFO];
+	int i;
 
+	mlog_get_buddyinfo(v);
 
+	spin_lock_bh(&mlogbuf_lock);
+	for (i = 0; i < MLOG_NR_BUDDYINFO; ++i)
+		mlog_emit_32(v[i]);
 	spin_unlock_bh(&mlogbuf_lock);
 }
 
+int mlog_collect_global(unsigned long *v)
+{
+	mlog_get_meminfo(v);
+	mlog_get_vmstat(v + MLOG_NR_MEMINFO);
+	mlog_get_buddyinfo(v + MLOG_NR_MEMINFO + MLOG_NR_VMSTAT);
+	return MLOG_NR_GLOBAL;
+}
+
 struct task_struct *find_trylock_task_mm(struct task_struct *t)
 {
 	if (spin_trylock(&t->alloc_lock)) {
@@ -636,6 +664,83 @@ struct task_struct *find_trylock_task_mm(struct task_struct *t)
 	return NULL;
 }
 
+/*
+ * Decide whether @p (trylocked through find_trylock_task_mm()) belongs in
+ * the per-process log. Called under rcu_read_lock().
+ */
+bool mlog_proc_wanted(struct task_struct *p, int oom_score_adj)
+{
+	const struct cred *cred;
+	struct task_struct *real_parent;
+	bool wanted = false;
+
+	if (max_adj < oom_score_adj || oom_score_adj < min_adj)
+		return false;
+
+	if (limit_pid != -1 && p->pid != limit_pid)
+		return false;
+
+	cred = get_task_cred(p);
+	if (!cred)
+		return false;
+
+	/*
+	 * 1. mediaserver is a suspect in many ANR/FLM cases.
+	 * 2. procesname is "mediaserver" not "/system/bin/mediaserver"
+	 */
+	if (strncmp("mediaserver", p->comm, TASK_COMM_LEN) == 0) {
+		wanted = true;
+		goto out;
+	}
+
+	/* skip root user */
+	if (__kuid_val(cred->uid) == AID_ROOT)
+		goto out;
+
+	real_parent = rcu_dereference(p->real_parent);
+	if (!real_parent)
+		goto out;
+
+	/* skip non java proc (parent is init) */
+	if (real_parent->pid == 1)
+		goto out;
+
+	/* only keep system server */
+	if (oom_score_adj == -16 && __kuid_val(cred->uid) != AID_SYSTEM)
+		goto out;
+
+	wanted = true;
+out:
+	put_cred(cred);
+	return wanted;
+}
+
+/* sum the thrashing and swap counters over all threads of @p */
+void mlog_proc_faults(struct task_struct *p, unsigned long *swap_in,
+		unsigned long *swap_out, unsigned long *fm_flt)
+{
+	struct task_struct *t;
+
+	*swap_in = *swap_out = *fm_flt = 0;
+
+	t = p;
+	do {
+		*fm_flt += t->fm_flt;
+#ifdef CONFIG_SWAP
+		*swap_in += t->swap_in;
+		*swap_out += t->swap_out;
+#endif
+		t = next_thread(t);
+#ifdef MLOG_DEBUG
+#if defined(__LP64__) || defined(_LP64)
+		if ((long long)t < 0xffffffc000000000)
+			break;
+#endif
+#endif
+
+	} while (t != p);
+}
+
 static void mlog_procinfo(void)
 {
 	struct task_struct *tsk;
@@ -643,12 +748,8 @@ static void mlog_procinfo(void)
 	rcu_read_lock();
 	for_each_process(tsk) {
 		int oom_score_adj;
-		const struct cred *cred = NULL;
-		struct task_struct *real_parent;
 		struct task_struct *p;
-		pid_t ppid;
-		struct task_struct *t;
-		unsigned long swap_in, swap_out, fm_flt, min_flt, maj_flt;
+		unsigned long swap_in, swap_out, fm_flt;
 		unsigned long rss;
 		unsigned long rswap;
 
@@ -664,66 +765,10 @@ static void mlog_procinfo(void)
 
 		oom_score_adj = p->signal->oom_score_adj;
 
-		if (max_adj < oom_score_adj || oom_score_adj < min_adj)
-			goto unlock_continue;
-
-		if (limit_pid != -1 && p->pid != limit_pid)
-			goto unlock_continue;
-
-		cred = get_task_cred(p);
-		if (!cred)
-			goto unlock_continue;
-
-		/*
-		 * 1. mediaserver is a suspect in many ANR/FLM cases.
-		 * 2. procesname is "mediaserver" not "/system/bin/mediaserver"
-		 */
-		if (strncmp("mediaserver", p->comm, TASK_COMM_LEN) == 0)
-			goto collect_proc_mem_info;
-
-		/* skip root user */
-		if (__kuid_val(cred->uid) == AID_ROOT)
-			goto unlock_continue;
-
-		real_parent = rcu_dereference(p->real_parent);
-		if (!real_parent)
+		if (!mlog_proc_wanted(p, oom_score_adj))
 			goto unlock_continue;
 
-		ppid = real_parent->pid;
-		/* skip non java proc (parent is init) */
-		if (ppid == 1)
-			goto unlock_continue;
-
-		if (oom_score_adj == -16) {
-			/* only keep system server */
-			if (__kuid_val(cred->uid) != AID_SYSTEM)
-				goto unlock_continue;
-		}
-
-collect_proc_mem_info:
-		/* reset data */
-		swap_in = swap_out = fm_flt = min_flt = maj_flt = 0;
-
-		/* all threads */
-		t = p;
-		do {
-			/* min_flt += t->min_flt; */
-			/* maj_flt += t->maj_flt; */
-
-			fm_flt += t->fm_flt;
-#ifdef CONFIG_SWAP
-			swap_in += t->swap_in;
-			swap_out += t->swap_out;
-#endif
-			t = next_thread(t);
-#ifdef MLOG_DEBUG
-#if defined(__LP64__) || defined(_LP64)
-			if ((long long)t < 0xffffffc000000000)
-				break;
-#endif
-#endif
-
-		} while (t != p);
+		mlog_proc_faults(p, &swap_in, &swap_out, &fm_flt);
 
 		/* emit log */
 		rss = P2K(get_mm_rss(p->mm));
@@ -745,9 +790,6 @@ collect_proc_mem_info:
 		spin_unlock_bh(&mlogbuf_lock);
 
  unlock_continue:
-		if (cred)
-			put_cred(cred);
-
 		task_unlock(p);
 	}
 	rcu_read_unlock();
@@ -764,6 +806,12 @@ void mlog(int type)
 #endif
 	/* MLOG_PRINTK("[mlog] log %d %d %d\n", meminfo_filter, vmstat_filter, proc_filter); */
 
+	/* binary mode replaces the text records */
+	if (mlog_bin_enable) {
+		mlog_bin_sample(type);
+		return;
+	}
+
 	/* time stamp */
 	microsec_rem = do_div(t, 1000000000);
 
@@ -964,6 +1012,7 @@ static void mlog_init_logger(void)
 	spin_lock_init(&mlogbuf_lock);
 	mlog_reset_format();
 	mlog_reset_buffer();
+	mlog_bin_init();
 
 	setup_timer(&mlog_timer, mlog_timer_handler, 0);
 	mlog_timer.expires = jiffies + timer_intval;
@@ -973,6 +1022,7 @@ static void mlog_init_logger(void)
 
 static void mlog_exit_logger(void)
 {
+	mlog_bin_exit();
 
 	kfree(strfmt_list);
 	strfmt_list = NULL;
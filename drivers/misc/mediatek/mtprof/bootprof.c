@@ -11,6 +11,7 @@
  * GNU General Public License for more details.
  */
 
+#include <linux/async.h>
 #include <linux/proc_fs.h>
 #include <linux/sched.h>
 #include <linux/kallsyms.h>
@@ -57,6 +58,14 @@ bool boot_finish;
 module_param_named(pl_t, bootprof_pl_t, int, S_IRUGO | S_IWUSR);
 module_param_named(lk_t, bootprof_lk_t, int, S_IRUGO | S_IWUSR);
 
+/*
+ * Comma separated driver names whose probes are held back until boot
+ * completes, i.e. until bootprof is switched off.
+ */
+static char bootprof_defer_drvs[256];
+module_param_string(defer_probe, bootprof_defer_drvs,
+		    sizeof(bootprof_defer_drvs), S_IRUGO);
+
 #define MSG_SIZE 128
 
 void log_boot(char *str)
@@ -138,7 +147,9 @@ void bootprof_probe(unsigned long long ts, struct device *dev,
 		return;
 	msec_rem = do_div(ts, NSEC_PER_MSEC);
 
-	pos += snprintf(msgbuf, MSG_SIZE, "probe: probe=%pf", (void *)probe);
+	/* async probes run off the critical path of kernel_init */
+	pos += snprintf(msgbuf, MSG_SIZE, "probe: probe=%pf%s", (void *)probe,
+			current_is_async() ? " async" : "");
 	if (drv)
 		pos += snprintf(msgbuf + pos, MSG_SIZE - pos, " drv=%s(%p)",
 				drv->name ? drv->name : "",
@@ -166,6 +177,12 @@ void bootprof_pdev_register(unsigned long long ts, struct platform_device *pdev)
 	log_boot(msgbuf);
 }
 
+bool bootprof_probe_held(struct device_driver *drv)
+{
+	return !READ_ONCE(boot_finish) &&
+		parse_option_str(bootprof_defer_drvs, drv->name);
+}
+
 static void bootup_finish(void)
 {
 	initcall_debug = 0;
@@ -176,6 +193,10 @@ static void bootup_finish(void)
 	mt_sched_monitor_switch(1);
 #endif
 	set_logtoomuch_enable(1);
+	if (bootprof_defer_drvs[0]) {
+		pr_info("BOOTPROF: releasing probes of %s\n", bootprof_defer_drvs);
+		driver_deferred_probe_trigger();
+	}
 }
 
 /* extern void (*set_intact_mode)(void); */
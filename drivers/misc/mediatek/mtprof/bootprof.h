@@ -40,4 +40,5 @@ void bootprof_probe(unsigned long long ts, struct device *dev,
 		    struct device_driver *drv, unsigned long probe);
 void bootprof_pdev_register(unsigned long long ts,
 			    struct platform_device *pdev);
+bool bootprof_probe_held(struct device_driver *drv);
 #endif
@@ -27,6 +27,7 @@
 #include <linux/clk.h>
 #include <linux/err.h>
 #include <linux/mm.h>
+#include <linux/sched.h>
 #include <linux/vmalloc.h>
 #include <linux/device.h>
 #include <linux/memblock.h>
@@ -37,6 +38,9 @@
 #include <linux/module.h>
 #include <linux/uaccess.h>
 #include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/highmem.h>
+#include <linux/sizes.h>
 #include <mach/pseudo_m4u.h>
 #include <linux/pagemap.h>
 #include <linux/compat.h>
@@ -1624,31 +1628,68 @@ int m4u_dealloc_mva(M4U_MODULE_ID_ENUM eModuleID,
 	return __m4u_dealloc_mva(eModuleID, BufAddr, BufSize, MVA, NULL);
 }
 
-/* the cache sync related ops are just copy from original implementation of mt7623. */
-static struct vm_struct *cache_map_vm_struct;
+/*
+ * User buffer cache maintenance.
+ *
+ * The data cache is PIPT, so maintenance by any alias of a physical line
+ * hits the same line. Instead of remapping each user page into a shared
+ * kernel window, resolve the user range run by run and operate on the
+ * lowmem linear alias of each physically contiguous run; only highmem pages
+ * go through a per-CPU kmap_atomic slot. There is no global lock left, so
+ * syncs from different processes run in parallel.
+ *
+ * Above m4u_cache_sync_all_thresh it is cheaper to flush the whole cache
+ * than to walk the range; the threshold is measured at init and can be
+ * overridden through the module parameter.
+ */
+static unsigned int m4u_cache_sync_all_thresh = SZ_4M;
+module_param_named(cache_sync_all_thresh, m4u_cache_sync_all_thresh, uint, S_IRUGO | S_IWUSR);
+
+#define M4U_CACHE_CALIB_SIZE	SZ_256K
+
+struct m4u_cache_stat {
+	u64 count;
+	u64 bytes;
+	u64 ns;
+	u64 max_ns;
+	u64 all;
+};
+
+static DEFINE_PER_CPU(struct m4u_cache_stat [M4U_PORT_NR], m4u_cache_stat);
+
 int m4u_cache_sync_init(void)
 {
-	cache_map_vm_struct = get_vm_area(PAGE_SIZE, VM_ALLOC);
-	if (!cache_map_vm_struct)
+	struct page *page;
+	u64 t0, range_ns, all_ns;
+	u64 thresh;
+	void *va;
+
+	page = alloc_pages(GFP_KERNEL, get_order(M4U_CACHE_CALIB_SIZE));
+	if (!page)
 		return -ENOMEM;
 
-	return 0;
-}
+	va = page_address(page);
+	memset(va, 0, M4U_CACHE_CALIB_SIZE);
+	t0 = sched_clock();
+	__m4u_cache_sync_kernel(va, M4U_CACHE_CALIB_SIZE, DMA_BIDIRECTIONAL);
+	range_ns = sched_clock() - t0;
 
-struct page *m4u_cache_get_page(unsigned long va)
-{
-	unsigned long pa, start;
-	struct page *page;
+	memset(va, 0, M4U_CACHE_CALIB_SIZE);
+	t0 = sched_clock();
+	m4u_dma_cache_flush_all();
+	all_ns = sched_clock() - t0;
 
-	start = va & (~M4U_PAGE_MASK);
-	pa = m4u_user_v2p(start);
-	if ((pa == 0)) {
-		M4UMSG("error m4u_get_phys user_v2p return 0 on va=0x%lx\n", start);
-		return NULL;
+	__free_pages(page, get_order(M4U_CACHE_CALIB_SIZE));
+
+	if (range_ns) {
+		thresh = div64_u64(all_ns * M4U_CACHE_CALIB_SIZE, range_ns);
+		m4u_cache_sync_all_thresh = clamp_t(u64, thresh, SZ_1M, SZ_64M);
 	}
-	page = phys_to_page(pa);
 
-	return page;
+	M4UMSG("cache sync: range %lluns/%uKB, all %lluns, all_thresh %uKB\n",
+	       range_ns, M4U_CACHE_CALIB_SIZE >> 10, all_ns, m4u_cache_sync_all_thresh >> 10);
+
+	return 0;
 }
 
 int __m4u_cache_sync_kernel(const void *start, size_t size, int direction)
@@ -1664,89 +1705,66 @@ int __m4u_cache_sync_kernel(const void *start, size_t size, int direction)
 	return 0;
 }
 
-void *m4u_cache_map_page_va(struct page *page)
+static int m4u_cache_sync_highmem(phys_addr_t pa, size_t size, int direction)
 {
-	int ret;
-	struct page **ppPage = &page;
+	void *va = kmap_atomic(phys_to_page(pa));
 
-	ret = map_vm_area(cache_map_vm_struct, PAGE_KERNEL, ppPage);
-	if (ret) {
-		M4UMSG("error to map page\n");
-		return NULL;
-	}
-	return cache_map_vm_struct->addr;
-}
+	__m4u_cache_sync_kernel(va + offset_in_page(pa), size, direction);
+	kunmap_atomic(va);
 
-void m4u_cache_unmap_page_va(unsigned long va)
-{
-	unmap_kernel_range((unsigned long)cache_map_vm_struct->addr, PAGE_SIZE);
+	return 0;
 }
 
-/* lock to protect cache_map_vm_struct */
-static DEFINE_MUTEX(gM4u_cache_sync_user_lock);
-
 int __m4u_cache_sync_user(unsigned long start, size_t size, int direction)
 {
-	unsigned int map_size;
-	unsigned long map_start, map_end;
-	unsigned long end = start + size;
-	/* unsigned int fragment; */
-	struct page *page;
-	unsigned long map_va, map_va_align;
+	struct mm_struct *mm = current->mm;
+	unsigned long va = start, end = start + size;
+	phys_addr_t run_pa = 0, pa;
+	size_t run_size = 0, len;
 	int ret = 0;
 
-	mutex_lock(&gM4u_cache_sync_user_lock);
-
-	if (!cache_map_vm_struct) {
-		M4UMSG("error: cache_map_vm_struct is NULL, retry\n");
-		m4u_cache_sync_init();
-	}
-	if (!cache_map_vm_struct) {
-		M4UMSG("error: cache_map_vm_struct is NULL, no vmalloc area\n");
-		ret = -1;
-		goto out;
-	}
-
 	M4UDBG("__m4u_sync_user: start=0x%lx, size=0x%x\n", start, (unsigned int)size);
 
-	map_start = start;
-	while (map_start < end) {
-		map_end = min((map_start & (~M4U_PAGE_MASK)) + M4U_PAGE_SIZE, end);
-		map_size = map_end - map_start;
+	if (!mm)
+		return -1;
 
-		page = m4u_cache_get_page(map_start);
-		if (!page) {
-			ret = -1;
-			goto out;
-		}
+	/* keeps the page tables we walk from being torn down under us */
+	down_read(&mm->mmap_sem);
+	while (va < end) {
+		len = min((va & (~M4U_PAGE_MASK)) + M4U_PAGE_SIZE, end) - va;
 
-		map_va = (unsigned long)m4u_cache_map_page_va(page);
-		if (!map_va) {
+		pa = m4u_user_v2p(va);
+		if (!pa || !pfn_valid(__phys_to_pfn(pa))) {
+			M4UMSG("error cache sync va=0x%lx has no page\n", va);
 			ret = -1;
-			goto out;
+			break;
 		}
 
-		map_va_align = map_va | (map_start & (M4U_PAGE_SIZE - 1));
-
-		M4UDBG("__m4u_sync_user: map_start=0x%lx, map_size=0x%x, map_va=0x%lx\n",
-		       map_start, map_size, map_va_align);
-		__m4u_cache_sync_kernel((void *)map_va_align, map_size, direction);
+		if (PageHighMem(phys_to_page(pa))) {
+			m4u_cache_sync_highmem(pa, len, direction);
+		} else if (run_size && run_pa + run_size == pa) {
+			run_size += len;
+		} else {
+			if (run_size)
+				__m4u_cache_sync_kernel(__va(run_pa), run_size, direction);
+			run_pa = pa;
+			run_size = len;
+		}
 
-		m4u_cache_unmap_page_va(map_va);
-		map_start = map_end;
+		va += len;
 	}
-
-out:
-	mutex_unlock(&gM4u_cache_sync_user_lock);
+	if (run_size)
+		__m4u_cache_sync_kernel(__va(run_pa), run_size, direction);
+	up_read(&mm->mmap_sem);
 
 	return ret;
-
 }
 
 int m4u_do_dma_cache_maint(M4U_MODULE_ID_ENUM eModuleID, const void *va, size_t size, int direction)
 {
-
-	unsigned int page_num;
+	struct m4u_cache_stat *stat;
+	bool all = false;
+	u64 t0, ns;
 	int ret = 0;
 
 	if ((((unsigned long)va % L1_CACHE_BYTES != 0) || (size % L1_CACHE_BYTES) != 0)) {
@@ -1759,19 +1777,74 @@ int m4u_do_dma_cache_maint(M4U_MODULE_ID_ENUM eModuleID, const void *va, size_t
 		     L1_CACHE_BYTES);
 	}
 
-	page_num = M4U_GET_PAGE_NUM(va, size);
+	t0 = sched_clock();
 
-	if ((unsigned long)va < PAGE_OFFSET) /* from user space */
+	if (size >= m4u_cache_sync_all_thresh && !in_interrupt()) {
+		/* clean + invalidate all is valid for every direction */
+		m4u_dma_cache_flush_all();
+		all = true;
+	} else if ((unsigned long)va < PAGE_OFFSET) { /* from user space */
 		ret = __m4u_cache_sync_user((unsigned long)va, size, direction);
-	else
+	} else {
 		ret = __m4u_cache_sync_kernel(va, size, direction);
+	}
+
+	ns = sched_clock() - t0;
+	if ((int)eModuleID >= 0 && eModuleID < M4U_PORT_NR) {
+		stat = &get_cpu_var(m4u_cache_stat)[eModuleID];
+		stat->count++;
+		stat->bytes += size;
+		stat->ns += ns;
+		stat->max_ns = max(stat->max_ns, ns);
+		stat->all += all;
+		put_cpu_var(m4u_cache_stat);
+	}
 
-	M4UDBG("cache_sync: module=%s, addr=0x%lx, size=0x%zx\n",
-	       m4u_get_module_name(eModuleID),  (unsigned long)va, size);
+	M4UDBG("cache_sync: module=%s, addr=0x%lx, size=0x%zx, all=%d, %lluns\n",
+	       m4u_get_module_name(eModuleID),  (unsigned long)va, size, all, ns);
 
 	return ret;
 }
 
+static int m4u_cache_stat_show(struct seq_file *m, void *v)
+{
+	struct m4u_cache_stat sum, *stat;
+	int port, cpu;
+
+	seq_printf(m, "all_thresh %u\n", m4u_cache_sync_all_thresh);
+	seq_puts(m, "module count bytes total_ns max_ns all\n");
+	for (port = 0; port < M4U_PORT_NR; port++) {
+		memset(&sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			stat = &per_cpu(m4u_cache_stat, cpu)[port];
+			sum.count += stat->count;
+			sum.bytes += stat->bytes;
+			sum.ns += stat->ns;
+			sum.max_ns = max(sum.max_ns, stat->max_ns);
+			sum.all += stat->all;
+		}
+		if (!sum.count)
+			continue;
+		seq_printf(m, "%s %llu %llu %llu %llu %llu\n", m4u_get_module_name(port),
+			   sum.count, sum.bytes, sum.ns, sum.max_ns, sum.all);
+	}
+
+	return 0;
+}
+
+static int m4u_cache_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, m4u_cache_stat_show, NULL);
+}
+
+static const struct file_operations m4u_cache_stat_fops = {
+	.owner = THIS_MODULE,
+	.open = m4u_cache_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int m4u_dma_cache_maint(M4U_MODULE_ID_ENUM eModuleID,
 		const void *start, size_t size, int direction)
 {
@@ -2932,6 +3005,7 @@ static int pseudo_probe(struct platform_device *pdev)
 		return -ENODEV;
 	}
 
+	proc_create("m4u_cache_stat", S_IRUGO, NULL, &m4u_cache_stat_fops);
 	m4u_cache_sync_init();
 
 	return 0;
@@ -13,7 +13,6 @@
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/module.h>
-#include <linux/hrtimer.h>
 #include <linux/cpu.h>
 #include <linux/kobject.h>
 #include <linux/sysfs.h>
@@ -22,9 +21,7 @@
 #include <linux/workqueue.h>
 #include <linux/sched.h>
 #include <linux/spinlock.h>
-#include <linux/cpufreq.h>
-#include <linux/kernel_stat.h>
-#include <linux/tick.h>
+#include <linux/irq_work.h>
 #include <linux/suspend.h>
 #include <linux/version.h>
 #include <asm/smp_plat.h>
@@ -42,10 +39,6 @@ struct rq_data rq_info;
 spinlock_t rq_lock;
 #endif
 
-static int cpufreq_variant = 1; /* set to 1 if per cpu load is cpu freq. variant */
-#ifdef CONFIG_CPU_FREQ
-struct notifier_block freq_transition;
-#endif /* CONFIG_CPU_FREQ */
 struct notifier_block cpu_hotplug;
 static unsigned int heavy_task_threshold = 920; /* max=1023, for last_poll, threshold */
 static unsigned int heavy_task_threshold2 = 920; /* max=1023 for AHT, threshold  */
@@ -55,27 +48,15 @@ static int htask_cpucap_ctrl = 1;
 /* max = 100, threshold for capacity overutiled */
 static int overutil_threshold = 35;
 
-struct cpu_load_data {
-	cputime64_t prev_cpu_idle;
-	cputime64_t prev_cpu_wall;
-	cputime64_t prev_cpu_iowait;
-	unsigned int avg_load_maxfreq_rel;
-	unsigned int avg_load_maxfreq_abs;
-	unsigned int samples;
-	unsigned int window_size;
-	unsigned int cur_freq;
-	unsigned int policy_max;
-	cpumask_var_t related_cpus;
-	spinlock_t cpu_load_lock;
-};
-
-static DEFINE_PER_CPU(struct cpu_load_data, cpuload);
-static DEFINE_PER_CPU(struct cpufreq_policy, cpupolicy);
+/*
+ * Heavy tasks queued on each CPU against heavy_task_threshold. Only the
+ * owning rq updates it, under its rq->lock; readers sample it locklessly.
+ */
+static DEFINE_PER_CPU(int, nr_heavy_poll);
 
-typedef enum {
-	AVG_LOAD_IGNORE,
-	AVG_LOAD_UPDATE
-} AVG_LOAD_ID;
+static ATOMIC_NOTIFIER_HEAD(heavy_task_notifier_list);
+static struct irq_work heavy_task_irq_work;
+static bool heavy_task_notify_ready;
 
 int get_overutil_threshold(void)
 {
@@ -87,183 +68,18 @@ static unsigned int heavy_task_prio = NICE_TO_PRIO(CONFIG_SCHED_HMP_PRIO_FILTER_
 #define task_low_priority(prio) ((prio >= heavy_task_prio)?1:0)
 #endif
 
-#ifdef CONFIG_CPU_FREQ
-#include <linux/cpufreq.h>
-#else  /* !CONFIG_CPU_FREQ  */
-static inline u64 get_cpu_idle_time_jiffy(unsigned int cpu, u64 *wall)
-{
-	u64 idle_time;
-	u64 cur_wall_time;
-	u64 busy_time;
-
-	cur_wall_time = jiffies64_to_cputime64(get_jiffies_64());
-
-	busy_time = kcpustat_cpu(cpu).cpustat[CPUTIME_USER];
-	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_SYSTEM];
-	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_IRQ];
-	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_SOFTIRQ];
-	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_STEAL];
-	busy_time += kcpustat_cpu(cpu).cpustat[CPUTIME_NICE];
-
-	idle_time = cur_wall_time - busy_time;
-	if (wall)
-		*wall = cputime_to_usecs(cur_wall_time);
-
-	return cputime_to_usecs(idle_time);
-}
-
-static inline cputime64_t get_cpu_idle_time_internal(unsigned int cpu, cputime64_t *wall)
-{
-	u64 idle_time = get_cpu_idle_time_us(cpu, NULL);
-
-	if (idle_time == -1ULL)
-		idle_time = get_cpu_idle_time_jiffy(cpu, wall);
-	else
-		idle_time += get_cpu_iowait_time_us(cpu, wall);
-
-	return idle_time;
-}
-#endif /* CONFIG_CPU_FREQ */
-
-static inline cputime64_t get_cpu_iowait_time(unsigned int cpu,
-							cputime64_t *wall)
-{
-	u64 iowait_time = get_cpu_iowait_time_us(cpu, wall);
-
-	if (iowait_time == -1ULL)
-		return 0;
-
-	return iowait_time;
-}
-
-static int update_average_load(AVG_LOAD_ID id, unsigned int freq, unsigned int cpu)
-{
-
-	struct cpu_load_data *pcpu = &per_cpu(cpuload, cpu);
-	cputime64_t cur_wall_time, cur_idle_time, cur_iowait_time;
-	unsigned int idle_time, wall_time, iowait_time;
-	unsigned int cur_load, prev_avg_load_rel, prev_avg_load_abs;
-	unsigned int load_at_max_freq_rel, load_at_max_freq_abs;
-	cputime64_t prev_wall_time, prev_cpu_idle, prev_cpu_iowait;
-
-#ifdef CONFIG_CPU_FREQ
-	cur_idle_time = get_cpu_idle_time(cpu, &cur_wall_time, 0);
-#else  /* !CONFIG_CPU_FREQ  */
-	cur_idle_time = get_cpu_idle_time_internal(cpu, &cur_wall_time);
-#endif /* CONFIG_CPU_FREQ */
-	cur_iowait_time = get_cpu_iowait_time(cpu, &cur_wall_time);
-
-	prev_wall_time = pcpu->prev_cpu_wall;
-	prev_cpu_idle = pcpu->prev_cpu_idle;
-	prev_cpu_iowait = pcpu->prev_cpu_iowait;
-
-	wall_time = (unsigned int) (cur_wall_time - pcpu->prev_cpu_wall);
-	pcpu->prev_cpu_wall = cur_wall_time;
-
-	idle_time = (unsigned int) (cur_idle_time - pcpu->prev_cpu_idle);
-	pcpu->prev_cpu_idle = cur_idle_time;
-
-	iowait_time = (unsigned int) (cur_iowait_time - pcpu->prev_cpu_iowait);
-	pcpu->prev_cpu_iowait = cur_iowait_time;
-
-	if (idle_time >= iowait_time)
-		idle_time -= iowait_time;
-
-	if (unlikely(!wall_time || wall_time < idle_time))
-		return 0;
-
-	if (id == AVG_LOAD_IGNORE)
-		cur_load = 0;
-	else
-		cur_load = 100 * (wall_time - idle_time) / wall_time;
-
-	/* Calculate the scaled load across CPU */
-	if (cpu_online(cpu)) {
-		load_at_max_freq_abs = (cur_load * freq) / pcpu->policy_max;
-		load_at_max_freq_rel = cur_load;
-	} else {
-		load_at_max_freq_abs = 0;
-		load_at_max_freq_rel = 0;
-	}
-
-	prev_avg_load_rel = pcpu->avg_load_maxfreq_rel;
-	prev_avg_load_abs = pcpu->avg_load_maxfreq_abs;
-
-#if 1
-	if (!pcpu->avg_load_maxfreq_rel || !pcpu->avg_load_maxfreq_abs) {
-		/* This is the first sample in this window*/
-		pcpu->avg_load_maxfreq_rel = load_at_max_freq_rel;
-		pcpu->avg_load_maxfreq_abs = load_at_max_freq_abs;
-		pcpu->window_size = wall_time;
-	} else {
-		/*
-		 * The is already a sample available in this window.
-		 * Compute weighted average with prev entry, so that we get
-		 * the precise weighted load.
-		 */
-		pcpu->avg_load_maxfreq_rel =
-		    ((pcpu->avg_load_maxfreq_rel * pcpu->window_size) +
-			(load_at_max_freq_rel * wall_time)) /
-			(wall_time + pcpu->window_size);
-		pcpu->avg_load_maxfreq_abs =
-		    ((pcpu->avg_load_maxfreq_abs * pcpu->window_size) +
-			(load_at_max_freq_abs * wall_time)) /
-			(wall_time + pcpu->window_size);
-
-		pcpu->window_size += wall_time;
-	}
-#else /* debug only */
-	pcpu->avg_load_maxfreq_rel = load_at_max_freq_rel;
-	pcpu->avg_load_maxfreq_abs = load_at_max_freq_abs;
-	pcpu->window_size = wall_time;
-#endif
-
-	mt_sched_printf(sched_log, "[%s] cpu(%u) load: abs(%u/%u) rel(%u/%u) prev_load: abs(%u) rel(%u)",
-					__func__, cpu, pcpu->avg_load_maxfreq_abs, load_at_max_freq_abs,
-					pcpu->avg_load_maxfreq_rel, load_at_max_freq_rel,
-					prev_avg_load_abs, prev_avg_load_rel);
-	mt_sched_printf(sched_log, "[%s]  wdz:%u wall:%u(%llu/%llu) idle: %u(%llu/%llu) iowait: %u(%llu/%llu)",
-					__func__,
-					pcpu->window_size, wall_time, cur_wall_time, prev_wall_time,
-					idle_time, cur_idle_time, prev_cpu_idle,
-					iowait_time, cur_iowait_time, prev_cpu_iowait);
-
-	return 0;
-}
-
-#if 0
-static void report_load_at_max_freq(bool reset, unsigned int *rel_load, unsigned int *abs_load)
-{
-	int cpu;
-	struct cpu_load_data *pcpu;
-	unsigned long flags;
-
-	*rel_load = 0;
-	*abs_load = 0;
-	for_each_online_cpu(cpu) {
-		pcpu = &per_cpu(cpuload, cpu);
-		spin_lock_irqsave(&pcpu->cpu_load_lock, flags);
-		update_average_load(pcpu->cur_freq, cpu);
-		*rel_load += pcpu->avg_load_maxfreq_rel;
-		*abs_load += pcpu->avg_load_maxfreq_abs;
-		if (reset) {
-			pcpu->avg_load_maxfreq_rel = 0;
-			pcpu->avg_load_maxfreq_abs = 0;
-		}
-		spin_unlock_irqrestore(&pcpu->cpu_load_lock, flags);
-	}
-}
-#endif
-
+/*
+ * sched_get_percpu_load2 - load of @cpu in percent from the CFS utilization
+ * @rel_load: busy ratio at the current OPP
+ * @abs_load: the same work normalized to the highest OPP
+ *
+ * PELT already decays the signal, so there is no sampling window left to
+ * @reset; the argument is kept for the existing callers.
+ */
 void sched_get_percpu_load2(int cpu, bool reset, unsigned int *rel_load, unsigned int *abs_load)
 {
-	struct cpu_load_data *pcpu;
-	unsigned long flags;
+	unsigned long util, cap_curr;
 
-#if 0
-	if (!cpu_online(cpu))
-		return 0;
-#endif
 	if (!rel_load || !abs_load)
 		return;
 
@@ -275,22 +91,24 @@ void sched_get_percpu_load2(int cpu, bool reset, unsigned int *rel_load, unsigne
 		return;
 	}
 
-	pcpu = &per_cpu(cpuload, cpu);
-	spin_lock_irqsave(&pcpu->cpu_load_lock, flags);
-	update_average_load(AVG_LOAD_UPDATE, pcpu->cur_freq, cpu);
-	*rel_load = pcpu->avg_load_maxfreq_rel;
-	*abs_load = pcpu->avg_load_maxfreq_abs;
-	if (reset) {
-		pcpu->avg_load_maxfreq_rel = 0;
-		pcpu->avg_load_maxfreq_abs = 0;
-	}
-	spin_unlock_irqrestore(&pcpu->cpu_load_lock, flags);
+	if (!cpu_online(cpu))
+		return;
+
+	util = cpu_util(cpu);
+	cap_curr = capacity_curr_of(cpu);
+
+	*abs_load = util * 100 / capacity_orig_of(cpu);
+	*rel_load = cap_curr ? min(util * 100 / cap_curr, 100UL) : *abs_load;
+
+	mt_sched_printf(sched_log, "[%s] cpu(%d) util=%lu cap=%lu/%lu load: abs(%u) rel(%u)",
+					__func__, cpu, util, cap_curr, capacity_orig_of(cpu),
+					*abs_load, *rel_load);
 }
 EXPORT_SYMBOL(sched_get_percpu_load2);
 
 unsigned int sched_get_percpu_load(int cpu, bool reset, bool use_maxfreq)
 {
-	int rel_load, abs_load;
+	unsigned int rel_load, abs_load;
 
 	sched_get_percpu_load2(cpu, reset, &rel_load, &abs_load);
 	return use_maxfreq ? abs_load : rel_load;
@@ -372,35 +190,135 @@ int is_ack_curcap(int cpu)
 }
 EXPORT_SYMBOL(is_ack_curcap);
 
-int is_heavy_task(struct task_struct *p)
+static int task_load_over(struct task_struct *p, unsigned long load_avg, unsigned int threshold)
 {
-	int is_heavy = 0;
-
-	if (!HEAVY_TASK_ENABLE)
-		return 0;
-
-	if (!p)
-		return 0;
-
 #ifdef CONFIG_SCHED_HMP_PRIO_FILTER
 	if (task_low_priority(p->prio))
 		return 0;
 #endif
 	if (unlikely(p->se.load.weight > NICE_0_LOAD)) {
 		/* don't consider weight in heavy task detection */
-		long long task_wop_load = (p->se.avg.load_avg*NICE_0_LOAD)/p->se.load.weight;
+		long long task_wop_load = (load_avg*NICE_0_LOAD)/p->se.load.weight;
 
-		if (task_wop_load >= heavy_task_threshold2)
-			is_heavy = 1;
-	} else {
-		if (p->se.avg.load_avg >= heavy_task_threshold2)
-			is_heavy = 1;
+		return task_wop_load >= threshold;
 	}
 
-	return is_heavy;
+	return load_avg >= threshold;
+}
+
+int is_heavy_task(struct task_struct *p)
+{
+	if (!HEAVY_TASK_ENABLE)
+		return 0;
+
+	if (!p)
+		return 0;
+
+	return task_load_over(p, p->se.avg.load_avg, heavy_task_threshold2);
 }
 EXPORT_SYMBOL(is_heavy_task);
 
+int register_heavy_task_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&heavy_task_notifier_list, nb);
+}
+EXPORT_SYMBOL(register_heavy_task_notifier);
+
+int unregister_heavy_task_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&heavy_task_notifier_list, nb);
+}
+EXPORT_SYMBOL(unregister_heavy_task_notifier);
+
+static unsigned int heavy_poll_count(int cluster_id, int clusters)
+{
+	struct cpumask cls_cpus;
+	unsigned int count = 0;
+	int cpu, nr;
+
+	arch_get_cluster_cpus(&cls_cpus, cluster_id);
+	for_each_cpu(cpu, &cls_cpus) {
+		if (!cpu_online(cpu))
+			continue;
+		nr = READ_ONCE(per_cpu(nr_heavy_poll, cpu));
+		if (nr > 0 && ack_by_curcap(cpu, cluster_id, clusters-1))
+			count += nr;
+	}
+
+	return count;
+}
+
+/* runs outside of any rq->lock, so consumers may wake their threads */
+static void heavy_task_irq_work_fn(struct irq_work *work)
+{
+	int clusters = arch_get_nr_clusters();
+	unsigned int total = 0;
+	int id;
+
+	for (id = 0; id < clusters; id++)
+		total += heavy_poll_count(id, clusters);
+
+	atomic_notifier_call_chain(&heavy_task_notifier_list, total, NULL);
+}
+
+static void heavy_poll_add(int cpu, int delta)
+{
+	int *nr = &per_cpu(nr_heavy_poll, cpu);
+
+	if (!delta)
+		return;
+
+	WRITE_ONCE(*nr, *nr + delta);
+	if (likely(heavy_task_notify_ready))
+		irq_work_queue(&heavy_task_irq_work);
+}
+
+/*
+ * sched_heavy_task_enqueue - @p enters (@inc = 1) or leaves (@inc = -1) the
+ * CFS runqueue of its CPU. Called with that rq->lock held.
+ */
+void sched_heavy_task_enqueue(struct task_struct *p, int inc)
+{
+	if (!HEAVY_TASK_ENABLE)
+		return;
+
+	if (task_load_over(p, p->se.avg.load_avg, heavy_task_threshold))
+		heavy_poll_add(cpu_of(task_rq(p)), inc);
+}
+
+/*
+ * sched_heavy_task_update - PELT moved the load of the queued task @p from
+ * @prev_load to its current value. Called with the task's rq->lock held.
+ */
+void sched_heavy_task_update(struct task_struct *p, unsigned long prev_load)
+{
+	int was, now;
+
+	if (!HEAVY_TASK_ENABLE)
+		return;
+
+	was = task_load_over(p, prev_load, heavy_task_threshold);
+	now = task_load_over(p, p->se.avg.load_avg, heavy_task_threshold);
+	heavy_poll_add(cpu_of(task_rq(p)), now - was);
+}
+
+/* heavy_task_threshold changed, rebuild the per-CPU counts */
+static void heavy_poll_recount(void)
+{
+	struct task_struct *p;
+	unsigned long flags;
+	int cpu, nr;
+
+	for_each_possible_cpu(cpu) {
+		nr = 0;
+		raw_spin_lock_irqsave(&cpu_rq(cpu)->lock, flags);
+		list_for_each_entry(p, &cpu_rq(cpu)->cfs_tasks, se.group_node)
+			nr += task_load_over(p, p->se.avg.load_avg, heavy_task_threshold);
+		WRITE_ONCE(per_cpu(nr_heavy_poll, cpu), nr);
+		raw_spin_unlock_irqrestore(&cpu_rq(cpu)->lock, flags);
+	}
+}
+
 int inc_nr_heavy_running(const char *invoker, struct task_struct *p, int inc, bool ack_cap)
 {
 #ifdef CONFIG_MTK_SCHED_RQAVG_KS
@@ -418,7 +336,7 @@ unsigned int sched_get_nr_heavy_task_by_threshold(int cluster_id, unsigned int t
 	struct task_struct *p;
 	unsigned long flags;
 	unsigned int count = 0;
-	int is_heavy = 0;
+	int is_heavy;
 	int clusters;
 	struct cpumask cls_cpus;
 
@@ -430,28 +348,19 @@ unsigned int sched_get_nr_heavy_task_by_threshold(int cluster_id, unsigned int t
 		return 0;
 	}
 
+	/* the default threshold is tracked from enqueue/dequeue and PELT */
+	if (threshold == heavy_task_threshold) {
+		count = heavy_poll_count(cluster_id, clusters);
+		goto out;
+	}
+
 	arch_get_cluster_cpus(&cls_cpus, cluster_id);
 	for_each_cpu(cpu, &cls_cpus) {
 		if (likely(!cpu_online(cpu)))
 			continue;
 		raw_spin_lock_irqsave(&cpu_rq(cpu)->lock, flags);
 		list_for_each_entry(p, &cpu_rq(cpu)->cfs_tasks, se.group_node) {
-			is_heavy = 0;
-#ifdef CONFIG_SCHED_HMP_PRIO_FILTER
-			if (task_low_priority(p->prio))
-				continue;
-#endif
-			if (unlikely(p->se.load.weight > NICE_0_LOAD)) {
-				/* don't consider weight in heavy task detection */
-				long long task_wop_load = (p->se.avg.load_avg*NICE_0_LOAD)/p->se.load.weight;
-
-				if (task_wop_load >= threshold)
-					is_heavy = 1;
-			} else {
-				if (p->se.avg.load_avg >= threshold)
-					is_heavy = 1;
-			}
-
+			is_heavy = task_load_over(p, p->se.avg.load_avg, threshold);
 			if (is_heavy) {
 				is_heavy = ack_by_curcap(cpu, cluster_id, clusters-1);
 				count += is_heavy ? 1 : 0;
@@ -461,6 +370,7 @@ unsigned int sched_get_nr_heavy_task_by_threshold(int cluster_id, unsigned int t
 		raw_spin_unlock_irqrestore(&cpu_rq(cpu)->lock, flags);
 	}
 
+out:
 	__heat_refined(&count);
 	if (count)
 		htask_statistic++;
@@ -506,123 +416,27 @@ EXPORT_SYMBOL(sched_get_nr_heavy_task2);
 void sched_set_heavy_task_threshold(unsigned int val)
 {
 	heavy_task_threshold = val;
+	heavy_poll_recount();
 }
 EXPORT_SYMBOL(sched_set_heavy_task_threshold);
 
-#if 0
-static int cpufreq_policy_handler(struct notifier_block *nb,
-			unsigned long event, void *data)
-{
-	int cpu = 0;
-	struct cpufreq_policy *policy = data;
-	struct cpu_load_data *this_cpu;
-
-	if (event == CPUFREQ_START)
-		return 0;
-
-	if (event != CPUFREQ_INCOMPATIBLE)
-		return 0;
-
-	/* Make sure that all CPUs impacted by this policy are
-	 * updated since we will only get a notification when the
-	 * user explicitly changes the policy on a CPU.
-	 */
-	for_each_cpu(cpu, policy->cpus) {
-		struct cpu_load_data *pcpu = &per_cpu(cpuload, j);
-
-		spin_lock_irqsave(&pcpu->cpu_load_lock, flags);
-		pcpu->policy_max = policy->cpuinfo.max_freq;
-		spin_unlock_irqrestore(&pcpu->cpu_load_lock, flags);
-	}
-
-	return 0;
-}
-#endif
-
-#ifdef CONFIG_CPU_FREQ
-static int cpufreq_transition_handler(struct notifier_block *nb,
-			unsigned long val, void *data)
-{
-	struct cpufreq_freqs *freqs = data;
-	struct cpu_load_data *this_cpu = &per_cpu(cpuload, freqs->cpu);
-	int j;
-	unsigned long flags;
-
-	if (rq_info.init != 1)
-		return 0;
-
-	switch (val) {
-	case CPUFREQ_POSTCHANGE:
-		for_each_cpu(j, this_cpu->related_cpus) {
-			struct cpu_load_data *pcpu = &per_cpu(cpuload, j);
-			/* flush previous laod */
-			if (pcpu->policy_max == 1) {
-				struct cpufreq_policy cpu_policy;
-
-				if (!cpufreq_get_policy(&cpu_policy, j)) {
-					spin_lock_irqsave(&pcpu->cpu_load_lock, flags);
-					pcpu->policy_max = cpu_policy.cpuinfo.max_freq;
-					spin_unlock_irqrestore(&pcpu->cpu_load_lock, flags);
-				}
-			}
-
-			spin_lock_irqsave(&pcpu->cpu_load_lock, flags);
-				if (cpu_online(j))
-					update_average_load(AVG_LOAD_UPDATE, freqs->old, freqs->cpu);
-			pcpu->cur_freq = cpufreq_variant ? freqs->new : pcpu->policy_max;
-			spin_unlock_irqrestore(&pcpu->cpu_load_lock, flags);
-		}
-		break;
-	}
-	return 0;
-}
-#endif /* CONFIG_CPU_FREQ */
-
 static int cpu_hotplug_handler(struct notifier_block *nb,
 			unsigned long val, void *data)
 {
 	unsigned int cpu = (unsigned long)data;
-	struct cpu_load_data *this_cpu = &per_cpu(cpuload, cpu);
-	unsigned long flags;
-	unsigned int i;
 
 	if (rq_info.init != 1)
 		return NOTIFY_OK;
 
 	switch (val) {
-	case CPU_ONLINE:
-		if (!this_cpu->cur_freq)
-			this_cpu->cur_freq = cpufreq_quick_get(cpu);
-		for_each_cpu(i, cpu_online_mask) {
-			struct cpu_load_data *cld = &per_cpu(cpuload, i);
-			struct cpufreq_policy *cpu_policy  = &per_cpu(cpupolicy, i);
-
-			cpufreq_get_policy(cpu_policy, i);
-			cpumask_copy(cld->related_cpus, cpu_policy->cpus);
-		}
-		/* cpu_online()=0 here, count cpu offline period as idle */
-		spin_lock_irqsave(&this_cpu->cpu_load_lock, flags);
-		update_average_load(AVG_LOAD_IGNORE, 0, cpu);
-		spin_unlock_irqrestore(&this_cpu->cpu_load_lock, flags);
-		break;
-	case CPU_ONLINE_FROZEN:
 	case CPU_UP_PREPARE:
-		/* cpu_online()=0 here, count cpu offline period as idle */
-		spin_lock_irqsave(&this_cpu->cpu_load_lock, flags);
-		update_average_load(AVG_LOAD_IGNORE, 0, cpu);
-		spin_unlock_irqrestore(&this_cpu->cpu_load_lock, flags);
+		/* nothing is queued on a CPU coming up */
+		WRITE_ONCE(per_cpu(nr_heavy_poll, cpu), 0);
 #ifdef CONFIG_MTK_SCHED_RQAVG_KS
 		/* clear per_cpu variables for heavy task if needed */
-		if (val == CPU_UP_PREPARE)
-			WARN_ON(reset_heavy_task_stats(cpu));
+		WARN_ON(reset_heavy_task_stats(cpu));
 #endif
 		break;
-	case CPU_DOWN_PREPARE:
-		/* cpu_online()=1 here, flush previous load */
-		spin_lock_irqsave(&this_cpu->cpu_load_lock, flags);
-		update_average_load(AVG_LOAD_UPDATE, this_cpu->cur_freq, cpu);
-		spin_unlock_irqrestore(&this_cpu->cpu_load_lock, flags);
-		break;
 	}
 	return NOTIFY_OK;
 }
@@ -770,28 +584,6 @@ static ssize_t cpu_normalized_load_show(struct kobject *kobj,
 	for_each_possible_cpu(cpu) {
 		sched_get_percpu_load2(cpu, 0, &load_rel, &load_abs);
 		len += snprintf(buf+len, max_len-len, "cpu(%d): load(rel/abs) = %u/%u\n", cpu, load_rel, load_abs);
-#if 0
-		unsigned int idle_time, wall_time, iowait_time;
-		struct cpu_load_data *pcpu = &per_cpu(cpuload, cpu);
-
-		idle_time = get_cpu_idle_time(cpu, &wall_time, 0);
-		iowait_time = get_cpu_iowait_time(cpu, &wall_time);
-		len += snprintf(buf+len, max_len-len, "curr idle=%u, io=%u, wall=%u\n",
-			(unsigned int)idle_time,
-			(unsigned int)iowait_time,
-			(unsigned int)wall_time);
-		len += snprintf(buf+len, max_len-len,
-						"prev idle=%u, io=%u, wall=%u, l(rel/abs)=%u/%u, w=%u, f=%u m=%u, %s\n",
-			(unsigned int)pcpu->prev_cpu_idle,
-			(unsigned int)pcpu->prev_cpu_iowait,
-			(unsigned int)pcpu->prev_cpu_wall,
-			pcpu->avg_load_maxfreq_rel,
-			pcpu->avg_load_maxfreq_abs,
-			pcpu->window_size,
-			pcpu->cur_freq,
-			pcpu->policy_max,
-			(unsigned int)(cpu_online(cpu))?"on":"off");
-#endif
 	}
 	len += snprintf(buf+len, max_len-len, "htask_threshold=%d, total_htask#=%d\n",
 		heavy_task_threshold, htask_statistic);
@@ -1008,21 +800,9 @@ static int init_rq_attribs(void)
 static int __init rq_stats_init(void)
 {
 	int ret = 0;
-	int i;
-#ifdef CONFIG_CPU_FREQ
-	struct cpufreq_policy *cpu_policy;
 
-	cpu_policy = kmalloc(sizeof(struct cpufreq_policy), GFP_KERNEL);
-	if (!cpu_policy) {
-		rq_info.init = 0;
-		return -ENODATA;
-	}
-#endif
 	/* Bail out if this is not an SMP Target */
 #ifndef CONFIG_SMP
-#ifdef CONFIG_CPU_FREQ
-	kfree(cpu_policy);
-#endif
 	rq_info.init = 0;
 	return -ENODATA;
 #endif
@@ -1044,33 +824,10 @@ static int __init rq_stats_init(void)
 	rq_info.hotplug_disabled = 0;
 	ret = init_rq_attribs();
 
-	for_each_possible_cpu(i) {
-		struct cpu_load_data *pcpu = &per_cpu(cpuload, i);
-
-		spin_lock_init(&pcpu->cpu_load_lock);
-		pcpu->cur_freq = pcpu->policy_max = 1;
-#ifdef CONFIG_CPU_FREQ
-		if (!cpufreq_get_policy(cpu_policy, i)) {
-			pcpu->policy_max = cpu_policy->cpuinfo.max_freq;
-			if (cpu_online(i))
-				pcpu->cur_freq = cpufreq_quick_get(i);
-			cpumask_copy(pcpu->related_cpus, cpu_policy->cpus);
-		}
-#endif /* CONFIG_CPU_FREQ */
-		if (!cpufreq_variant)
-			pcpu->cur_freq = pcpu->policy_max;
-	}
-#ifdef CONFIG_CPU_FREQ
-	freq_transition.notifier_call = cpufreq_transition_handler;
-	cpufreq_register_notifier(&freq_transition, CPUFREQ_TRANSITION_NOTIFIER);
-#endif /* CONFIG_CPU_FREQ */
 	cpu_hotplug.notifier_call = cpu_hotplug_handler;
 	register_hotcpu_notifier(&cpu_hotplug);
 
 	rq_info.init = 1;
-#ifdef CONFIG_CPU_FREQ
-	kfree(cpu_policy);
-#endif
 
 	return ret;
 }
@@ -1085,6 +842,9 @@ static int __init rq_stats_early_init(void)
 		return -ENODATA;
 #endif
 
+	init_irq_work(&heavy_task_irq_work, heavy_task_irq_work_fn);
+	heavy_task_notify_ready = true;
+
 	pm_notifier(system_suspend_handler, 0);
 	return 0;
 }
@@ -39,6 +39,9 @@ extern int reset_heavy_task_stats(int cpu);
 extern int is_ack_curcap(int cpu);
 extern int is_heavy_task(struct task_struct *p);
 extern void heavy_thresh_chg_notify(void); /* need to invoke if any threshold of htasks changed */
+/* called from irq_work with the number of heavy tasks whenever it changes */
+extern int register_heavy_task_notifier(struct notifier_block *nb);
+extern int unregister_heavy_task_notifier(struct notifier_block *nb);
 /* For over-utilized task tracking */
 extern void overutil_thresh_chg_notify(void);
 extern int get_overutil_stats(char *buf, int buf_size);
@@ -109,6 +109,7 @@ static int gb_task_util;
 static int gb_task_pid;
 static int gb_task_cpu;
 static int gb_boosted_util;
+static unsigned long gb_tracking_jiffies;
 
 void sched_max_util_task_tracking(void)
 {
@@ -145,8 +146,19 @@ void sched_max_util_task_tracking(void)
 #endif
 }
 
+/*
+ * The max-util window is folded on demand instead of from a 32ms timer;
+ * callers querying more often than that read the last folded result.
+ */
 void sched_max_util_task(int *cpu, int *pid, int *util, int *boost)
 {
+#ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
+	unsigned long last = READ_ONCE(gb_tracking_jiffies);
+
+	if (init_heavy && time_after_eq(jiffies, last + HZ/32) &&
+	    cmpxchg(&gb_tracking_jiffies, last, jiffies) == last)
+		sched_max_util_task_tracking();
+#endif
 	if (cpu)
 		*cpu = gb_task_cpu;
 	if (pid)
@@ -796,16 +808,6 @@ OUT:
 }
 EXPORT_SYMBOL(sched_update_nr_heavy_prod);
 
-#ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
-static struct timer_list tracker_timer;
-
-static void tracker_isr(unsigned long data)
-{
-	sched_max_util_task_tracking();
-	mod_timer(&tracker_timer, jiffies + HZ/32); /* 32ms */
-}
-#endif
-
 static int init_heavy_tlb(void)
 {
 	if (!init_heavy) {
@@ -884,10 +886,7 @@ static int init_heavy_tlb(void)
 		}
 
 #ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
-		init_timer_deferrable(&tracker_timer);
-		tracker_timer.function = tracker_isr;
-		tracker_timer.expires = jiffies + HZ/32; /*32ms*/
-		add_timer(&tracker_timer);
+		gb_tracking_jiffies = jiffies;
 #endif
 
 		init_heavy = 1;
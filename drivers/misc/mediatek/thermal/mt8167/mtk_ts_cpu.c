@@ -87,6 +87,8 @@ void mt_thermal_unlock(unsigned long *x)
 #include <linux/sched.h>
 #include <linux/kthread.h>
 #endif
+#define CREATE_TRACE_POINTS
+#include <trace/events/mtk_thermal_atm.h>
 
 /*
  * CONFIG (SW related)
@@ -116,6 +118,13 @@ void mt_thermal_unlock(unsigned long *x)
 /* 1: turn on fast polling in this sw module; 0: turn off */
 #define MTKTSCPU_FAST_POLLING               (1)
 
+/*
+ * 1: update the thermal zone on TC high/low offset interrupts, keep SW
+ * polling as a slow safety net below the trip points; 0: turn off
+ * (needs THERMAL_CONTROLLER_HW_TP for the raw conversion)
+ */
+#define THERMAL_CONTROLLER_HW_OFFSET_INT    (1)
+
 #if CPT_ADAPTIVE_AP_COOLER
 #define MAX_CPT_ADAPTIVE_COOLERS            (3)
 
@@ -158,6 +167,27 @@ static int cur_fp_factor = 1;
 static int next_fp_factor = 1;
 #endif
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+/* offset enable bits in TEMPMONINT share the layout of TEMPMONINTSTS */
+#define THERMAL_MON_OFFSET_INT_MASK \
+	(THERMAL_MON_LOINTSTS0 | THERMAL_MON_HOINTSTS0 | \
+	 THERMAL_MON_LOINTSTS1 | THERMAL_MON_HOINTSTS1 | \
+	 THERMAL_MON_LOINTSTS2 | THERMAL_MON_HOINTSTS2)
+#define THERMAL_MON_HOFFSET_INT_MASK \
+	(THERMAL_MON_HOINTSTS0 | THERMAL_MON_HOINTSTS1 | THERMAL_MON_HOINTSTS2)
+
+/* half width of the temperature window around the last reading */
+static int tc_offset_window = 3000;
+/* polling delay is interval * factor while no trip point is exceeded */
+static int tc_safety_polling_factor = 10;
+static int tc_offset_int_enable = 1;
+static unsigned int tc_offset_int_count;
+static int tc_offset_high, tc_offset_low;
+static struct work_struct tc_offset_int_work;
+/* the 50ms tempinfo hrtimer is stopped while the interrupts track the temp */
+static bool tc_tempinfo_timer_paused;
+#endif
+
 static int g_max_temp = 50000;	/* default=50 deg */
 
 static unsigned int interval = 1000;	/* mseconds, 0 : no auto polling */
@@ -229,6 +259,7 @@ static U32 calefuse3;
 /*0: default:  ATM v1 */
 /*1:	 FTL ATM v2 */
 /*2:	 CPU_GPU_Weight ATM v2 */
+/*3:	 PID power allocator ATM v3 */
 static int mtktscpu_atm = 1;
 static int tt_ratio_high_rise = 1;
 static int tt_ratio_high_fall = 1;
@@ -357,6 +388,7 @@ static struct hrtimer ts_tempinfo_hrtimer;
 
 static void tscpu_reset_thermal(void);
 static S32 temperature_to_raw_room(U32 ret);
+static void read_all_temperature(void);
 static void set_tc_trigger_hw_protect(int temperature, int temperature2);
 static void tscpu_config_all_tc_hw_protect(int temperature, int temperature2);
 static void thermal_initial(void);
@@ -381,6 +413,12 @@ mt_cpufreq_thermal_protect(unsigned int limited_power)
 	pr_err("E_WF: %s doesn't exist\n", __func__);
 }
 
+	unsigned int __attribute__ ((weak))
+mt_cpufreq_get_cur_power(void)
+{
+	return 0;
+}
+
 	void __attribute__ ((weak))
 mt_gpufreq_thermal_protect(unsigned int limited_power)
 {
@@ -741,6 +779,15 @@ static irqreturn_t thermal_interrupt_handler(int irq, void *dev_id)
 	if (ret & THERMAL_tri_SPM_State2)
 		tscpu_dprintk("thermal_isr: Thermal state2 to trigger SPM state2\n");
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+	if (ret & THERMAL_MON_OFFSET_INT_MASK) {
+		/* one shot, re-armed when the zone update re-centers the window */
+		thermal_clrl(TEMPMONINT, THERMAL_MON_OFFSET_INT_MASK);
+		tc_offset_int_count++;
+		queue_work(system_freezable_power_efficient_wq, &tc_offset_int_work);
+	}
+#endif
+
 	mt_thermal_unlock(&flags);
 
 	return IRQ_HANDLED;
@@ -1003,6 +1050,101 @@ static void set_tc_trigger_hw_protect(int temperature, int temperature2)
 }
 
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+/**
+ * Program the TC high/low offset thresholds around @temperature. The window
+ * never straddles a trip point, so every trip crossing raises an interrupt.
+ */
+static void tscpu_set_offset_window(int temperature)
+{
+	int high = temperature + tc_offset_window;
+	int low = temperature - tc_offset_window;
+	int raw_high, raw_low;
+	unsigned int lo_int;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < num_trip; i++) {
+		if (trip_temp[i] > temperature && trip_temp[i] < high)
+			high = trip_temp[i];
+		if (trip_temp[i] <= temperature && trip_temp[i] > low)
+			low = trip_temp[i];
+	}
+
+	raw_high = temperature_to_raw_room(high);
+	raw_low = temperature_to_raw_room(low);
+
+	mt_thermal_lock(&flags);
+	/*
+	 * The window is centered on the hottest sense point and the cooler ones
+	 * are already below it, so only the hottest one may raise low offset.
+	 */
+	if (SOC_TS_MCU1_T >= SOC_TS_MCU2_T && SOC_TS_MCU1_T >= SOC_TS_MCU3_T)
+		lo_int = THERMAL_MON_LOINTSTS0;
+	else if (SOC_TS_MCU2_T >= SOC_TS_MCU3_T)
+		lo_int = THERMAL_MON_LOINTSTS1;
+	else
+		lo_int = THERMAL_MON_LOINTSTS2;
+
+	tc_offset_high = high;
+	tc_offset_low = low;
+	THERMAL_WRAP_WR32(raw_high, TEMPOFFSETH);
+	THERMAL_WRAP_WR32(raw_low, TEMPOFFSETL);
+	thermal_clrl(TEMPMONINT, THERMAL_MON_OFFSET_INT_MASK);
+	thermal_setl(TEMPMONINT, THERMAL_MON_HOFFSET_INT_MASK | lo_int);
+	mt_thermal_unlock(&flags);
+
+	tscpu_dprintk("tscpu_set_offset_window T=%d window=[%d, %d]\n", temperature, low, high);
+}
+
+static void tscpu_clear_offset_window(void)
+{
+	unsigned long flags;
+
+	mt_thermal_lock(&flags);
+	thermal_clrl(TEMPMONINT, THERMAL_MON_OFFSET_INT_MASK);
+	mt_thermal_unlock(&flags);
+}
+
+static bool tscpu_trip_exceeded(int temperature)
+{
+	int i;
+
+	for (i = 0; i < num_trip; i++)
+		if (temperature >= trip_temp[i])
+			return true;
+
+	return false;
+}
+
+/*
+ * Nothing but the offset interrupts and the safety polling needs a reading
+ * while no trip point is exceeded, unless MET samples the temperatures.
+ */
+static void tscpu_tempinfo_timer_pause(bool pause)
+{
+	if (pause && g_pThermalSampler != NULL)
+		pause = false;
+	if (pause == tc_tempinfo_timer_paused)
+		return;
+
+	tc_tempinfo_timer_paused = pause;
+	if (pause)
+		hrtimer_cancel(&ts_tempinfo_hrtimer);
+	else
+		hrtimer_start(&ts_tempinfo_hrtimer, ktime_set(0, 50000000),
+				HRTIMER_MODE_REL);
+}
+
+static void tscpu_offset_int_work(struct work_struct *work)
+{
+	/* refresh the cached readings instead of waiting for the hrtimer */
+	read_all_temperature();
+
+	if (thz_dev)
+		thermal_zone_device_update(thz_dev);
+}
+#endif
 
 int mtk_cpufreq_register(struct mtk_cpu_power_info *freqs, int num)
 {
@@ -1328,10 +1470,26 @@ int get_immediate_abb_temp_wrap(void)
 	return curr_temp;
 }
 
+/*
+ * The cached readings are only kept fresh by the hrtimer while it runs.
+ * A paused timer cannot acknowledge the end of a resume, so do it here.
+ */
+static void tscpu_refresh_tempinfo(void)
+{
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+	if (!tc_tempinfo_timer_paused || g_tc_resume == 1)
+		return;
+
+	g_tc_resume = 0;
+	read_all_temperature();
+#endif
+}
+
 int get_immediate_ts1_wrap(void)
 {
 	int curr_temp;
 
+	tscpu_refresh_tempinfo();
 	curr_temp = SOC_TS_MCU1_T;
 	tscpu_dprintk("get_immediate_ts1_wrap curr_temp=%d\n", curr_temp);
 
@@ -1342,6 +1500,7 @@ int get_immediate_ts2_wrap(void)
 {
 	int curr_temp;
 
+	tscpu_refresh_tempinfo();
 	curr_temp = SOC_TS_MCU2_T;
 	tscpu_dprintk("get_immediate_ts2_wrap curr_temp=%d\n", curr_temp);
 
@@ -1352,6 +1511,7 @@ int get_immediate_ts3_wrap(void)
 {
 	int curr_temp;
 
+	tscpu_refresh_tempinfo();
 	curr_temp = SOC_TS_MCU3_T;
 	tscpu_dprintk("get_immediate_ts3_wrap curr_temp=%d\n", curr_temp);
 
@@ -1456,7 +1616,10 @@ static int _get_temp(int *temp)
 static int tscpu_get_temp(struct thermal_zone_device *thermal, int *t)
 {
 	int curr_temp;
-	int ret = _get_temp(&curr_temp);
+	int ret;
+
+	tscpu_refresh_tempinfo();
+	ret = _get_temp(&curr_temp);
 
 	read_curr_temp = curr_temp;
 	*t = (unsigned long)curr_temp;
@@ -1482,6 +1645,24 @@ static int tscpu_get_temp(struct thermal_zone_device *thermal, int *t)
 	else
 		thermal->polling_delay = interval * polling_factor1;
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+	/*
+	 * Trip crossings are reported by the TC offset interrupt, so polling is
+	 * only needed while cooling is in progress above a trip point.
+	 */
+	if (tc_offset_int_enable && ret == 0) {
+		tscpu_set_offset_window(curr_temp);
+		if (!tscpu_trip_exceeded(curr_temp)) {
+			thermal->polling_delay = interval * tc_safety_polling_factor;
+			tscpu_tempinfo_timer_pause(true);
+		} else {
+			tscpu_tempinfo_timer_pause(false);
+		}
+	} else {
+		tscpu_tempinfo_timer_pause(false);
+	}
+#endif
+
 #if CPT_ADAPTIVE_AP_COOLER
 	g_prev_temp = g_curr_temp;
 	g_curr_temp = curr_temp;
@@ -1965,6 +2146,177 @@ static int P_adaptive(int total_power, unsigned int gpu_loading)
 	return 0;
 }
 
+/*
+ * ATM v3: closed loop power allocator. A PID controller on the Tj error
+ * against TARGET_TJ sets the total power budget, which is then divided
+ * between CPU, GPU and camera in proportion to the power each one asks for
+ * at its current operating point. Unlike the v1/v2 step rules, the output
+ * settles at the budget the package can dissipate instead of oscillating
+ * around TARGET_TJ_HIGH/LOW.
+ */
+enum {
+	ATM_ACTOR_CPU,
+	ATM_ACTOR_GPU,
+	ATM_ACTOR_CAM,
+	ATM_NR_ACTORS
+};
+
+/* 0: use FIRST_STEP_TOTAL_POWER_BUDGET of the active adaptive cooler */
+static int atm_sustainable_power;
+/* gains in mW per degree C, 0: derive k_po/k_pu from the sustainable power */
+static int atm_k_po;
+static int atm_k_pu;
+static int atm_k_i = 10;
+static int atm_k_d;
+/* only integrate while the error (TARGET_TJ - Tj, mC) is below the cutoff */
+static int atm_integral_cutoff;
+/* temperature range used to derive the default proportional gains, mC */
+#define ATM_PID_TEMP_RANGE	10000
+
+static s64 atm_err_integral;
+static int atm_prev_err;
+static int atm_last_gpu_power = -1;
+
+static void atm_pid_reset(void)
+{
+	atm_err_integral = 0;
+	atm_prev_err = 0;
+	atm_last_gpu_power = -1;
+	cl_cam_set_power_budget(-1);
+}
+
+static int atm_pid_controller(int curr_temp)
+{
+	int sustainable = atm_sustainable_power ? : FIRST_STEP_TOTAL_POWER_BUDGET;
+	int k_po = atm_k_po ? : sustainable * 1000 / ATM_PID_TEMP_RANGE;
+	int k_pu = atm_k_pu ? : 2 * sustainable * 1000 / ATM_PID_TEMP_RANGE;
+	int err = TARGET_TJ - curr_temp;
+	s64 p, i, d, power_range;
+
+	p = (s64)((err < 0) ? k_po : k_pu) * err / 1000;
+
+	/* integrate only if it cannot wind up beyond the sustainable power */
+	if (err < atm_integral_cutoff) {
+		s64 i_next = atm_err_integral + err;
+
+		if (abs64((s64)atm_k_i * i_next / 1000) < sustainable)
+			atm_err_integral = i_next;
+	}
+	i = (s64)atm_k_i * atm_err_integral / 1000;
+
+	d = (s64)atm_k_d * (err - atm_prev_err) / 1000;
+	atm_prev_err = err;
+
+	power_range = sustainable + p + i + d;
+	power_range = clamp_t(s64, power_range, MINIMUM_TOTAL_POWER,
+			MAXIMUM_TOTAL_POWER + cl_cam_get_request_power());
+
+	trace_thermal_atm_pid(curr_temp, TARGET_TJ, err, (s32)atm_err_integral,
+			p, i, d, (s32)power_range);
+
+	return (int)power_range;
+}
+
+static int atm_gpu_request_power(unsigned int gpu_loading)
+{
+	unsigned int cur_gpu_freq = mt_gpufreq_get_cur_freq();
+	int i;
+
+	for (i = 0; i < Num_of_GPU_OPP; i++) {
+		if (mtk_gpu_power[i].gpufreq_khz == cur_gpu_freq)
+			return mtk_gpu_power[i].gpufreq_power * MIN(gpu_loading, 100) / 100;
+	}
+
+	return MAXIMUM_GPU_POWER * MIN(gpu_loading, 100) / 100;
+}
+
+/* GPU power at the current OPP and loading, 0 if the loading is unknown */
+unsigned int mtk_thermal_get_gpu_power(void)
+{
+	unsigned int gpu_loading;
+
+	if (!mtk_get_gpu_loading(&gpu_loading))
+		return 0;
+
+	return atm_gpu_request_power(gpu_loading);
+}
+
+static void atm_pid_allocate(int budget, unsigned int gpu_loading)
+{
+	int req[ATM_NR_ACTORS], granted[ATM_NR_ACTORS];
+	int min_power[ATM_NR_ACTORS], max_power[ATM_NR_ACTORS];
+	int total_req = 0, headroom = 0, extra = budget, slack = 0;
+	int i;
+
+	req[ATM_ACTOR_CPU] = mt_cpufreq_get_cur_power();
+	if (req[ATM_ACTOR_CPU] == 0)
+		req[ATM_ACTOR_CPU] = MAXIMUM_CPU_POWER;
+	req[ATM_ACTOR_GPU] = atm_gpu_request_power(gpu_loading);
+	req[ATM_ACTOR_CAM] = cl_cam_get_request_power();
+
+	min_power[ATM_ACTOR_CPU] = MINIMUM_CPU_POWER;
+	max_power[ATM_ACTOR_CPU] = MAXIMUM_CPU_POWER;
+	min_power[ATM_ACTOR_GPU] = MINIMUM_GPU_POWER;
+	max_power[ATM_ACTOR_GPU] = MAXIMUM_GPU_POWER;
+	min_power[ATM_ACTOR_CAM] = 0;
+	max_power[ATM_ACTOR_CAM] = req[ATM_ACTOR_CAM];
+
+	for (i = 0; i < ATM_NR_ACTORS; i++) {
+		req[i] = clamp(req[i], min_power[i], max_power[i]);
+		total_req += req[i];
+	}
+
+	/* share the budget in proportion to the requests */
+	for (i = 0; i < ATM_NR_ACTORS; i++) {
+		granted[i] = total_req ? (int)div_s64((s64)budget * req[i], total_req) : 0;
+		granted[i] = clamp(granted[i], min_power[i], max_power[i]);
+		extra -= granted[i];
+		headroom += max_power[i] - granted[i];
+	}
+
+	/* hand what is left to the actors that can still use it */
+	if (extra > 0 && headroom > 0) {
+		for (i = 0; i < ATM_NR_ACTORS; i++)
+			granted[i] += (int)div_s64((s64)extra * (max_power[i] - granted[i]),
+					headroom);
+	}
+
+	/*
+	 * Raising shares to the actors' minimum can overshoot the budget, so
+	 * take the excess back from what was granted above the minimums.
+	 */
+	extra = budget;
+	for (i = 0; i < ATM_NR_ACTORS; i++) {
+		extra -= granted[i];
+		slack += granted[i] - min_power[i];
+	}
+	if (extra < 0 && slack > 0) {
+		int over = -extra;
+
+		for (i = 0; i < ATM_NR_ACTORS; i++)
+			granted[i] -= min_t(int, granted[i] - min_power[i],
+					DIV_ROUND_UP_ULL((u64)over * (granted[i] - min_power[i]),
+						slack));
+	}
+
+	g_total_power = budget;
+
+	set_adaptive_cpu_power_limit(granted[ATM_ACTOR_CPU]);
+	if (granted[ATM_ACTOR_GPU] != atm_last_gpu_power) {
+		atm_last_gpu_power = granted[ATM_ACTOR_GPU];
+		set_adaptive_gpu_power_limit(granted[ATM_ACTOR_GPU]);
+	}
+	cl_cam_set_power_budget(granted[ATM_ACTOR_CAM]);
+
+	trace_thermal_atm_allocate(budget, req[ATM_ACTOR_CPU], req[ATM_ACTOR_GPU],
+			req[ATM_ACTOR_CAM], granted[ATM_ACTOR_CPU],
+			granted[ATM_ACTOR_GPU], granted[ATM_ACTOR_CAM]);
+
+	tscpu_dprintk("%s budget %d cpu %d/%d gpu %d/%d cam %d/%d\n", __func__, budget,
+			granted[ATM_ACTOR_CPU], req[ATM_ACTOR_CPU], granted[ATM_ACTOR_GPU],
+			req[ATM_ACTOR_GPU], granted[ATM_ACTOR_CAM], req[ATM_ACTOR_CAM]);
+}
+
 static int _adaptive_power(long prev_temp, long curr_temp, unsigned int gpu_loading)
 {
 	static int triggered = 0, total_power;
@@ -1976,6 +2328,14 @@ static int _adaptive_power(long prev_temp, long curr_temp, unsigned int gpu_load
 			      PACKAGE_THETA_JA_FALL, MINIMUM_BUDGET_CHANGE, MINIMUM_CPU_POWER,
 			      MAXIMUM_CPU_POWER, MINIMUM_GPU_POWER, MAXIMUM_GPU_POWER);
 
+		if (mtktscpu_atm == 3) {
+			/* PID ATM v3 runs from the adaptive cooler switch-on point */
+			triggered = 1;
+			total_power = atm_pid_controller(curr_temp);
+			atm_pid_allocate(total_power, gpu_loading);
+			return 0;
+		}
+
 		/* Check if it is triggered */
 		if (!triggered) {
 			if (curr_temp < TARGET_TJ)
@@ -2133,6 +2493,7 @@ static int _adaptive_power(long prev_temp, long curr_temp, unsigned int gpu_load
 			triggered = 0;
 			tscpu_dprintk("%s Tp %ld, Tc %ld, Pt %d\n", __func__, prev_temp, curr_temp,
 				      total_power);
+			atm_pid_reset();
 			return P_adaptive(0, 0);
 		}
 #if THERMAL_HEADROOM
@@ -2152,6 +2513,7 @@ static int _adaptive_power(long prev_temp, long curr_temp, unsigned int gpu_load
 			triggered = 0;
 			tscpu_dprintk("%s Tp %ld, Tc %ld, Pt %d\n", __func__, prev_temp, curr_temp,
 				      total_power);
+			atm_pid_reset();
 			return P_adaptive(0, 0);
 		}
 #if THERMAL_HEADROOM
@@ -2925,6 +3287,56 @@ static ssize_t tscpu_write_gpu_threshold(struct file *file, const char __user *b
 	return -EINVAL;
 }
 
+static int tscpu_read_atm_pid(struct seq_file *m, void *v)
+{
+	seq_printf(m, "sustainable %d k_po %d k_pu %d k_i %d k_d %d integral_cutoff %d\n",
+			atm_sustainable_power, atm_k_po, atm_k_pu, atm_k_i, atm_k_d,
+			atm_integral_cutoff);
+	seq_printf(m, "err_integral %lld prev_err %d total_power %d\n",
+			atm_err_integral, atm_prev_err, g_total_power);
+
+	return 0;
+}
+
+static ssize_t tscpu_write_atm_pid(struct file *file, const char __user *buffer,
+		size_t count, loff_t *data)
+{
+	char desc[128];
+	int len = 0;
+
+	int sustainable = -1, k_po = -1, k_pu = -1, k_i = -1, k_d = -1, cutoff = 0;
+
+
+	len = (count < (sizeof(desc) - 1)) ? count : (sizeof(desc) - 1);
+	if (copy_from_user(desc, buffer, len))
+		return 0;
+
+	desc[len] = '\0';
+
+	if (sscanf(desc, "%d %d %d %d %d %d", &sustainable, &k_po, &k_pu, &k_i, &k_d,
+				&cutoff) >= 5) {
+		tscpu_printk("tscpu_write_atm_pid input %d %d %d %d %d %d\n", sustainable, k_po,
+				k_pu, k_i, k_d, cutoff);
+
+		if ((sustainable >= 0) && (k_po >= 0) && (k_pu >= 0) && (k_i >= 0) && (k_d >= 0)) {
+			atm_sustainable_power = sustainable;
+			atm_k_po = k_po;
+			atm_k_pu = k_pu;
+			atm_k_i = k_i;
+			atm_k_d = k_d;
+			atm_integral_cutoff = cutoff;
+			atm_err_integral = 0;
+		} else {
+			tscpu_dprintk("tscpu_write_atm_pid out of range\n");
+		}
+
+		return count;
+	}
+	tscpu_dprintk("tscpu_write_atm_pid bad argument\n");
+
+	return -EINVAL;
+}
+
 #if THERMAL_HEADROOM
 static int tscpu_read_thp(struct seq_file *m, void *v)
 {
@@ -3017,6 +3429,58 @@ static ssize_t tscpu_write_fastpoll(struct file *file, const char __user *buffer
 }
 #endif
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+static int tscpu_read_offset_int(struct seq_file *m, void *v)
+{
+	seq_printf(m, "enable %d window %d factor %d\n", tc_offset_int_enable,
+			tc_offset_window, tc_safety_polling_factor);
+	seq_printf(m, "low %d high %d irq %u\n", tc_offset_low, tc_offset_high,
+			tc_offset_int_count);
+
+	return 0;
+}
+
+static ssize_t tscpu_write_offset_int(struct file *file, const char __user *buffer, size_t count,
+		loff_t *data)
+{
+	char desc[128];
+	int len = 0;
+
+	int enable = -1, window = -1, factor = -1;
+
+
+	len = (count < (sizeof(desc) - 1)) ? count : (sizeof(desc) - 1);
+	if (copy_from_user(desc, buffer, len))
+		return 0;
+	desc[len] = '\0';
+
+	if (sscanf(desc, "%d %d %d", &enable, &window, &factor) >= 3) {
+		tscpu_printk("tscpu_write_offset_int input %d %d %d\n", enable, window, factor);
+
+		if ((enable >= 0) && (window > 0) && (factor > 0)) {
+			tc_offset_window = window;
+			tc_safety_polling_factor = factor;
+			tc_offset_int_enable = enable;
+			if (!enable) {
+				tscpu_clear_offset_window();
+				tscpu_tempinfo_timer_pause(false);
+			}
+
+			/* re-evaluate with the new settings */
+			if (thz_dev)
+				thermal_zone_device_update(thz_dev);
+		} else {
+			tscpu_dprintk("tscpu_write_offset_int out of range\n");
+		}
+
+		return count;
+	}
+	tscpu_dprintk("tscpu_write_offset_int bad argument\n");
+
+	return -EINVAL;
+}
+#endif
+
 static ssize_t tscpu_write(struct file *file, const char __user *buffer, size_t count,
 		loff_t *data)
 {
@@ -3651,6 +4115,20 @@ static const struct file_operations mtktscpu_gpu_threshold_fops = {
 	.release = single_release,
 };
 
+static int tscpu_atm_pid_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tscpu_read_atm_pid, NULL);
+}
+
+static const struct file_operations mtktscpu_atm_pid_fops = {
+	.owner = THIS_MODULE,
+	.open = tscpu_atm_pid_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.write = tscpu_write_atm_pid,
+	.release = single_release,
+};
+
 #if THERMAL_HEADROOM
 static int tscpu_thp_open(struct inode *inode, struct file *file)
 {
@@ -3687,6 +4165,22 @@ static const struct file_operations mtktscpu_fastpoll_fops = {
 };
 #endif
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+static int tscpu_offset_int_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tscpu_read_offset_int, NULL);
+}
+
+static const struct file_operations mtktscpu_offset_int_fops = {
+	.owner = THIS_MODULE,
+	.open = tscpu_offset_int_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.write = tscpu_write_offset_int,
+	.release = single_release,
+};
+#endif
+
 static void thermal_initial(void)
 {
 	unsigned long flags;
@@ -3987,7 +4481,10 @@ void tscpu_start_thermal_timer(void)
 
 	/* start timer */
 	ktime = ktime_set(0, 50000000);	/* 50ms */
-	hrtimer_start(&ts_tempinfo_hrtimer, ktime, HRTIMER_MODE_REL);
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+	if (!tc_tempinfo_timer_paused)
+#endif
+		hrtimer_start(&ts_tempinfo_hrtimer, ktime, HRTIMER_MODE_REL);
 
 	/* resume thermal framework polling when leaving deep idle */
 	if (thz_dev != NULL && interval != 0)
@@ -4266,6 +4763,10 @@ static int tscpu_thermal_probe(struct platform_device *pdev)
 #endif
 
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+	INIT_WORK(&tc_offset_int_work, tscpu_offset_int_work);
+#endif
+
 #ifdef CONFIG_OF
 	err =
 		request_irq(thermal_irq_number, thermal_interrupt_handler, IRQF_TRIGGER_LOW,
@@ -4340,6 +4841,11 @@ static int tscpu_thermal_probe(struct platform_device *pdev)
 					&mtktscpu_gpu_threshold_fops);
 		if (entry)
 			proc_set_user(entry, uid, gid);
+		entry =
+			proc_create("clatm_pid", S_IRUGO | S_IWUSR | S_IWGRP, mtktscpu_dir,
+					&mtktscpu_atm_pid_fops);
+		if (entry)
+			proc_set_user(entry, uid, gid);
 #endif				/* #if CPT_ADAPTIVE_AP_COOLER */
 
 #if MTKTSCPU_FAST_POLLING
@@ -4350,6 +4856,14 @@ static int tscpu_thermal_probe(struct platform_device *pdev)
 			proc_set_user(entry, uid, gid);
 #endif				/* #if MTKTSCPU_FAST_POLLING */
 
+#if THERMAL_CONTROLLER_HW_OFFSET_INT
+		entry =
+			proc_create("tzcpu_offset_int", S_IRUGO | S_IWUSR | S_IWGRP, mtktscpu_dir,
+					&mtktscpu_offset_int_fops);
+		if (entry)
+			proc_set_user(entry, uid, gid);
+#endif				/* #if THERMAL_CONTROLLER_HW_OFFSET_INT */
+
 		entry =
 			proc_create("tzcpu_Tj_out_via_HW_pin", S_IRUGO | S_IWUSR, mtktscpu_dir,
 					&mtktscpu_Tj_out_fops);
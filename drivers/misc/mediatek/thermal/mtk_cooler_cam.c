@@ -59,6 +59,10 @@ static int dualcam_Tj_jump_threshold = 20000;
 static int single_cam_flag;
 /*10000=>10'C*/
 static int dualcam_Tj_hysteresis = 10000;
+/* power of the running camera pipeline in mW, reported by the camera HAL */
+static int cl_cam_request_power;
+/* 1: the power allocator granted less than cl_cam_request_power */
+static unsigned int _cl_cam_budget;
 
 
 /*
@@ -119,12 +123,34 @@ static void cl_cam_status_update(void)
 {
 	if (_cl_cam_urgent)
 		_cl_cam_status = CL_CAM_URGENT;
-	else if (_cl_cam)
+	else if (_cl_cam || _cl_cam_budget)
 		_cl_cam_status = CL_CAM_ACTIVE;
 	else
 		_cl_cam_status = CL_CAM_DEACTIVE;
 }
 
+int cl_cam_get_request_power(void)
+{
+	return cl_cam_request_power;
+}
+
+/*
+ * Power budget of the camera from the ATM power allocator in mW, a negative
+ * budget releases it. The camera is asked to throttle through cl_cam_status
+ * while the budget is below what the pipeline needs.
+ */
+void cl_cam_set_power_budget(int budget)
+{
+	unsigned int throttle = (budget >= 0 && budget < cl_cam_request_power) ? 1 : 0;
+
+	if (throttle != _cl_cam_budget) {
+		_cl_cam_budget = throttle;
+		mtk_cooler_cam_dprintk("%s budget %d request %d\n", __func__, budget,
+			cl_cam_request_power);
+		cl_cam_status_update();
+	}
+}
+
 static ssize_t _cl_cam_write(struct file *filp, const char __user *buf, size_t len, loff_t *data)
 {
 	int ret = 0;
@@ -165,6 +191,46 @@ static const struct file_operations _cl_cam_fops = {
 	.release = single_release,
 };
 
+static ssize_t _cl_cam_power_write(struct file *filp, const char __user *buf, size_t len, loff_t *data)
+{
+	char tmp[128] = { 0 };
+	int power;
+
+	len = (len < (128 - 1)) ? len : (128 - 1);
+	/* write data to the buffer */
+	if (copy_from_user(tmp, buf, len))
+		return -EFAULT;
+
+	if (kstrtoint(tmp, 10, &power) || power < 0)
+		return -EINVAL;
+
+	cl_cam_request_power = power;
+	mtk_cooler_cam_dprintk_always("%s %d\n", __func__, cl_cam_request_power);
+
+	return len;
+}
+
+static int _cl_cam_power_read(struct seq_file *m, void *v)
+{
+	seq_printf(m, "%d %u\n", cl_cam_request_power, _cl_cam_budget);
+
+	return 0;
+}
+
+static int _cl_cam_power_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _cl_cam_power_read, PDE_DATA(inode));
+}
+
+static const struct file_operations _cl_cam_power_fops = {
+	.owner = THIS_MODULE,
+	.open = _cl_cam_power_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.write = _cl_cam_power_write,
+	.release = single_release,
+};
+
 static int mtk_cl_cam_get_max_state(struct thermal_cooling_device *cdev, unsigned long *state)
 {
 	*state = 1;
@@ -426,6 +492,11 @@ static int __init mtk_cooler_cam_init(void)
 			NULL, &_cl_cam_dual_off_fops);
 		if (!entry)
 			mtk_cooler_cam_dprintk("%s driver/cl_cam_dual creation failed\n", __func__);
+
+		entry = proc_create("driver/cl_cam_power", S_IRUGO | S_IWUSR | S_IWGRP,
+			NULL, &_cl_cam_power_fops);
+		if (!entry)
+			mtk_cooler_cam_dprintk("%s driver/cl_cam_power creation failed\n", __func__);
 	}
 
 	err = mtk_cooler_cam_register_ltf();
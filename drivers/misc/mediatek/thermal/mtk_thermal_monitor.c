@@ -1652,7 +1652,12 @@ static int __init mtkthermal_init(void)
 	md32_register_notify(&mtk_thermal_ext_nb);
 #endif
 
-	INIT_DELAYED_WORK(&_mtm_sysinfo_poll_queue, _mtm_update_sysinfo);
+	/*
+	 * Sysinfo sampling only feeds cooler conditions evaluated on zone
+	 * updates, so it must not wake an idle cpu by itself now that zones
+	 * are updated on threshold interrupts.
+	 */
+	INIT_DEFERRABLE_WORK(&_mtm_sysinfo_poll_queue, _mtm_update_sysinfo);
 	_mtm_update_sysinfo(NULL);
 
 	return err;
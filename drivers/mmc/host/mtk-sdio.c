@@ -14,8 +14,11 @@
 
 #include <linux/module.h>
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dma-mapping.h>
+#include <linux/hardirq.h>
+#include <linux/iopoll.h>
 #include <linux/ioport.h>
 #include <linux/irq.h>
 #include <linux/of_address.h>
@@ -26,6 +29,7 @@
 #include <linux/pm.h>
 #include <linux/pm_runtime.h>
 #include <linux/regulator/consumer.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 
@@ -37,6 +41,9 @@
 #include <linux/mmc/sdio.h>
 #include <linux/mmc/slot-gpio.h>
 #include <linux/mmc/sdio_func.h>
+#include <linux/mmc/mtk_sdio.h>
+
+#include <asm/unaligned.h>
 
 #define MAX_BD_NUM          1024
 
@@ -528,11 +535,36 @@
 #define MSDC_PREPARE_FLAG (0x1 << 0)
 #define MSDC_ASYNC_FLAG (0x1 << 1)
 #define MSDC_MMAP_FLAG (0x1 << 2)
+#define MSDC_PIO_FLAG (0x1 << 3)
 
 #define MTK_MMC_AUTOSUSPEND_DELAY	50
 #define CMD_TIMEOUT         (HZ/10 * 5)	/* 100ms x5 */
 #define DAT_TIMEOUT         (HZ    * 5)	/* 1000ms x5 */
 
+/*
+ * Single block CMD53 of up to pio_thresh bytes, and CMD52, are run in PIO
+ * mode with the completion polled from the request context instead of
+ * going through GPD/BD DMA and msdc_irq. The choice is made once per
+ * request and kept in host_cookie, so that a pio_thresh change cannot
+ * leave a DMA mapped request to be run in PIO.
+ */
+#define MSDC_FIFO_SZ		128
+#define MSDC_PIO_THRESH		64
+#define MSDC_PIO_SLEEP_US	10
+#define MSDC_PIO_POLL_US	10000
+
+/* cmd only, <=4, <=8, <=16, <=32, <=64, <=512, <=4k, >4k bytes */
+#define MSDC_SIZE_CLASSES	9
+/* log2 of the request latency in us */
+#define MSDC_LAT_BUCKETS	16
+
+/*
+ * With MMC_CAP2_SDIO_IRQ_NOTHREAD the card interrupt is run from the
+ * threaded handler of msdc_irq or of the DAT1 EINT, which then keeps
+ * polling for a new one for sdio_irq_poll_us before rearming.
+ */
+#define MSDC_SDIO_IRQ_POLL_US	50
+
 #define PAD_DELAY_MAX	32 /* PAD delay cells */
 
 #define AUTOK_RECOVERABLE_ERROR		-1
@@ -657,8 +689,25 @@ struct msdc_host {
 	struct msdc_save_para save_para; /* used when gate HCLK */
 	struct msdc_tune_para def_tune_para; /* default tune setting */
 	struct msdc_tune_para saved_tune_para; /* tune result of CMD21/CMD19 */
-	bool autok_done;
 	int autok_error;
+	u32 autok_slot;		/* msdc_autok_cache key, register base */
+	u32 autok_reuse_cnt;	/* tunes served from msdc_autok_cache */
+	u32 autok_full_cnt;
+	u32 autok_check_fail;
+	u64 autok_reuse_us;
+	u64 autok_full_us;
+
+	u32 pio_thresh;		/* max bytes of a polled PIO transfer */
+	u64 req_start_ns;
+	u32 pio_cnt;
+	u32 dma_cnt;
+	u32 lat_hist[MSDC_SIZE_CLASSES][MSDC_LAT_BUCKETS];
+
+	u64 sdio_irq_ts;	/* hardirq time of the pending card irq */
+	u32 sdio_irq_poll_us;
+	u32 sdio_irq_runs;
+	u32 sdio_irq_polled;
+	u32 sdio_irq_lat[MSDC_LAT_BUCKETS];
 };
 
 static bool sdio_online_tune_fail;
@@ -666,6 +715,7 @@ static void msdc_dump_all_register(struct msdc_host *host);
 static void msdc_cmd_next(struct msdc_host *host,
 		struct mmc_request *mrq, struct mmc_command *cmd);
 static void msdc_recheck_sdio_irq(struct msdc_host *host);
+static void msdc_signal_sdio_irq(struct msdc_host *host);
 
 
 static void sdr_set_bits(void __iomem *reg, u32 bs)
@@ -1107,6 +1157,30 @@ static void msdc_track_cmd_data(struct msdc_host *host,
 			__func__, cmd->opcode, cmd->arg, host->error);
 }
 
+static int msdc_size_class(unsigned int bytes)
+{
+	if (!bytes)
+		return 0;
+	if (bytes <= 4)
+		return 1;
+	if (bytes <= 64)
+		return fls(bytes - 1) - 1;
+	if (bytes <= 512)
+		return 6;
+	if (bytes <= 4096)
+		return 7;
+	return 8;
+}
+
+static void msdc_account_req(struct msdc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+	u64 us = div_u64(ktime_get_ns() - host->req_start_ns, NSEC_PER_USEC);
+	int size = msdc_size_class(data ? data->blocks * data->blksz : 0);
+
+	host->lat_hist[size][min_t(int, fls64(us), MSDC_LAT_BUCKETS - 1)]++;
+}
+
 static void msdc_request_done(struct msdc_host *host, struct mmc_request *mrq)
 {
 	unsigned long flags;
@@ -1122,6 +1196,7 @@ static void msdc_request_done(struct msdc_host *host, struct mmc_request *mrq)
 	spin_unlock_irqrestore(&host->lock, flags);
 
 	msdc_track_cmd_data(host, mrq->cmd, mrq->data);
+	msdc_account_req(host, mrq);
 	if (mrq->data)
 		msdc_unprepare_data(host, mrq);
 	mmc_request_done(host->mmc, mrq);
@@ -1318,6 +1393,260 @@ static void msdc_cmd_next(struct msdc_host *host,
 		msdc_start_data(host, mrq, cmd, cmd->data);
 }
 
+static bool msdc_check_pio(struct msdc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+
+	/* card enumeration runs at 400kHz, leave it to the IRQ path */
+	if (!host->mmc->card || mrq->sbc || mrq->stop)
+		return false;
+	if (mrq->cmd->opcode == SD_IO_RW_DIRECT)
+		return !data;
+	if (mrq->cmd->opcode != SD_IO_RW_EXTENDED || !data)
+		return false;
+	return data->blocks == 1 && data->sg_len == 1 &&
+	       data->blksz <= min_t(u32, host->pio_thresh, MSDC_FIFO_SZ) &&
+	       data->sg->length >= data->blksz;
+}
+
+/* the first call for a request with data decides, later ones follow it */
+static bool msdc_use_pio(struct msdc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return msdc_check_pio(host, mrq);
+	if (data->host_cookie & (MSDC_PREPARE_FLAG | MSDC_PIO_FLAG))
+		return data->host_cookie & MSDC_PIO_FLAG;
+	if (!msdc_check_pio(host, mrq))
+		return false;
+	data->host_cookie |= MSDC_PIO_FLAG;
+	return true;
+}
+
+/* wait for and acknowledge any of @mask; returns 0 if none came in time */
+static u32 msdc_poll_int(struct msdc_host *host, u32 mask)
+{
+	u32 events;
+
+	if (readl_poll_timeout(host->base + MSDC_INT, events, events & mask,
+			       MSDC_PIO_SLEEP_US, MSDC_PIO_POLL_US))
+		return 0;
+	events &= mask;
+	writel(events, host->base + MSDC_INT);
+	return events;
+}
+
+static int msdc_pio_read(struct msdc_host *host, u8 *buf, u32 len)
+{
+	u32 avail;
+
+	while (len) {
+		if (readl_poll_timeout(host->base + MSDC_FIFOCS, avail,
+				       avail & MSDC_FIFOCS_RXCNT,
+				       MSDC_PIO_SLEEP_US, MSDC_PIO_POLL_US))
+			return -ETIMEDOUT;
+		avail &= MSDC_FIFOCS_RXCNT;
+		for (; avail >= 4 && len >= 4; avail -= 4, len -= 4, buf += 4)
+			put_unaligned(readl(host->base + MSDC_RXDATA),
+				      (u32 *)buf);
+		for (; avail && len && len < 4; avail--, len--)
+			*buf++ = readb(host->base + MSDC_RXDATA);
+	}
+	return 0;
+}
+
+/* the whole transfer fits into the empty TX FIFO */
+static void msdc_pio_write(struct msdc_host *host, const u8 *buf, u32 len)
+{
+	for (; len >= 4; len -= 4, buf += 4)
+		writel(get_unaligned((const u32 *)buf),
+		       host->base + MSDC_TXDATA);
+	while (len--)
+		writeb(*buf++, host->base + MSDC_TXDATA);
+}
+
+/*
+ * Run @mrq synchronously in PIO mode. Command and data interrupts stay
+ * masked, so msdc_irq only looks at the SDIO interrupt meanwhile. The
+ * caller completes the request.
+ */
+static void msdc_pio_run(struct msdc_host *host, struct mmc_request *mrq)
+{
+	struct mmc_command *cmd = mrq->cmd;
+	struct mmc_data *data = mrq->data;
+	u32 rawcmd, events, val;
+	int err;
+
+	cmd->error = 0;
+	if (readl_poll_timeout(host->base + SDC_STS, val,
+			       !(val & SDC_STS_CMDBUSY), MSDC_PIO_SLEEP_US,
+			       MSDC_PIO_POLL_US) ||
+	    readl_poll_timeout(host->base + MSDC_PS, val, val & BIT(16),
+			       MSDC_PIO_SLEEP_US, MSDC_PIO_POLL_US)) {
+		dev_err(host->dev, "%s: bus busy, cmd=%d\n", __func__,
+			cmd->opcode);
+		host->error |= REQ_CMD_BUSY;
+		cmd->error = -ETIMEDOUT;
+		return;
+	}
+
+	if (readl(host->base + MSDC_FIFOCS) &
+	    (MSDC_FIFOCS_TXCNT | MSDC_FIFOCS_RXCNT))
+		msdc_reset_hw(host);
+
+	rawcmd = msdc_cmd_prepare_raw_cmd(host, mrq, cmd);
+	if (data)
+		sdr_set_bits(host->base + MSDC_CFG, MSDC_CFG_PIO);
+
+	writel(cmd->arg, host->base + SDC_ARG);
+	writel(rawcmd, host->base + SDC_CMD);
+
+	events = msdc_poll_int(host, MSDC_INT_CMDRDY | MSDC_INT_RSPCRCERR |
+				     MSDC_INT_CMDTMO);
+	if (cmd->flags & MMC_RSP_PRESENT)
+		cmd->resp[0] = readl(host->base + SDC_RESP0);
+	if (!(events & MSDC_INT_CMDRDY)) {
+		msdc_reset_hw(host);
+		if (events & MSDC_INT_RSPCRCERR) {
+			cmd->error = -EILSEQ;
+			host->error |= REQ_CMD_EIO;
+		} else {
+			cmd->error = -ETIMEDOUT;
+			host->error |= REQ_CMD_TMO;
+		}
+		goto out;
+	}
+	if (!data)
+		goto out;
+
+	if (data->flags & MMC_DATA_READ) {
+		err = msdc_pio_read(host, sg_virt(data->sg), data->blksz);
+	} else {
+		msdc_pio_write(host, sg_virt(data->sg), data->blksz);
+		err = 0;
+	}
+
+	events = msdc_poll_int(host, MSDC_INT_XFER_COMPL | MSDC_INT_DATTMO |
+				     MSDC_INT_DATCRCERR);
+	if (!err && (events & MSDC_INT_XFER_COMPL)) {
+		data->bytes_xfered = data->blksz;
+	} else {
+		msdc_reset_hw(host);
+		host->error |= REQ_DAT_ERR;
+		data->bytes_xfered = 0;
+		data->error = (events & MSDC_INT_DATCRCERR) ? -EILSEQ :
+							      -ETIMEDOUT;
+		dev_err(host->dev, "%s: cmd=%d arg=%08X data_error=%d\n",
+			__func__, cmd->opcode, cmd->arg, data->error);
+	}
+
+out:
+	if (data)
+		sdr_clr_bits(host->base + MSDC_CFG, MSDC_CFG_PIO);
+	host->pio_cnt++;
+}
+
+static void msdc_pio_request(struct msdc_host *host, struct mmc_request *mrq)
+{
+	unsigned long flags;
+
+	msdc_pio_run(host, mrq);
+	msdc_account_req(host, mrq);
+	if (mrq->data)
+		mrq->data->host_cookie &= ~MSDC_PIO_FLAG;
+
+	spin_lock_irqsave(&host->lock, flags);
+	host->mrq = NULL;
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	mmc_request_done(host->mmc, mrq);
+	msdc_recheck_sdio_irq(host);
+}
+
+static struct mmc_host_ops mt_msdc_ops;
+
+static int msdc_sdio_batch_rw(struct sdio_func *func, const u32 *addrs,
+			      u32 *vals, int n, bool write)
+{
+	struct msdc_host *host = mmc_priv(func->card->host);
+	struct mmc_request mrq;
+	struct mmc_command cmd;
+	struct mmc_data data;
+	struct scatterlist sg;
+	unsigned long flags;
+	__le32 buf;
+	int i, err = 0;
+
+	if (func->card->host->ops != &mt_msdc_ops)
+		return -EOPNOTSUPP;
+
+	for (i = 0; i < n && !err; i++) {
+		memset(&mrq, 0, sizeof(mrq));
+		memset(&cmd, 0, sizeof(cmd));
+		memset(&data, 0, sizeof(data));
+
+		/* byte mode, incrementing address */
+		cmd.opcode = SD_IO_RW_EXTENDED;
+		cmd.arg = (write ? 0x80000000 : 0) | func->num << 28 |
+			  0x04000000 | (addrs[i] & 0x1ffff) << 9 | 4;
+		cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+		cmd.data = &data;
+
+		buf = cpu_to_le32(write ? vals[i] : 0);
+		sg_init_one(&sg, &buf, sizeof(buf));
+		data.blksz = sizeof(buf);
+		data.blocks = 1;
+		data.flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
+		data.sg = &sg;
+		data.sg_len = 1;
+		data.mrq = &mrq;
+		mmc_set_data_timeout(&data, func->card);
+
+		mrq.cmd = &cmd;
+		mrq.data = &data;
+
+		host->error = 0;
+		host->req_start_ns = ktime_get_ns();
+		spin_lock_irqsave(&host->lock, flags);
+		WARN_ON(host->mrq);
+		host->mrq = &mrq;
+		spin_unlock_irqrestore(&host->lock, flags);
+
+		msdc_pio_run(host, &mrq);
+		msdc_account_req(host, &mrq);
+
+		spin_lock_irqsave(&host->lock, flags);
+		host->mrq = NULL;
+		spin_unlock_irqrestore(&host->lock, flags);
+
+		err = cmd.error ? cmd.error : data.error;
+		if (!err && (cmd.resp[0] & (R5_ERROR | R5_FUNCTION_NUMBER |
+					    R5_OUT_OF_RANGE)))
+			err = -EIO;
+		if (!err && !write)
+			vals[i] = le32_to_cpu(buf);
+	}
+
+	msdc_recheck_sdio_irq(host);
+	return err;
+}
+
+/* See include/linux/mmc/mtk_sdio.h */
+int sdio_batch_readl(struct sdio_func *func, const u32 *addrs, u32 *vals,
+		     int n)
+{
+	return msdc_sdio_batch_rw(func, addrs, vals, n, false);
+}
+EXPORT_SYMBOL(sdio_batch_readl);
+
+int sdio_batch_writel(struct sdio_func *func, const u32 *addrs,
+		      const u32 *vals, int n)
+{
+	return msdc_sdio_batch_rw(func, addrs, (u32 *)vals, n, true);
+}
+EXPORT_SYMBOL(sdio_batch_writel);
+
 static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 {
 	struct msdc_host *host = mmc_priv(mmc);
@@ -1325,6 +1654,13 @@ static void msdc_ops_request(struct mmc_host *mmc, struct mmc_request *mrq)
 	host->error = 0;
 	WARN_ON(host->mrq);
 	host->mrq = mrq;
+	host->req_start_ns = ktime_get_ns();
+
+	if (msdc_use_pio(host, mrq)) {
+		msdc_pio_request(host, mrq);
+		return;
+	}
+	host->dma_cnt++;
 
 	if (mrq->data)
 		msdc_prepare_data(host, mrq);
@@ -1346,7 +1682,7 @@ static void msdc_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
 	struct msdc_host *host = mmc_priv(mmc);
 	struct mmc_data *data = mrq->data;
 
-	if (!data)
+	if (!data || msdc_use_pio(host, mrq))
 		return;
 
 	msdc_prepare_data(host, mrq);
@@ -1546,7 +1882,7 @@ static irqreturn_t msdc_irq(int irq, void *dev_id)
 	spin_unlock_irqrestore(&host->irqlock, flags);
 
 	if ((events & event_mask) & MSDC_INT_SDIOIRQ) {
-		mmc_signal_sdio_irq(host->mmc);
+		msdc_signal_sdio_irq(host);
 		if (!mrq)
 			return IRQ_HANDLED;
 	}
@@ -3851,22 +4187,210 @@ static void msdc_dump_register(struct msdc_host *host)
 	pr_info("SDIO MSDC_PAD_TUNE1=0x%.8x\n", readl(base + MSDC_PAD_TUNE1));
 }
 
+/*
+ * Autok results are cached per host slot, timing and signal voltage so
+ * that boot, resume and retune can skip the full sweep. The bootloader may
+ * seed the cache with mtk_sdio.autok_cache=, and the same parameter reads
+ * it back for persisting. Entries are separated by ',' and each one is
+ *
+ *   slot:timing:signal_voltage:<TUNING_PARAM_COUNT bytes in hex>
+ *
+ * slot is the physical register base of the host in hex. The card is not
+ * attached to the host yet while it is tuned during enumeration, so the
+ * slot stands in for the card: the SDIO slots are wired to soldered down
+ * devices. A cached entry is only used once a single-point check at its
+ * settings passes, otherwise the full sweep is rerun.
+ */
+#define MSDC_AUTOK_CACHE_SZ	4
+#define MSDC_AUTOK_CHECK_TIMES	(AUTOK_CMD_TIMES / 2)
+
+struct msdc_autok_entry {
+	u32 slot;
+	u8 timing;
+	u8 voltage;
+	bool valid;
+	u8 res[TUNING_PARAM_COUNT];
+};
+
+static struct msdc_autok_entry msdc_autok_cache[MSDC_AUTOK_CACHE_SZ];
+static DEFINE_SPINLOCK(msdc_autok_lock);
+
+/* entry for the slot and ios of @host */
+static struct msdc_autok_entry *msdc_autok_find(struct msdc_host *host)
+{
+	struct mmc_ios *ios = &host->mmc->ios;
+	struct msdc_autok_entry *e;
+	int i;
+
+	for (i = 0; i < MSDC_AUTOK_CACHE_SZ; i++) {
+		e = &msdc_autok_cache[i];
+		if (e->valid && e->slot == host->autok_slot &&
+		    e->timing == ios->timing &&
+		    e->voltage == ios->signal_voltage)
+			return e;
+	}
+	return NULL;
+}
+
+static bool msdc_autok_lookup(struct msdc_host *host, u8 *res)
+{
+	struct msdc_autok_entry *e;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msdc_autok_lock, flags);
+	e = msdc_autok_find(host);
+	if (e)
+		memcpy(res, e->res, TUNING_PARAM_COUNT);
+	spin_unlock_irqrestore(&msdc_autok_lock, flags);
+	return e != NULL;
+}
+
+static void msdc_autok_store(struct msdc_host *host, const u8 *res)
+{
+	struct mmc_ios *ios = &host->mmc->ios;
+	struct msdc_autok_entry *e;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&msdc_autok_lock, flags);
+	e = msdc_autok_find(host);
+	for (i = 0; !e && i < MSDC_AUTOK_CACHE_SZ; i++)
+		if (!msdc_autok_cache[i].valid)
+			e = &msdc_autok_cache[i];
+	if (!e)
+		e = &msdc_autok_cache[MSDC_AUTOK_CACHE_SZ - 1];
+	e->slot = host->autok_slot;
+	e->timing = ios->timing;
+	e->voltage = ios->signal_voltage;
+	memcpy(e->res, res, TUNING_PARAM_COUNT);
+	e->valid = true;
+	spin_unlock_irqrestore(&msdc_autok_lock, flags);
+}
+
+/* single-point check of the applied settings, E_RESULT_PASS if they work */
+static int msdc_autok_check(struct msdc_host *host)
+{
+	void __iomem *base = host->base;
+	unsigned int clk_pwdn = 0;
+	unsigned int int_en;
+	int i, ret = E_RESULT_PASS;
+
+	autok_msdc_reset();
+	msdc_clear_fifo();
+	int_en = readl(base + MSDC_INTEN);
+	writel(0, base + MSDC_INTEN);
+	sdr_get_field(base + MSDC_CFG, MSDC_CFG_CKPDN, &clk_pwdn);
+	sdr_set_field(base + MSDC_CFG, MSDC_CFG_CKPDN, 1);
+
+	for (i = 0; i < MSDC_AUTOK_CHECK_TIMES && ret == E_RESULT_PASS; i++)
+		ret = autok_send_tune_cmd(host, MMC_SEND_TUNING_BLOCK, TUNE_DATA);
+
+	autok_msdc_reset();
+	msdc_clear_fifo();
+	writel(0xffffffff, base + MSDC_INT);
+	writel(int_en, base + MSDC_INTEN);
+	sdr_set_field(base + MSDC_CFG, MSDC_CFG_CKPDN, clk_pwdn);
+
+	return ret;
+}
+
 static int msdc_execute_tuning(struct mmc_host *mmc, u32 opcode)
 {
 	struct msdc_host *host = mmc_priv(mmc);
+	u64 start = ktime_get_ns();
+	int ret;
 
-	if (host->autok_done) {
+	if (msdc_autok_lookup(host, sdio_autok_res)) {
 		autok_init_sdr104(host);
 		autok_param_apply(host, sdio_autok_res);
-	} else {
-		autok_execute_tuning(host, sdio_autok_res);
-		host->autok_done = true;
+		ret = msdc_autok_check(host);
+		if (ret == E_RESULT_PASS) {
+			msdc_autok_store(host, sdio_autok_res);
+			host->autok_reuse_cnt++;
+			host->autok_reuse_us += div_u64(ktime_get_ns() - start,
+							NSEC_PER_USEC);
+			goto out;
+		}
+		host->autok_check_fail++;
+		dev_info(host->dev, "cached autok result failed (0x%x), retune\n",
+			 ret);
 	}
 
+	if (!autok_execute_tuning(host, sdio_autok_res))
+		msdc_autok_store(host, sdio_autok_res);
+	host->autok_full_cnt++;
+	host->autok_full_us += div_u64(ktime_get_ns() - start, NSEC_PER_USEC);
+
+out:
 	msdc_dump_register(host);
 	return 0;
 }
 
+static int msdc_autok_cache_set(const char *val, const struct kernel_param *kp)
+{
+	struct msdc_autok_entry cache[MSDC_AUTOK_CACHE_SZ];
+	struct msdc_autok_entry *e;
+	unsigned long flags;
+	int i, n;
+
+	memset(cache, 0, sizeof(cache));
+	for (i = 0; *val && *val != '\n'; i++) {
+		if (i == MSDC_AUTOK_CACHE_SZ)
+			return -ENOSPC;
+		e = &cache[i];
+		n = 0;
+		if (sscanf(val, "%x:%hhu:%hhu:%n", &e->slot, &e->timing,
+			   &e->voltage, &n) != 3 || !n || !e->slot)
+			return -EINVAL;
+		val += n;
+		if (hex2bin(e->res, val, TUNING_PARAM_COUNT))
+			return -EINVAL;
+		val += 2 * TUNING_PARAM_COUNT;
+		if (*val == ',')
+			val++;
+		else if (*val && *val != '\n')
+			return -EINVAL;
+		e->valid = true;
+	}
+
+	spin_lock_irqsave(&msdc_autok_lock, flags);
+	memcpy(msdc_autok_cache, cache, sizeof(cache));
+	spin_unlock_irqrestore(&msdc_autok_lock, flags);
+	return 0;
+}
+
+static int msdc_autok_cache_get(char *buf, const struct kernel_param *kp)
+{
+	struct msdc_autok_entry cache[MSDC_AUTOK_CACHE_SZ];
+	struct msdc_autok_entry *e;
+	unsigned long flags;
+	int i, len = 0;
+
+	spin_lock_irqsave(&msdc_autok_lock, flags);
+	memcpy(cache, msdc_autok_cache, sizeof(cache));
+	spin_unlock_irqrestore(&msdc_autok_lock, flags);
+
+	for (i = 0; i < MSDC_AUTOK_CACHE_SZ; i++) {
+		e = &cache[i];
+		if (!e->valid)
+			continue;
+		len += sprintf(buf + len, "%s%x:%u:%u:", len ? "," : "",
+			       e->slot, e->timing, e->voltage);
+		bin2hex(buf + len, e->res, TUNING_PARAM_COUNT);
+		len += 2 * TUNING_PARAM_COUNT;
+	}
+	buf[len++] = '\n';
+	return len;
+}
+
+static const struct kernel_param_ops msdc_autok_cache_ops = {
+	.set = msdc_autok_cache_set,
+	.get = msdc_autok_cache_get,
+};
+
+module_param_cb(autok_cache, &msdc_autok_cache_ops, NULL, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(autok_cache, "cached autok results, slot:timing:voltage:hex,...");
+
 static void msdc_hw_reset(struct mmc_host *mmc)
 {
 	struct msdc_host *host = mmc_priv(mmc);
@@ -3895,7 +4419,7 @@ static void msdc_recheck_sdio_irq(struct msdc_host *host)
 		reg_int = readl(host->base + MSDC_INT);
 		reg_ps  = readl(host->base + MSDC_PS);
 		if (!((reg_int & MSDC_INT_SDIOIRQ) || (reg_ps & MSDC_PS_DATA1)))
-			mmc_signal_sdio_irq(host->mmc);
+			msdc_signal_sdio_irq(host);
 	}
 }
 
@@ -3943,12 +4467,99 @@ static struct mmc_host_ops mt_msdc_ops = {
 	.enable_sdio_irq = msdc_enable_sdio_irq,
 };
 
+/* card irq still asserted; the host is claimed so DAT1 carries no data */
+static bool msdc_sdio_irq_asserted(struct msdc_host *host)
+{
+	u32 events = readl(host->base + MSDC_INT) & MSDC_INT_SDIOIRQ;
+
+	if (events)
+		writel(events, host->base + MSDC_INT);
+	return events || !(readl(host->base + MSDC_PS) & MSDC_PS_DATA1);
+}
+
+/*
+ * Run the function irq handlers straight from our irq thread, then keep
+ * polling for a follow-up interrupt for a while before rearming. The
+ * card irq has been disabled by msdc_signal_sdio_irq() or
+ * sdio_eint_irq().
+ */
+static void msdc_run_sdio_irqs(struct msdc_host *host)
+{
+	struct mmc_host *mmc = host->mmc;
+	u64 now, end;
+	bool again;
+
+	mmc_claim_host(mmc);
+
+	now = ktime_get_ns();
+	host->sdio_irq_lat[min_t(int, fls64(div_u64(now - host->sdio_irq_ts,
+						    NSEC_PER_USEC)),
+				 MSDC_LAT_BUCKETS - 1)]++;
+
+	do {
+		host->sdio_irq_runs++;
+		sdio_run_irqs(mmc);
+		mmc->sdio_irq_pending = false;
+
+		again = false;
+		end = ktime_get_ns() + host->sdio_irq_poll_us * NSEC_PER_USEC;
+		/* the handler may have released the last function irq */
+		while (mmc->sdio_irqs) {
+			if (msdc_sdio_irq_asserted(host)) {
+				host->sdio_irq_polled++;
+				again = true;
+				break;
+			}
+			if (ktime_get_ns() >= end)
+				break;
+			cpu_relax();
+		}
+	} while (again);
+
+	if (mmc->sdio_irqs)
+		msdc_enable_sdio_irq(mmc, 1);
+	mmc_release_host(mmc);
+}
+
+static void msdc_signal_sdio_irq(struct msdc_host *host)
+{
+	if (!(host->mmc->caps2 & MMC_CAP2_SDIO_IRQ_NOTHREAD)) {
+		mmc_signal_sdio_irq(host->mmc);
+		return;
+	}
+
+	msdc_enable_sdio_irq(host->mmc, 0);
+	host->sdio_irq_ts = ktime_get_ns();
+	irq_wake_thread(host->irq, host);
+}
+
+static irqreturn_t msdc_irq_thread(int irq, void *dev_id)
+{
+	struct msdc_host *host = (struct msdc_host *) dev_id;
+
+	msdc_run_sdio_irqs(host);
+	return IRQ_HANDLED;
+}
+
+static irqreturn_t sdio_eint_hardirq(int irq, void *dev_id)
+{
+	struct msdc_host *host = (struct msdc_host *)dev_id;
+
+	host->sdio_irq_ts = ktime_get_ns();
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t sdio_eint_irq(int irq, void *dev_id)
 {
 	struct msdc_host *host = (struct msdc_host *)dev_id;
 
-	mmc_signal_sdio_irq(host->mmc);
+	if (!(host->mmc->caps2 & MMC_CAP2_SDIO_IRQ_NOTHREAD)) {
+		mmc_signal_sdio_irq(host->mmc);
+		return IRQ_HANDLED;
+	}
 
+	msdc_enable_sdio_irq(host->mmc, 0);
+	msdc_run_sdio_irqs(host);
 	return IRQ_HANDLED;
 }
 
@@ -3966,7 +4577,7 @@ static int request_dat1_eint_irq(struct msdc_host *host)
 	if (irq >= 0) {
 		irq_set_status_flags(irq, IRQ_NOAUTOEN);
 		ret = devm_request_threaded_irq(host->dev, irq,
-				NULL, sdio_eint_irq,
+				sdio_eint_hardirq, sdio_eint_irq,
 				IRQF_TRIGGER_LOW | IRQF_ONESHOT,
 				"sdio-eint", host);
 	} else {
@@ -4008,6 +4619,115 @@ void sdio_set_card_clkpd(int on, struct sdio_func *func)
 }
 EXPORT_SYMBOL(sdio_set_card_clkpd);
 
+#ifdef CONFIG_DEBUG_FS
+static const char * const msdc_size_names[MSDC_SIZE_CLASSES] = {
+	"cmd", "<=4", "<=8", "<=16", "<=32", "<=64", "<=512", "<=4k", ">4k",
+};
+
+static int msdc_xfer_lat_show(struct seq_file *m, void *v)
+{
+	struct msdc_host *host = m->private;
+	int i, j;
+
+	seq_printf(m, "pio: %u dma: %u\n", host->pio_cnt, host->dma_cnt);
+	seq_puts(m, "size \\ us");
+	for (j = 0; j < MSDC_LAT_BUCKETS - 1; j++)
+		seq_printf(m, " %7lu", 1UL << j);
+	seq_puts(m, "    more\n");
+	for (i = 0; i < MSDC_SIZE_CLASSES; i++) {
+		seq_printf(m, "%-9s", msdc_size_names[i]);
+		for (j = 0; j < MSDC_LAT_BUCKETS; j++)
+			seq_printf(m, " %7u", host->lat_hist[i][j]);
+		seq_puts(m, "\n");
+	}
+	return 0;
+}
+
+static int msdc_xfer_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msdc_xfer_lat_show, inode->i_private);
+}
+
+static const struct file_operations msdc_xfer_lat_fops = {
+	.open		= msdc_xfer_lat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int msdc_sdio_irq_lat_show(struct seq_file *m, void *v)
+{
+	struct msdc_host *host = m->private;
+	int i;
+
+	seq_printf(m, "runs: %u polled: %u\n", host->sdio_irq_runs,
+		   host->sdio_irq_polled);
+	for (i = 0; i < MSDC_LAT_BUCKETS - 1; i++)
+		seq_printf(m, "<%7luus: %u\n", 1UL << i, host->sdio_irq_lat[i]);
+	seq_printf(m, ">=%6luus: %u\n", 1UL << (MSDC_LAT_BUCKETS - 2),
+		   host->sdio_irq_lat[i]);
+	return 0;
+}
+
+static int msdc_sdio_irq_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msdc_sdio_irq_lat_show, inode->i_private);
+}
+
+static const struct file_operations msdc_sdio_irq_lat_fops = {
+	.open		= msdc_sdio_irq_lat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int msdc_autok_stats_show(struct seq_file *m, void *v)
+{
+	struct msdc_host *host = m->private;
+
+	seq_printf(m, "reuse: %u avg %llu us\n", host->autok_reuse_cnt,
+		   host->autok_reuse_cnt ?
+		   div_u64(host->autok_reuse_us, host->autok_reuse_cnt) : 0);
+	seq_printf(m, "full: %u avg %llu us\n", host->autok_full_cnt,
+		   host->autok_full_cnt ?
+		   div_u64(host->autok_full_us, host->autok_full_cnt) : 0);
+	seq_printf(m, "check failed: %u\n", host->autok_check_fail);
+	return 0;
+}
+
+static int msdc_autok_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, msdc_autok_stats_show, inode->i_private);
+}
+
+static const struct file_operations msdc_autok_stats_fops = {
+	.open		= msdc_autok_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void msdc_init_debugfs(struct msdc_host *host)
+{
+	struct dentry *root = host->mmc->debugfs_root;
+
+	if (!root)
+		return;
+	debugfs_create_u32("pio_thresh", S_IRUGO | S_IWUSR, root,
+			   &host->pio_thresh);
+	debugfs_create_file("xfer_latency", S_IRUGO, root, host,
+			    &msdc_xfer_lat_fops);
+	debugfs_create_u32("sdio_irq_poll_us", S_IRUGO | S_IWUSR, root,
+			   &host->sdio_irq_poll_us);
+	debugfs_create_file("sdio_irq_latency", S_IRUGO, root, host,
+			    &msdc_sdio_irq_lat_fops);
+	debugfs_create_file("autok_stats", S_IRUGO, root, host,
+			    &msdc_autok_stats_fops);
+}
+#else
+static inline void msdc_init_debugfs(struct msdc_host *host) {}
+#endif
+
 static int msdc_drv_probe(struct platform_device *pdev)
 {
 	struct mmc_host *mmc;
@@ -4030,8 +4750,13 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	if (ret)
 		goto host_free;
 
+	if (mmc->caps & MMC_CAP_SDIO_IRQ)
+		mmc->caps2 |= MMC_CAP2_SDIO_IRQ_NOTHREAD;
+
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	host->base = devm_ioremap_resource(&pdev->dev, res);
+	if (res)
+		host->autok_slot = lower_32_bits(res->start);
 	if (IS_ERR(host->base)) {
 		ret = PTR_ERR(host->base);
 		goto host_free;
@@ -4147,6 +4872,8 @@ static int msdc_drv_probe(struct platform_device *pdev)
 
 	host->timeout_clks = 3 * 1048576;
 	host->irq_thread_alive = false;
+	host->pio_thresh = MSDC_PIO_THRESH;
+	host->sdio_irq_poll_us = MSDC_SDIO_IRQ_POLL_US;
 	host->dma.gpd = dma_alloc_coherent(&pdev->dev,
 				2 * sizeof(struct mt_gpdma_desc),
 				&host->dma.gpd_addr, GFP_KERNEL);
@@ -4183,8 +4910,12 @@ static int msdc_drv_probe(struct platform_device *pdev)
 
 	msdc_init_hw(host);
 
-	ret = devm_request_irq(&pdev->dev, host->irq, msdc_irq,
-		IRQF_TRIGGER_LOW | IRQF_ONESHOT, pdev->name, host);
+	/*
+	 * The thread runs the card irq handlers, which issue requests that
+	 * complete in msdc_irq, so the line must not stay masked meanwhile.
+	 */
+	ret = devm_request_threaded_irq(&pdev->dev, host->irq, msdc_irq,
+		msdc_irq_thread, IRQF_TRIGGER_LOW, pdev->name, host);
 	if (ret)
 		goto release;
 
@@ -4206,6 +4937,7 @@ static int msdc_drv_probe(struct platform_device *pdev)
 	if (ret)
 		goto end;
 
+	msdc_init_debugfs(host);
 	return 0;
 end:
 	pm_runtime_disable(host->dev);
@@ -4295,7 +5027,13 @@ static int msdc_runtime_suspend(struct device *dev)
 	unsigned long flags;
 
 	msdc_save_reg(host);
-	disable_irq(host->irq);
+	/*
+	 * Only wait for the hard handler: msdc_irq_thread may be blocked
+	 * on resuming us in mmc_claim_host(), and it touches no register
+	 * before that.
+	 */
+	disable_irq_nosync(host->irq);
+	synchronize_hardirq(host->irq);
 	msdc_gate_clock(host);
 	pinctrl_select_state(host->pinctrl, host->pins_dat1_eint);
 	spin_lock_irqsave(&host->irqlock, flags);
@@ -13,6 +13,7 @@
  */
 
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/interrupt.h>
@@ -24,6 +25,8 @@
 #include <linux/platform_device.h>
 #include <linux/platform_data/spi-mt65xx.h>
 #include <linux/pm_runtime.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/spi/spi.h>
 
 #define SPI_CFG0_REG                      0x0000
@@ -75,6 +78,7 @@
 
 #define MTK_SPI_MAX_FIFO_SIZE 32
 #define MTK_SPI_PACKET_SIZE 1024
+#define MTK_SPI_PACKET_LOOP 256
 
 struct mtk_spi_compatible {
 	bool need_pad_sel;
@@ -82,6 +86,15 @@ struct mtk_spi_compatible {
 	bool must_tx;
 };
 
+struct mtk_spi_stats {
+	u64 msgs;
+	u64 irqs;
+	u64 msg_ns, msg_max_ns;
+	u64 cpu_ns, cpu_max_ns;
+	u64 gaps;
+	u64 gap_ns, gap_max_ns;
+};
+
 struct mtk_spi {
 	void __iomem *base;
 	u32 state;
@@ -90,9 +103,21 @@ struct mtk_spi {
 	struct clk *parent_clk, *sel_clk, *spi_clk;
 	struct spi_transfer *cur_transfer;
 	u32 xfer_len;
+	u32 packet_size;
 	struct scatterlist *tx_sgl, *rx_sgl;
 	u32 tx_sgl_len, rx_sgl_len;
+	dma_addr_t tx_dma, rx_dma;
+	/* single segments of is_dma_mapped messages */
+	struct scatterlist tx_premap, rx_premap;
 	const struct mtk_spi_compatible *dev_comp;
+
+	/* current message, irq_ns is only updated by the interrupt handler */
+	ktime_t msg_start, msg_end;
+	u64 pump_ns, irq_ns;
+	struct mtk_spi_stats stats;
+	/* set from debugfs, the pump clears @stats before its next message */
+	bool stats_reset;
+	struct dentry *debugfs;
 #ifdef CONFIG_SND_SOC_MT8516_abc123_MACH
 	u32 spi_clk_hz;
 #endif
@@ -152,6 +177,23 @@ static int mtk_spi_prepare_message(struct spi_master *master,
 	struct spi_device *spi = msg->spi;
 	struct mtk_chip_config *chip_config = spi->controller_data;
 	struct mtk_spi *mdata = spi_master_get_devdata(master);
+	ktime_t now = ktime_get();
+
+	/* no transfer, hence no interrupt, is in flight between messages */
+	if (unlikely(READ_ONCE(mdata->stats_reset))) {
+		memset(&mdata->stats, 0, sizeof(mdata->stats));
+		WRITE_ONCE(mdata->stats_reset, false);
+	}
+
+	if (ktime_to_ns(mdata->msg_end)) {
+		u64 gap = ktime_to_ns(ktime_sub(now, mdata->msg_end));
+
+		mdata->stats.gaps++;
+		mdata->stats.gap_ns += gap;
+		mdata->stats.gap_max_ns = max(mdata->stats.gap_max_ns, gap);
+	}
+	mdata->msg_start = now;
+	mdata->irq_ns = 0;
 
 	cpha = spi->mode & SPI_CPHA ? 1 : 0;
 	cpol = spi->mode & SPI_CPOL ? 1 : 0;
@@ -201,6 +243,28 @@ static int mtk_spi_prepare_message(struct spi_master *master,
 		writel(mdata->pad_sel[spi->chip_select],
 		       mdata->base + SPI_PAD_SEL_REG);
 
+	mdata->pump_ns = ktime_to_ns(ktime_sub(ktime_get(), now));
+
+	return 0;
+}
+
+static int mtk_spi_unprepare_message(struct spi_master *master,
+				     struct spi_message *msg)
+{
+	struct mtk_spi *mdata = spi_master_get_devdata(master);
+	struct mtk_spi_stats *st = &mdata->stats;
+	u64 msg_ns, cpu_ns;
+
+	mdata->msg_end = ktime_get();
+	msg_ns = ktime_to_ns(ktime_sub(mdata->msg_end, mdata->msg_start));
+	cpu_ns = mdata->pump_ns + mdata->irq_ns;
+
+	st->msgs++;
+	st->msg_ns += msg_ns;
+	st->msg_max_ns = max(st->msg_max_ns, msg_ns);
+	st->cpu_ns += cpu_ns;
+	st->cpu_max_ns = max(st->cpu_max_ns, cpu_ns);
+
 	return 0;
 }
 
@@ -258,7 +322,7 @@ static void mtk_spi_setup_packet(struct spi_master *master)
 	u32 packet_size, packet_loop, reg_val;
 	struct mtk_spi *mdata = spi_master_get_devdata(master);
 
-	packet_size = min_t(u32, mdata->xfer_len, MTK_SPI_PACKET_SIZE);
+	packet_size = mdata->packet_size;
 	packet_loop = mdata->xfer_len / packet_size;
 
 	reg_val = readl(mdata->base + SPI_CFG1_REG);
@@ -281,55 +345,77 @@ static void mtk_spi_enable_transfer(struct spi_master *master)
 	writel(cmd, mdata->base + SPI_CMD_REG);
 }
 
-static int mtk_spi_get_mult_delta(u32 xfer_len)
+/*
+ * Picks the largest chunk of @len the engine can move without an interrupt,
+ * and a packet size that divides it. Odd lengths above MTK_SPI_PACKET_SIZE
+ * still go in one chunk when they split into at most MTK_SPI_PACKET_LOOP
+ * equal packets, otherwise the remainder is left for another chunk.
+ */
+static void mtk_spi_set_chunk(struct mtk_spi *mdata, u32 len)
 {
-	u32 mult_delta;
+	u32 size;
 
-	if (xfer_len > MTK_SPI_PACKET_SIZE)
-		mult_delta = xfer_len % MTK_SPI_PACKET_SIZE;
-	else
-		mult_delta = 0;
+	if (len <= MTK_SPI_PACKET_SIZE) {
+		mdata->xfer_len = len;
+		mdata->packet_size = len;
+		return;
+	}
 
-	return mult_delta;
+	len = min_t(u32, len, MTK_SPI_PACKET_SIZE * MTK_SPI_PACKET_LOOP);
+	for (size = MTK_SPI_PACKET_SIZE;
+	     size >= DIV_ROUND_UP(len, MTK_SPI_PACKET_LOOP); size--) {
+		if (len % size == 0) {
+			mdata->xfer_len = len;
+			mdata->packet_size = size;
+			return;
+		}
+	}
+
+	mdata->xfer_len = len - len % MTK_SPI_PACKET_SIZE;
+	mdata->packet_size = MTK_SPI_PACKET_SIZE;
 }
 
 static void mtk_spi_update_mdata_len(struct spi_master *master)
 {
-	int mult_delta;
 	struct mtk_spi *mdata = spi_master_get_devdata(master);
+	u32 len;
 
-	if (mdata->tx_sgl_len && mdata->rx_sgl_len) {
-		if (mdata->tx_sgl_len > mdata->rx_sgl_len) {
-			mult_delta = mtk_spi_get_mult_delta(mdata->rx_sgl_len);
-			mdata->xfer_len = mdata->rx_sgl_len - mult_delta;
-			mdata->rx_sgl_len = mult_delta;
-			mdata->tx_sgl_len -= mdata->xfer_len;
-		} else {
-			mult_delta = mtk_spi_get_mult_delta(mdata->tx_sgl_len);
-			mdata->xfer_len = mdata->tx_sgl_len - mult_delta;
-			mdata->tx_sgl_len = mult_delta;
-			mdata->rx_sgl_len -= mdata->xfer_len;
-		}
-	} else if (mdata->tx_sgl_len) {
-		mult_delta = mtk_spi_get_mult_delta(mdata->tx_sgl_len);
-		mdata->xfer_len = mdata->tx_sgl_len - mult_delta;
-		mdata->tx_sgl_len = mult_delta;
-	} else if (mdata->rx_sgl_len) {
-		mult_delta = mtk_spi_get_mult_delta(mdata->rx_sgl_len);
-		mdata->xfer_len = mdata->rx_sgl_len - mult_delta;
-		mdata->rx_sgl_len = mult_delta;
-	}
+	if (mdata->tx_sgl_len && mdata->rx_sgl_len)
+		len = min(mdata->tx_sgl_len, mdata->rx_sgl_len);
+	else
+		len = mdata->tx_sgl_len ? mdata->tx_sgl_len : mdata->rx_sgl_len;
+
+	mtk_spi_set_chunk(mdata, len);
+
+	if (mdata->tx_sgl_len)
+		mdata->tx_sgl_len -= mdata->xfer_len;
+	if (mdata->rx_sgl_len)
+		mdata->rx_sgl_len -= mdata->xfer_len;
 }
 
-static void mtk_spi_setup_dma_addr(struct spi_master *master,
-				   struct spi_transfer *xfer)
+static void mtk_spi_setup_dma_addr(struct spi_master *master)
 {
 	struct mtk_spi *mdata = spi_master_get_devdata(master);
 
 	if (mdata->tx_sgl)
-		writel(xfer->tx_dma, mdata->base + SPI_TX_SRC_REG);
+		writel(mdata->tx_dma, mdata->base + SPI_TX_SRC_REG);
 	if (mdata->rx_sgl)
-		writel(xfer->rx_dma, mdata->base + SPI_RX_DST_REG);
+		writel(mdata->rx_dma, mdata->base + SPI_RX_DST_REG);
+}
+
+/*
+ * is_dma_mapped messages carry one contiguous buffer per direction, wrap
+ * it so that it walks like a mapped sg_table. The transfer is left as is
+ * and can be queued again.
+ */
+static struct scatterlist *mtk_spi_premap_sg(struct scatterlist *sg,
+					     dma_addr_t addr, u32 len)
+{
+	sg_init_table(sg, 1);
+	sg_dma_address(sg) = addr;
+	sg_dma_len(sg) = len;
+
+	return sg;
 }
 
 static int mtk_spi_fifo_transfer(struct spi_master *master,
@@ -342,6 +428,7 @@ static int mtk_spi_fifo_transfer(struct spi_master *master,
 
 	mdata->cur_transfer = xfer;
 	mdata->xfer_len = xfer->len;
+	mdata->packet_size = xfer->len;
 	mtk_spi_prepare_transfer(master, xfer);
 	mtk_spi_setup_packet(master);
 
@@ -382,23 +469,34 @@ static int mtk_spi_dma_transfer(struct spi_master *master,
 		cmd |= SPI_CMD_RX_DMA;
 	writel(cmd, mdata->base + SPI_CMD_REG);
 
-	if (xfer->tx_buf)
-		mdata->tx_sgl = xfer->tx_sg.sgl;
-	if (xfer->rx_buf)
-		mdata->rx_sgl = xfer->rx_sg.sgl;
+	if (master->cur_msg->is_dma_mapped) {
+		if (xfer->tx_buf)
+			mdata->tx_sgl = mtk_spi_premap_sg(&mdata->tx_premap,
+							  xfer->tx_dma,
+							  xfer->len);
+		if (xfer->rx_buf)
+			mdata->rx_sgl = mtk_spi_premap_sg(&mdata->rx_premap,
+							  xfer->rx_dma,
+							  xfer->len);
+	} else {
+		if (xfer->tx_buf)
+			mdata->tx_sgl = xfer->tx_sg.sgl;
+		if (xfer->rx_buf)
+			mdata->rx_sgl = xfer->rx_sg.sgl;
+	}
 
 	if (mdata->tx_sgl) {
-		xfer->tx_dma = sg_dma_address(mdata->tx_sgl);
+		mdata->tx_dma = sg_dma_address(mdata->tx_sgl);
 		mdata->tx_sgl_len = sg_dma_len(mdata->tx_sgl);
 	}
 	if (mdata->rx_sgl) {
-		xfer->rx_dma = sg_dma_address(mdata->rx_sgl);
+		mdata->rx_dma = sg_dma_address(mdata->rx_sgl);
 		mdata->rx_sgl_len = sg_dma_len(mdata->rx_sgl);
 	}
 
 	mtk_spi_update_mdata_len(master);
 	mtk_spi_setup_packet(master);
-	mtk_spi_setup_dma_addr(master, xfer);
+	mtk_spi_setup_dma_addr(master);
 	mtk_spi_enable_transfer(master);
 
 	return 1;
@@ -408,10 +506,18 @@ static int mtk_spi_transfer_one(struct spi_master *master,
 				struct spi_device *spi,
 				struct spi_transfer *xfer)
 {
+	struct mtk_spi *mdata = spi_master_get_devdata(master);
+	ktime_t start = ktime_get();
+	int ret;
+
 	if (master->can_dma(master, spi, xfer))
-		return mtk_spi_dma_transfer(master, spi, xfer);
+		ret = mtk_spi_dma_transfer(master, spi, xfer);
 	else
-		return mtk_spi_fifo_transfer(master, spi, xfer);
+		ret = mtk_spi_fifo_transfer(master, spi, xfer);
+
+	mdata->pump_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return ret;
 }
 
 static bool mtk_spi_can_dma(struct spi_master *master,
@@ -431,13 +537,27 @@ static int mtk_spi_setup(struct spi_device *spi)
 	if (mdata->dev_comp->need_pad_sel && gpio_is_valid(spi->cs_gpio))
 		gpio_direction_output(spi->cs_gpio, !(spi->mode & SPI_CS_HIGH));
 
+	/*
+	 * Streaming devices flagged in the device tree get the message pump
+	 * at realtime priority, as the core does for spi_master->rt.
+	 */
+	if (!spi->master->rt && spi->dev.of_node &&
+	    of_property_read_bool(spi->dev.of_node, "mediatek,rt-pump") &&
+	    spi->master->kworker_task) {
+		struct sched_param param = { .sched_priority = MAX_RT_PRIO - 1 };
+
+		dev_info(&spi->dev, "running message pump with realtime priority\n");
+		sched_setscheduler(spi->master->kworker_task, SCHED_FIFO,
+				   &param);
+		spi->master->rt = true;
+	}
+
 	return 0;
 }
 
-static irqreturn_t mtk_spi_interrupt(int irq, void *dev_id)
+static void mtk_spi_handle_irq(struct spi_master *master)
 {
 	u32 cmd, reg_val, cnt, remainder;
-	struct spi_master *master = dev_id;
 	struct mtk_spi *mdata = spi_master_get_devdata(master);
 	struct spi_transfer *trans = mdata->cur_transfer;
 
@@ -460,25 +580,25 @@ static irqreturn_t mtk_spi_interrupt(int irq, void *dev_id)
 			}
 		}
 		spi_finalize_current_transfer(master);
-		return IRQ_HANDLED;
+		return;
 	}
 
 	if (mdata->tx_sgl)
-		trans->tx_dma += mdata->xfer_len;
+		mdata->tx_dma += mdata->xfer_len;
 	if (mdata->rx_sgl)
-		trans->rx_dma += mdata->xfer_len;
+		mdata->rx_dma += mdata->xfer_len;
 
 	if (mdata->tx_sgl && (mdata->tx_sgl_len == 0)) {
 		mdata->tx_sgl = sg_next(mdata->tx_sgl);
 		if (mdata->tx_sgl) {
-			trans->tx_dma = sg_dma_address(mdata->tx_sgl);
+			mdata->tx_dma = sg_dma_address(mdata->tx_sgl);
 			mdata->tx_sgl_len = sg_dma_len(mdata->tx_sgl);
 		}
 	}
 	if (mdata->rx_sgl && (mdata->rx_sgl_len == 0)) {
 		mdata->rx_sgl = sg_next(mdata->rx_sgl);
 		if (mdata->rx_sgl) {
-			trans->rx_dma = sg_dma_address(mdata->rx_sgl);
+			mdata->rx_dma = sg_dma_address(mdata->rx_sgl);
 			mdata->rx_sgl_len = sg_dma_len(mdata->rx_sgl);
 		}
 	}
@@ -491,17 +611,91 @@ static irqreturn_t mtk_spi_interrupt(int irq, void *dev_id)
 		writel(cmd, mdata->base + SPI_CMD_REG);
 
 		spi_finalize_current_transfer(master);
-		return IRQ_HANDLED;
+		return;
 	}
 
 	mtk_spi_update_mdata_len(master);
 	mtk_spi_setup_packet(master);
-	mtk_spi_setup_dma_addr(master, trans);
+	mtk_spi_setup_dma_addr(master);
 	mtk_spi_enable_transfer(master);
+}
+
+static irqreturn_t mtk_spi_interrupt(int irq, void *dev_id)
+{
+	struct spi_master *master = dev_id;
+	struct mtk_spi *mdata = spi_master_get_devdata(master);
+	ktime_t start = ktime_get();
+
+	mtk_spi_handle_irq(master);
+
+	mdata->stats.irqs++;
+	mdata->irq_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 
 	return IRQ_HANDLED;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int mtk_spi_stats_show(struct seq_file *m, void *v)
+{
+	struct mtk_spi *mdata = m->private;
+	struct mtk_spi_stats *st = &mdata->stats;
+	u64 msgs = st->msgs ? st->msgs : 1;
+	u64 gaps = st->gaps ? st->gaps : 1;
+
+	seq_printf(m, "msgs: %llu irqs: %llu\n", st->msgs, st->irqs);
+	seq_printf(m, "msg: avg %llu max %llu us\n",
+		   div_u64(st->msg_ns, msgs) / NSEC_PER_USEC,
+		   div_u64(st->msg_max_ns, NSEC_PER_USEC));
+	seq_printf(m, "cpu: avg %llu max %llu us\n",
+		   div_u64(st->cpu_ns, msgs) / NSEC_PER_USEC,
+		   div_u64(st->cpu_max_ns, NSEC_PER_USEC));
+	seq_printf(m, "gap: avg %llu max %llu us\n",
+		   div_u64(st->gap_ns, gaps) / NSEC_PER_USEC,
+		   div_u64(st->gap_max_ns, NSEC_PER_USEC));
+	return 0;
+}
+
+static int mtk_spi_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtk_spi_stats_show, inode->i_private);
+}
+
+/*
+ * Any write clears the counters, e.g. once a stream is running. The pump
+ * and the interrupt handler update them locklessly, so the clearing is
+ * left to the pump, as it starts the next message.
+ */
+static ssize_t mtk_spi_stats_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct mtk_spi *mdata = file_inode(file)->i_private;
+
+	WRITE_ONCE(mdata->stats_reset, true);
+	return count;
+}
+
+static const struct file_operations mtk_spi_stats_fops = {
+	.open		= mtk_spi_stats_open,
+	.read		= seq_read,
+	.write		= mtk_spi_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void mtk_spi_init_debugfs(struct platform_device *pdev,
+				 struct mtk_spi *mdata)
+{
+	mdata->debugfs = debugfs_create_dir(dev_name(&pdev->dev), NULL);
+	if (IS_ERR_OR_NULL(mdata->debugfs))
+		return;
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, mdata->debugfs, mdata,
+			    &mtk_spi_stats_fops);
+}
+#else
+static inline void mtk_spi_init_debugfs(struct platform_device *pdev,
+					struct mtk_spi *mdata) {}
+#endif
+
 static int mtk_spi_probe(struct platform_device *pdev)
 {
 	struct spi_master *master;
@@ -522,6 +716,7 @@ static int mtk_spi_probe(struct platform_device *pdev)
 
 	master->set_cs = mtk_spi_set_cs;
 	master->prepare_message = mtk_spi_prepare_message;
+	master->unprepare_message = mtk_spi_unprepare_message;
 	master->transfer_one = mtk_spi_transfer_one;
 	master->can_dma = mtk_spi_can_dma;
 	master->setup = mtk_spi_setup;
@@ -537,6 +732,8 @@ static int mtk_spi_probe(struct platform_device *pdev)
 	mdata->dev_comp = of_id->data;
 	if (mdata->dev_comp->must_tx)
 		master->flags = SPI_MASTER_MUST_TX;
+	else
+		master->flags = SPI_MASTER_DMA_PREMAPPED;
 
 	if (mdata->dev_comp->need_pad_sel) {
 		mdata->pad_num = of_property_count_u32_elems(
@@ -680,6 +877,8 @@ static int mtk_spi_probe(struct platform_device *pdev)
 		}
 	}
 
+	mtk_spi_init_debugfs(pdev, mdata);
+
 	return 0;
 
 err_disable_runtime_pm:
@@ -696,6 +895,7 @@ static int mtk_spi_remove(struct platform_device *pdev)
 	struct mtk_spi *mdata = spi_master_get_devdata(master);
 
 	pm_runtime_disable(&pdev->dev);
+	debugfs_remove_recursive(mdata->debugfs);
 
 	mtk_spi_reset(mdata);
 	spi_master_put(master);
@@ -758,6 +758,10 @@ static int __spi_map_msg(struct spi_master *master, struct spi_message *msg)
 	if (!master->can_dma)
 		return 0;
 
+	/* the caller owns the mapping and reuses it across messages */
+	if (msg->is_dma_mapped && (master->flags & SPI_MASTER_DMA_PREMAPPED))
+		return 0;
+
 	if (master->dma_tx)
 		tx_dev = master->dma_tx->device->dev;
 	else
@@ -1082,6 +1082,8 @@ static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 {
 	struct ion_vma_list *vma_list;
 	int pages = PAGE_ALIGN(buffer->size) / PAGE_SIZE;
+	struct page *run = NULL;
+	size_t run_size = 0;
 	int i;
 
 	pr_debug("%s: syncing for device %s\n", __func__,
@@ -1094,12 +1096,25 @@ static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 	for (i = 0; i < pages; i++) {
 		struct page *page = buffer->pages[i];
 
-		if (ion_buffer_page_is_dirty(page))
-			ion_pages_sync_for_device(dev, ion_buffer_page(page),
-							PAGE_SIZE, dir);
+		if (!ion_buffer_page_is_dirty(page))
+			continue;
 
+		/* sync physically contiguous dirty pages in one go */
+		page = ion_buffer_page(page);
+		if (run && page == run + (run_size >> PAGE_SHIFT)) {
+			run_size += PAGE_SIZE;
+		} else {
+			if (run)
+				ion_pages_sync_for_device(dev, run, run_size, dir);
+			run = page;
+			run_size = PAGE_SIZE;
+		}
+		buffer->sync_dev_bytes += PAGE_SIZE;
 		ion_buffer_page_clean(buffer->pages + i);
 	}
+	if (run)
+		ion_pages_sync_for_device(dev, run, run_size, dir);
+
 	list_for_each_entry(vma_list, &buffer->vmas, list) {
 		struct vm_area_struct *vma = vma_list->vma;
 
@@ -1109,9 +1124,34 @@ static void ion_buffer_sync_for_device(struct ion_buffer *buffer,
 	mutex_unlock(&buffer->lock);
 }
 
+/* pages mapped per fault, around and including the faulting one */
+#define ION_FAULT_AROUND_PAGES	16
+
+/*
+ * Maps page @i of @buffer into @vma if its pfn is @pfn, returns false at
+ * the first discontiguity. Called with buffer->lock held.
+ */
+static bool ion_vm_fault_around(struct ion_buffer *buffer,
+				struct vm_area_struct *vma, unsigned long i,
+				unsigned long pfn)
+{
+	struct page *page = ion_buffer_page(buffer->pages[i]);
+	unsigned long addr = vma->vm_start + ((i - vma->vm_pgoff) << PAGE_SHIFT);
+
+	if (page_to_pfn(page) != pfn)
+		return false;
+	if (!vm_insert_pfn(vma, addr, pfn)) {
+		ion_buffer_page_dirty(buffer->pages + i);
+		buffer->nr_fault_pages++;
+	}
+	return true;
+}
+
 static int ion_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 {
 	struct ion_buffer *buffer = vma->vm_private_data;
+	unsigned long vma_pages = (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
+	unsigned long first, last, i;
 	unsigned long pfn;
 	int ret;
 
@@ -1121,12 +1161,32 @@ static int ion_vm_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 
 	pfn = page_to_pfn(ion_buffer_page(buffer->pages[vmf->pgoff]));
 	ret = vm_insert_pfn(vma, (unsigned long)vmf->virtual_address, pfn);
-	mutex_unlock(&buffer->lock);
 	if (ret) {
+		mutex_unlock(&buffer->lock);
 		IONMSG("%s vm insert pfn failed, vma = 0x%pK, addr = 0x%pK, pfn = %lu.\n",
 				__func__, vma, vmf->virtual_address, pfn);
 		return VM_FAULT_ERROR;
 	}
+	buffer->nr_faults++;
+	buffer->nr_fault_pages++;
+
+	/*
+	 * Map the aligned window around the fault, going out from the
+	 * faulting page in both directions and stopping at the first page
+	 * that is not physically contiguous with it, i.e. at the end of its
+	 * sg chunk. Pages already mapped here are skipped by vm_insert_pfn.
+	 */
+	first = max(vmf->pgoff & ~(ION_FAULT_AROUND_PAGES - 1UL), vma->vm_pgoff);
+	last = min3(first + ION_FAULT_AROUND_PAGES,
+		    vma->vm_pgoff + vma_pages,
+		    (unsigned long)PAGE_ALIGN(buffer->size) >> PAGE_SHIFT);
+	for (i = vmf->pgoff + 1; i < last; i++)
+		if (!ion_vm_fault_around(buffer, vma, i, pfn + i - vmf->pgoff))
+			break;
+	for (i = vmf->pgoff; i-- > first; )
+		if (!ion_vm_fault_around(buffer, vma, i, pfn + i - vmf->pgoff))
+			break;
+	mutex_unlock(&buffer->lock);
 
 	return VM_FAULT_NOPAGE;
 }
@@ -1236,18 +1296,38 @@ static int ion_dma_buf_begin_cpu_access(struct dma_buf *dmabuf, size_t start,
 					enum dma_data_direction direction)
 {
 	struct ion_buffer *buffer = dmabuf->priv;
+	struct ion_heap *heap = buffer->heap;
 	void *vaddr;
+	int ret = 0;
 
-	if (!buffer->heap->ops->map_kernel) {
+	if (!heap->ops->map_kernel) {
 		pr_err("%s: map kernel is not implemented by this heap.\n",
 		       __func__);
 		return -ENODEV;
 	}
 
+	if (start >= buffer->size)
+		return -EINVAL;
+	len = min(len, buffer->size - start);
+
 	mutex_lock(&buffer->lock);
 	vaddr = ion_buffer_kmap_get(buffer);
+	if (IS_ERR(vaddr)) {
+		mutex_unlock(&buffer->lock);
+		return PTR_ERR(vaddr);
+	}
+
+	if (ion_buffer_cached(buffer) && heap->ops->begin_cpu_access) {
+		ret = heap->ops->begin_cpu_access(heap, buffer, start, len,
+						  direction);
+		if (ret)
+			ion_buffer_kmap_put(buffer);
+		else
+			buffer->sync_cpu_bytes += len;
+	}
 	mutex_unlock(&buffer->lock);
-	return PTR_ERR_OR_ZERO(vaddr);
+
+	return ret;
 }
 
 static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
@@ -1255,8 +1335,16 @@ static void ion_dma_buf_end_cpu_access(struct dma_buf *dmabuf, size_t start,
 				       enum dma_data_direction direction)
 {
 	struct ion_buffer *buffer = dmabuf->priv;
+	struct ion_heap *heap = buffer->heap;
 
 	mutex_lock(&buffer->lock);
+	if (ion_buffer_cached(buffer) && heap->ops->end_cpu_access &&
+	    start < buffer->size) {
+		len = min(len, buffer->size - start);
+		if (!heap->ops->end_cpu_access(heap, buffer, start, len,
+					       direction))
+			buffer->sync_dev_bytes += len;
+	}
 	ion_buffer_kmap_put(buffer);
 	mutex_unlock(&buffer->lock);
 }
@@ -1711,6 +1799,42 @@ static int ion_debug_heap_show(struct seq_file *s, void *unused)
 	return 0;
 }
 
+static int ion_debug_buffer_stats_show(struct seq_file *s, void *unused)
+{
+	struct ion_device *dev = s->private;
+	struct rb_node *n;
+
+	seq_printf(s, "%16.16s %8.8s %16.16s %10.10s %12.12s %12.12s %8.8s %8.8s\n",
+		   "task", "pid", "heap", "size", "sync_dev", "sync_cpu",
+		   "faults", "fpages");
+	mutex_lock(&dev->buffer_lock);
+	for (n = rb_first(&dev->buffers); n; n = rb_next(n)) {
+		struct ion_buffer *buffer = rb_entry(n, struct ion_buffer,
+						     node);
+
+		seq_printf(s, "%16.16s %8u %16.16s %10zu %12llu %12llu %8u %8u\n",
+			   buffer->task_comm, buffer->pid, buffer->heap->name,
+			   buffer->size, buffer->sync_dev_bytes,
+			   buffer->sync_cpu_bytes, buffer->nr_faults,
+			   buffer->nr_fault_pages);
+	}
+	mutex_unlock(&dev->buffer_lock);
+
+	return 0;
+}
+
+static int ion_debug_buffer_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_debug_buffer_stats_show, inode->i_private);
+}
+
+static const struct file_operations debug_buffer_stats_fops = {
+	.open = ion_debug_buffer_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int ion_debug_heap_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, ion_debug_heap_show, inode->i_private);
@@ -1902,6 +2026,9 @@ struct ion_device *ion_device_create(long (*custom_ioctl)
 						idev->debug_root);
 	if (!idev->clients_debug_root)
 		pr_err("ion: failed to create debugfs clients directory.\n");
+	if (!debugfs_create_file("buffer_stats", 0444, idev->debug_root, idev,
+				 &debug_buffer_stats_fops))
+		pr_err("ion: failed to create debugfs buffer_stats.\n");
 
 debugfs_done:
 
@@ -174,6 +174,11 @@ struct ion_buffer {
 	int handle_count;
 	char task_comm[TASK_COMM_LEN];
 	pid_t pid;
+	/* cache maintenance and user fault counters, under lock */
+	u64 sync_dev_bytes;
+	u64 sync_cpu_bytes;
+	unsigned int nr_faults;
+	unsigned int nr_fault_pages;
 };
 void ion_buffer_destroy(struct ion_buffer *buffer);
 
@@ -188,6 +193,10 @@ void ion_buffer_destroy(struct ion_buffer *buffer);
  * @map_kernel		map memory to the kernel
  * @unmap_kernel	unmap memory to the kernel
  * @map_user		map memory to userspace
+ * @begin_cpu_access	optional, make [offset, offset + len) of a cached
+ *			buffer coherent for the cpu, called with buffer->lock
+ * @end_cpu_access	optional, hand [offset, offset + len) back to the
+ *			device, called with buffer->lock
  *
  * allocate, phys, and map_user return 0 on success, -errno on error.
  * map_dma and map_kernel return pointer on success, ERR_PTR on
@@ -210,6 +219,12 @@ struct ion_heap_ops {
 	void (*unmap_kernel)(struct ion_heap *heap, struct ion_buffer *buffer);
 	int (*map_user)(struct ion_heap *mapper, struct ion_buffer *buffer,
 			struct vm_area_struct *vma);
+	int (*begin_cpu_access)(struct ion_heap *heap, struct ion_buffer *buffer,
+				size_t offset, size_t len,
+				enum dma_data_direction dir);
+	int (*end_cpu_access)(struct ion_heap *heap, struct ion_buffer *buffer,
+			      size_t offset, size_t len,
+			      enum dma_data_direction dir);
 	int (*shrink)(struct ion_heap *heap, gfp_t gfp_mask, int nr_to_scan);
 	void (*add_freelist)(struct ion_buffer *buffer);
 	int (*page_pool_total)(struct ion_heap *heap);
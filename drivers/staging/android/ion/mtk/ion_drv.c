@@ -20,6 +20,7 @@
 #include <linux/slab.h>
 #include <asm/cacheflush.h>
 #include <linux/mm.h>
+#include <linux/highmem.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/export.h>
@@ -347,6 +348,58 @@ void ion_dma_unmap_area_va(void *start, size_t size, enum ION_DMA_DIR dir)
 		dmac_unmap_area(start, size, DMA_BIDIRECTIONAL);
 }
 
+static void ion_drv_sync_chunk(struct page *page, size_t offset, size_t len,
+			       enum dma_data_direction dir, bool for_cpu)
+{
+	page += offset >> PAGE_SHIFT;
+	offset &= ~PAGE_MASK;
+
+	while (len) {
+		size_t size = PageHighMem(page) ?
+			      min_t(size_t, len, PAGE_SIZE - offset) : len;
+		void *va = PageHighMem(page) ? kmap_atomic(page) :
+					       page_address(page);
+
+		if (for_cpu)
+			dmac_unmap_area(va + offset, size, dir);
+		else
+			dmac_map_area(va + offset, size, dir);
+
+		if (PageHighMem(page))
+			kunmap_atomic(va);
+		page += (offset + size) >> PAGE_SHIFT;
+		offset = 0;
+		len -= size;
+	}
+}
+
+/*
+ * ion_drv_sync_range - cache maintenance for [offset, offset + len) of a
+ * page-backed buffer, one linear-map range per sg chunk. @for_cpu
+ * invalidates ahead of cpu access, otherwise dirty lines are written back
+ * for the device.
+ */
+void ion_drv_sync_range(struct ion_buffer *buffer, size_t offset, size_t len,
+			enum dma_data_direction dir, bool for_cpu)
+{
+	struct sg_table *table = buffer->sg_table;
+	struct scatterlist *sg;
+	size_t end = offset + len, pos = 0;
+	int i;
+
+	for_each_sg(table->sgl, sg, table->nents, i) {
+		size_t s = max(offset, pos);
+		size_t e = min(end, pos + sg->length);
+
+		if (pos >= end)
+			break;
+		if (s < e)
+			ion_drv_sync_chunk(sg_page(sg), sg->offset + s - pos,
+					   e - s, dir, for_cpu);
+		pos += sg->length;
+	}
+}
+
 void ion_cache_flush_all(void)
 {
 	mmprofile_log_ex(ion_mmp_events[PROFILE_DMA_FLUSH_ALL], MMPROFILE_FLAG_START, 1, 1);
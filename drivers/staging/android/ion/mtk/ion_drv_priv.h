@@ -36,6 +36,8 @@ static inline int ion_history_init(void)
 int ion_mm_heap_for_each_pool(int (*fn)(int high, int order, int cache, size_t size));
 struct ion_heap *ion_drv_get_heap(struct ion_device *dev, int heap_id, int need_lock);
 int ion_drv_create_heap(struct ion_platform_heap *heap_data);
+void ion_drv_sync_range(struct ion_buffer *buffer, size_t offset, size_t len,
+			enum dma_data_direction dir, bool for_cpu);
 
 #ifdef CONFIG_PM
 void shrink_ion_by_scenario(void);
@@ -461,6 +461,24 @@ int ion_mm_heap_pool_total(struct ion_heap *heap)
 	return total;
 }
 
+static int ion_mm_heap_begin_cpu_access(struct ion_heap *heap,
+					struct ion_buffer *buffer,
+					size_t offset, size_t len,
+					enum dma_data_direction dir)
+{
+	ion_drv_sync_range(buffer, offset, len, dir, true);
+	return 0;
+}
+
+static int ion_mm_heap_end_cpu_access(struct ion_heap *heap,
+				      struct ion_buffer *buffer,
+				      size_t offset, size_t len,
+				      enum dma_data_direction dir)
+{
+	ion_drv_sync_range(buffer, offset, len, dir, false);
+	return 0;
+}
+
 static struct ion_heap_ops system_heap_ops = {
 		.allocate = ion_mm_heap_allocate,
 		.free = ion_mm_heap_free,
@@ -472,6 +490,8 @@ static struct ion_heap_ops system_heap_ops = {
 		.phys = ion_mm_heap_phys,
 		.shrink = ion_mm_heap_shrink,
 		.page_pool_total = ion_mm_heap_pool_total,
+		.begin_cpu_access = ion_mm_heap_begin_cpu_access,
+		.end_cpu_access = ion_mm_heap_end_cpu_access,
 };
 
 static int ion_mm_heap_debug_show(struct ion_heap *heap, struct seq_file *s, void *unused)
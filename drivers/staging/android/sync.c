@@ -112,6 +112,16 @@ void sync_timeline_signal(struct sync_timeline *obj)
 
 	trace_sync_timeline(obj);
 
+	/*
+	 * Nobody is waiting on a pt of this timeline, so there is nothing
+	 * to signal. Pairs with the smp_mb() in
+	 * android_fence_enable_signaling(): either we see the pt on the
+	 * active list or the waiter sees the new timeline value.
+	 */
+	smp_mb();
+	if (list_empty(&obj->active_list_head))
+		return;
+
 	spin_lock_irqsave(&obj->child_list_lock, flags);
 
 	list_for_each_entry_safe(pt, next, &obj->active_list_head,
@@ -186,8 +196,10 @@ static void fence_check_cb_func(struct fence *f, struct fence_cb *cb)
 	check = container_of(cb, struct sync_fence_cb, cb);
 	fence = check->fence;
 
-	if (atomic_dec_and_test(&fence->status))
+	if (atomic_dec_and_test(&fence->status)) {
+		sync_fence_debug_signaled(fence);
 		wake_up_all(&fence->wq);
+	}
 }
 
 /* TODO: implement a create which takes more that one sync_pt */
@@ -247,6 +259,9 @@ EXPORT_SYMBOL(sync_fence_install);
 static void sync_fence_add_pt(struct sync_fence *fence,
 			      int *i, struct fence *pt)
 {
+	if (fence_is_signaled(pt))
+		return;
+
 	fence->cbs[*i].sync_pt = pt;
 	fence->cbs[*i].fence = fence;
 
@@ -256,13 +271,27 @@ static void sync_fence_add_pt(struct sync_fence *fence,
 	}
 }
 
+static struct sync_fence *sync_fence_dup(struct sync_fence *fence)
+{
+	get_file(fence->file);
+	return fence;
+}
+
 struct sync_fence *sync_fence_merge(const char *name,
 				    struct sync_fence *a, struct sync_fence *b)
 {
-	int num_fences = a->num_fences + b->num_fences;
+	int num_fences;
 	struct sync_fence *fence;
 	int i, i_a, i_b;
-	unsigned long size = offsetof(struct sync_fence, cbs[num_fences]);
+	unsigned long size;
+
+	if (atomic_read(&a->status) == 0)
+		return sync_fence_dup(b);
+	if (atomic_read(&b->status) == 0)
+		return sync_fence_dup(a);
+
+	num_fences = a->num_fences + b->num_fences;
+	size = offsetof(struct sync_fence, cbs[num_fences]);
 
 	fence = sync_fence_alloc(size, name);
 	if (fence == NULL)
@@ -465,6 +494,12 @@ static bool android_fence_enable_signaling(struct fence *fence)
 		return false;
 
 	list_add_tail(&pt->active_list, &parent->active_list_head);
+	/* pairs with the lockless check in sync_timeline_signal() */
+	smp_mb();
+	if (android_fence_signaled(fence)) {
+		list_del_init(&pt->active_list);
+		return false;
+	}
 	return true;
 }
 
@@ -555,6 +590,11 @@ static unsigned int sync_fence_poll(struct file *file, poll_table *wait)
 	struct sync_fence *fence = file->private_data;
 	int status;
 
+	/* no need to queue on the waitqueue of a fence that is done */
+	status = atomic_read(&fence->status);
+	if (status <= 0)
+		return status ? POLLERR : POLLIN;
+
 	poll_wait(file, &fence->wq, wait);
 
 	status = atomic_read(&fence->status);
@@ -150,6 +150,7 @@ struct sync_fence_cb {
  *
  * @wq:			wait queue for fence signaling
  * @sync_fence_list:	membership in global fence list
+ * @create_ts:		creation time, for the debugfs histograms
  */
 struct sync_fence {
 	struct file		*file;
@@ -157,6 +158,7 @@ struct sync_fence {
 	char			name[32];
 #ifdef CONFIG_DEBUG_FS
 	struct list_head	sync_fence_list;
+	ktime_t			create_ts;
 #endif
 	int num_fences;
 
@@ -266,6 +268,10 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt);
  *
  * Creates a new fence which contains copies of all the sync_pts in both
  * @a and @b.  @a and @b remain valid, independent fences.
+ *
+ * If one of the fences has already signaled without error, no new fence
+ * is allocated and a new reference to the other one is returned instead,
+ * keeping its name.
  */
 struct sync_fence *sync_fence_merge(const char *name,
 				    struct sync_fence *a, struct sync_fence *b);
@@ -341,6 +347,7 @@ void sync_timeline_debug_add(struct sync_timeline *obj);
 void sync_timeline_debug_remove(struct sync_timeline *obj);
 void sync_fence_debug_add(struct sync_fence *fence);
 void sync_fence_debug_remove(struct sync_fence *fence);
+void sync_fence_debug_signaled(struct sync_fence *fence);
 void sync_dump(void);
 
 #else
@@ -348,6 +355,7 @@ void sync_dump(void);
 # define sync_timeline_debug_remove(obj)
 # define sync_fence_debug_add(fence)
 # define sync_fence_debug_remove(fence)
+# define sync_fence_debug_signaled(fence)
 # define sync_dump()
 #endif
 int sync_fence_wake_up_wq(wait_queue_t *curr, unsigned mode,
@@ -42,6 +42,25 @@ static DEFINE_SPINLOCK(sync_timeline_list_lock);
 static LIST_HEAD(sync_fence_list_head);
 static DEFINE_SPINLOCK(sync_fence_list_lock);
 
+/*
+ * log2 histograms in usecs: bucket n counts [2^(n-1), 2^n) us, bucket 0
+ * everything below 1us and the last bucket everything above.
+ */
+#define SYNC_HIST_BUCKETS	20
+
+static atomic_t sync_signal_hist[SYNC_HIST_BUCKETS];
+static atomic_t sync_lifetime_hist[SYNC_HIST_BUCKETS];
+
+static void sync_hist_add(atomic_t *hist, ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = 0;
+
+	if (us > 0)
+		bucket = min_t(int, fls64(us), SYNC_HIST_BUCKETS - 1);
+	atomic_inc(&hist[bucket]);
+}
+
 void sync_timeline_debug_add(struct sync_timeline *obj)
 {
 	unsigned long flags;
@@ -64,6 +83,8 @@ void sync_fence_debug_add(struct sync_fence *fence)
 {
 	unsigned long flags;
 
+	fence->create_ts = ktime_get();
+
 	spin_lock_irqsave(&sync_fence_list_lock, flags);
 	list_add_tail(&fence->sync_fence_list, &sync_fence_list_head);
 	spin_unlock_irqrestore(&sync_fence_list_lock, flags);
@@ -76,6 +97,19 @@ void sync_fence_debug_remove(struct sync_fence *fence)
 	spin_lock_irqsave(&sync_fence_list_lock, flags);
 	list_del(&fence->sync_fence_list);
 	spin_unlock_irqrestore(&sync_fence_list_lock, flags);
+
+	sync_hist_add(sync_lifetime_hist, fence->create_ts);
+}
+
+/* called from the pt callback, possibly in irq context */
+void sync_fence_debug_signaled(struct sync_fence *fence)
+{
+	/* signaled while still being constructed */
+	if (!ktime_to_ns(fence->create_ts)) {
+		atomic_inc(&sync_signal_hist[0]);
+		return;
+	}
+	sync_hist_add(sync_signal_hist, fence->create_ts);
 }
 
 #ifdef SYNC_DEBUG
@@ -229,9 +263,43 @@ static const struct file_operations sync_debugfs_fops = {
 	.release        = single_release,
 };
 
+static void sync_print_hist(struct seq_file *s, const char *name,
+			    atomic_t *hist)
+{
+	int i;
+
+	seq_printf(s, "%s:\n", name);
+	for (i = 0; i < SYNC_HIST_BUCKETS - 1; i++)
+		seq_printf(s, "  <%9luus: %u\n", 1UL << i,
+			   atomic_read(&hist[i]));
+	seq_printf(s, "  >=%8luus: %u\n", 1UL << (SYNC_HIST_BUCKETS - 2),
+		   atomic_read(&hist[i]));
+}
+
+static int sync_stats_show(struct seq_file *s, void *unused)
+{
+	sync_print_hist(s, "signal latency", sync_signal_hist);
+	sync_print_hist(s, "fence lifetime", sync_lifetime_hist);
+	return 0;
+}
+
+static int sync_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sync_stats_show, inode->i_private);
+}
+
+static const struct file_operations sync_stats_fops = {
+	.open           = sync_stats_open,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static __init int sync_debugfs_init(void)
 {
 	debugfs_create_file("sync", S_IRUGO, NULL, NULL, &sync_debugfs_fops);
+	debugfs_create_file("sync_stats", S_IRUGO, NULL, NULL,
+			    &sync_stats_fops);
 	return 0;
 }
 late_initcall(sync_debugfs_init);
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+/*
+ * Skin temperature forecast for virtual thermal zones.
+ *
+ * The skin is modelled as a first order system driven by the CPU and GPU
+ * power at their current operating points:
+ *
+ *	dT/dt = (bias + gain * P - T) / tau
+ *
+ * where bias, the temperature the skin settles at with no power, follows
+ * the ambient and is estimated along with T by a two state Kalman filter
+ * fed with the zone temperature. The forecast is where T gets to after
+ * horizon_ms if the current power is held. Each forecast is later compared
+ * with the zone temperature measured once its horizon has passed.
+ */
+
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include "amazon_thermal_model.h"
+
+#define MODEL_SHIFT 16
+#define MODEL_ONE (1LL << MODEL_SHIFT)
+/* (100°C)^2, keeps the fixed point products within 64 bits */
+#define MODEL_MAX_COV 10000000000LL
+/* Initial uncertainty of the bias, (5°C)^2 */
+#define MODEL_INIT_BIAS_COV 25000000LL
+#define MODEL_FORECAST_STEPS 16
+
+int amazon_thermal_model_set_params(struct amazon_thermal_model *model,
+				    const unsigned int *prop)
+{
+	if (!prop[0] || !prop[5])
+		return -EINVAL;
+
+	memset(model, 0, sizeof(*model));
+	model->tau_ms = prop[0];
+	model->gain = prop[1];
+	model->horizon_ms = prop[2];
+	model->q_temp = prop[3];
+	model->q_bias = prop[4];
+	model->r_meas = prop[5];
+
+	return 0;
+}
+
+static s64 model_rise(struct amazon_thermal_model *model, u32 power)
+{
+	return div_u64((u64)model->gain * power, 1000);
+}
+
+static void model_clamp_cov(struct amazon_thermal_model *model)
+{
+	model->p00 = clamp_t(s64, model->p00, 0, MODEL_MAX_COV);
+	model->p01 = clamp_t(s64, model->p01, -MODEL_MAX_COV, MODEL_MAX_COV);
+	model->p11 = clamp_t(s64, model->p11, 0, MODEL_MAX_COV);
+}
+
+static void model_predict(struct amazon_thermal_model *model, s64 rise,
+			  unsigned int dt_ms)
+{
+	s64 a = min_t(s64, div_u64((u64)dt_ms << MODEL_SHIFT, model->tau_ms),
+		      MODEL_ONE);
+	s64 b = MODEL_ONE - a;
+	s64 t0, t1;
+
+	model->temp += (a * (model->bias + rise - model->temp)) >> MODEL_SHIFT;
+
+	/* P = A * P * A' + Q with A = [1 - a, a; 0, 1] */
+	t0 = (b * model->p00 + a * model->p01) >> MODEL_SHIFT;
+	t1 = (b * model->p01 + a * model->p11) >> MODEL_SHIFT;
+	model->p00 = ((b * t0 + a * t1) >> MODEL_SHIFT) +
+		     div_u64((u64)model->q_temp * dt_ms, 1000);
+	model->p01 = t1;
+	model->p11 += div_u64((u64)model->q_bias * dt_ms, 1000);
+	model_clamp_cov(model);
+}
+
+static void model_correct(struct amazon_thermal_model *model, int temp)
+{
+	s64 s = model->p00 + model->r_meas;
+	s64 k0 = div64_s64(model->p00 * MODEL_ONE, s);
+	s64 k1 = div64_s64(model->p01 * MODEL_ONE, s);
+	s64 e = temp - model->temp;
+
+	model->temp += (k0 * e) >> MODEL_SHIFT;
+	model->bias += (k1 * e) >> MODEL_SHIFT;
+
+	/* P = (I - K * H) * P with H = [1, 0] */
+	model->p11 -= (k1 * model->p01) >> MODEL_SHIFT;
+	model->p01 -= (k0 * model->p01) >> MODEL_SHIFT;
+	model->p00 -= (k0 * model->p00) >> MODEL_SHIFT;
+	model_clamp_cov(model);
+}
+
+static int model_forecast(struct amazon_thermal_model *model, s64 rise)
+{
+	s64 eq = model->bias + rise;
+	s64 x = model->temp - eq;
+	s64 a = min_t(s64, div_u64((u64)model->horizon_ms << MODEL_SHIFT,
+				   (u64)model->tau_ms * MODEL_FORECAST_STEPS),
+		      MODEL_ONE);
+	int i;
+
+	/* x * exp(-horizon / tau), as (1 - horizon / (n * tau))^n */
+	for (i = 0; i < MODEL_FORECAST_STEPS; i++)
+		x -= (a * x) >> MODEL_SHIFT;
+
+	return clamp_t(s64, eq + x, INT_MIN, INT_MAX);
+}
+
+static void model_check(struct amazon_thermal_model *model, int temp,
+			unsigned long now)
+{
+	int err;
+
+	while (model->nr_pending &&
+	       time_after_eq(now, model->pending[model->head].due)) {
+		err = temp - model->pending[model->head].value;
+		model->nr_err++;
+		model->sum_err += err;
+		model->sum_abs_err += abs(err);
+		model->max_abs_err = max(model->max_abs_err, abs(err));
+		model->last_err = err;
+
+		model->head = (model->head + 1) %
+			      AMAZON_THERMAL_MODEL_NR_PENDING;
+		model->nr_pending--;
+	}
+}
+
+/*
+ * Keeps forecasts at least horizon / AMAZON_THERMAL_MODEL_NR_PENDING apart
+ * so a full horizon of them fits in the pending ring.
+ */
+static void model_record(struct amazon_thermal_model *model, int forecast,
+			 unsigned long now)
+{
+	unsigned long horizon = msecs_to_jiffies(model->horizon_ms);
+	unsigned int i;
+
+	if (model->nr_pending) {
+		i = (model->head + model->nr_pending - 1) %
+		    AMAZON_THERMAL_MODEL_NR_PENDING;
+		if (time_before(now + horizon, model->pending[i].due +
+				horizon / AMAZON_THERMAL_MODEL_NR_PENDING))
+			return;
+	}
+	if (model->nr_pending == AMAZON_THERMAL_MODEL_NR_PENDING)
+		return;
+
+	i = (model->head + model->nr_pending) % AMAZON_THERMAL_MODEL_NR_PENDING;
+	model->pending[i].due = now + horizon;
+	model->pending[i].value = forecast;
+	model->nr_pending++;
+}
+
+/*
+ * Feeds the zone temperature @temp and the power @power drawn since the
+ * last call into the model, and returns the forecast.
+ */
+int amazon_thermal_model_update(struct amazon_thermal_model *model,
+				int temp, u32 power)
+{
+	unsigned long now = jiffies;
+	s64 rise = model_rise(model, power);
+
+	if (!model->initialized) {
+		/* assume the skin has settled at the current power */
+		model->temp = temp;
+		model->bias = temp - rise;
+		model->p00 = model->r_meas;
+		model->p01 = 0;
+		model->p11 = MODEL_INIT_BIAS_COV;
+		model->initialized = true;
+	} else {
+		model_predict(model, model_rise(model, model->power),
+			      jiffies_to_msecs(now - model->last));
+		model_correct(model, temp);
+		model_check(model, temp, now);
+	}
+
+	model->last = now;
+	model->power = power;
+	model->forecast = model_forecast(model, rise);
+	model_record(model, model->forecast, now);
+
+	return model->forecast;
+}
+
+ssize_t amazon_thermal_model_show(struct amazon_thermal_model *model,
+				  char *buf)
+{
+	unsigned long nr = model->nr_err;
+	int n;
+
+	n = sprintf(buf,
+		"tau_ms: %u gain: %u horizon_ms: %u q_temp: %u q_bias: %u r_meas: %u\n",
+		model->tau_ms, model->gain, model->horizon_ms,
+		model->q_temp, model->q_bias, model->r_meas);
+	n += sprintf(buf + n,
+		"temp: %lld bias: %lld power: %umW forecast: %d\n",
+		model->temp, model->bias, model->power, model->forecast);
+	n += sprintf(buf + n,
+		"errors: %lu mean: %lld mean_abs: %llu max_abs: %d last: %d\n",
+		nr, nr ? div64_s64(model->sum_err, nr) : 0,
+		nr ? div64_u64(model->sum_abs_err, nr) : 0,
+		model->max_abs_err, model->last_err);
+
+	return n;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Amazon.com, Inc. or its affiliates.
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <linux/types.h>
+
+#define AMAZON_THERMAL_MODEL_NR_PROP 6
+#define AMAZON_THERMAL_MODEL_NR_PENDING 8
+
+/**
+ * struct amazon_thermal_model  - Skin temperature forecast of a virtual zone.
+ * @tau_ms: Time constant of the skin temperature
+ * @gain: Steady state temperature rise per power, in m°C/W
+ * @horizon_ms: How far ahead the forecast looks, 0 disables the model
+ * @q_temp: Process noise of the temperature, in m°C^2 per second
+ * @q_bias: Process noise of the bias, in m°C^2 per second
+ * @r_meas: Measurement noise, in m°C^2
+ * @initialized: The state holds a first measurement
+ * @last: Time of the last update in jiffies
+ * @temp: Estimated temperature in m°C
+ * @bias: Estimated temperature at zero power in m°C
+ * @p00: Covariance of @temp
+ * @p01: Covariance of @temp and @bias
+ * @p11: Covariance of @bias
+ * @power: Last power input in mW
+ * @forecast: Last forecast in m°C
+ * @pending: Forecasts waiting for their measurement
+ * @head: Oldest entry of @pending
+ * @nr_pending: Number of entries in @pending
+ * @nr_err: Number of forecasts checked against a measurement
+ * @sum_err: Sum of measurement minus forecast
+ * @sum_abs_err: Sum of the absolute forecast errors
+ * @max_abs_err: Largest absolute forecast error
+ * @last_err: Last forecast error
+ */
+struct amazon_thermal_model {
+	unsigned int tau_ms;
+	unsigned int gain;
+	unsigned int horizon_ms;
+	unsigned int q_temp;
+	unsigned int q_bias;
+	unsigned int r_meas;
+
+	bool initialized;
+	unsigned long last;
+	s64 temp;
+	s64 bias;
+	s64 p00;
+	s64 p01;
+	s64 p11;
+	u32 power;
+	int forecast;
+
+	struct {
+		unsigned long due;
+		int value;
+	} pending[AMAZON_THERMAL_MODEL_NR_PENDING];
+	unsigned int head;
+	unsigned int nr_pending;
+
+	unsigned long nr_err;
+	s64 sum_err;
+	u64 sum_abs_err;
+	int max_abs_err;
+	int last_err;
+};
+
+int amazon_thermal_model_set_params(struct amazon_thermal_model *model,
+				    const unsigned int *prop);
+int amazon_thermal_model_update(struct amazon_thermal_model *model,
+				int temp, u32 power);
+ssize_t amazon_thermal_model_show(struct amazon_thermal_model *model,
+				  char *buf);
@@ -14,12 +14,19 @@
  */
 
 #include <linux/errno.h>
+#include <linux/types.h>
 
 #ifdef CONFIG_MACH_MT8167
 int set_suspend_wakeup_timer_s(unsigned int seconds);
+u32 amazon_thermal_get_power(void);
 #else
 static inline int set_suspend_wakeup_timer_s(unsigned int seconds)
 {
 	return -EOPNOTSUPP;
 }
+
+static inline u32 amazon_thermal_get_power(void)
+{
+	return 0;
+}
 #endif
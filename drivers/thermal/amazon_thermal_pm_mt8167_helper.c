@@ -15,6 +15,8 @@
 
 #include <linux/printk.h>
 #include <soc/mediatek/spm.h>
+#include "mtk_power_throttle.h"
+#include "amazon_thermal_pm_helper.h"
 
 int set_suspend_wakeup_timer_s(unsigned int seconds)
 {
@@ -32,3 +34,13 @@ int set_suspend_wakeup_timer_s(unsigned int seconds)
 
 	return ret;
 }
+
+/*
+ * CPU and GPU power in mW, looked up in the power tables at the current
+ * OPPs. Unlike get_requested_power() of a power actor this samples no
+ * load, so it leaves the governors' accounting alone.
+ */
+u32 amazon_thermal_get_power(void)
+{
+	return mt_cpufreq_get_cur_power() + mtk_thermal_get_gpu_power();
+}
@@ -33,8 +33,14 @@
 #include <linux/mutex.h>
 #include <linux/thermal_framework.h>
 #include <linux/cpufreq.h>
+#include <linux/i2c.h>
+#include <linux/jiffies.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <thermal_core.h>
 #include <amazon_thermal_life_cycle_reasons.h>
+#include <amazon_thermal_model.h>
+#include <amazon_thermal_pm_helper.h>
 
 #define DMF 1000
 #define NUM_OF_MOVING_AVG_PROP 4
@@ -45,6 +51,22 @@ static DEFINE_MUTEX(virtual_sensor_dev_lock);
 static LIST_HEAD(global_virtual_thermal_zone_list);
 static DEFINE_MUTEX(virtual_thermal_zone_lock);
 
+/*
+ * Sensors are read by a shared sampler, each one every sample_ms (or its
+ * own sample.period_ms), and virtual zones use the cached readings. A zone
+ * finding a reading older than max_age_ms, or a failed one, reads the
+ * sensor itself. Setting sample_ms to 0 turns the sampler off and every
+ * zone poll reads its sensors directly.
+ */
+static unsigned int sample_ms = 1000;
+static unsigned int max_age_ms = 2500;
+module_param(max_age_ms, uint, 0644);
+
+static DEFINE_SPINLOCK(thermal_dev_sample_lock);
+static void thermal_dev_sample_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(thermal_dev_sample_work,
+			    thermal_dev_sample_work_fn);
+
 /**
  * struct virtual_thermal_time_val  - Structure for storing ma and time
  * @time: time in jiffies
@@ -102,6 +124,7 @@ struct virtual_thermal_dev {
  * @virtual_sensor_dev_list:  Virtual senosr device list header.
  * @node: The list node of virtual thermal zones.
  * @vs_ma: Virtual sensor moving average.
+ * @model: Skin temperature forecast, NULL if not configured.
  * @lock: To protect virtual_sensor_dev_list.
  * @last_trend: last thermal trend of the tz trips.
  */
@@ -110,6 +133,7 @@ struct virtual_thermal_zone {
 	struct list_head            virtual_sensor_dev_list;
 	struct list_head node;
 	struct virtual_thermal_ma *vs_ma;
+	struct amazon_thermal_model *model;
 	struct mutex lock;
 	enum thermal_trend last_trend[THERMAL_MAX_TRIPS];
 };
@@ -235,6 +259,186 @@ static int virtual_sensor_update_ma_and_return_roc(
 	return vs_ma->ma_roc;
 }
 
+static unsigned long thermal_dev_sample_period(struct thermal_dev *tdev)
+{
+	return msecs_to_jiffies(tdev->sample.period_ms ? : sample_ms);
+}
+
+static void thermal_dev_sample_update(struct thermal_dev *tdev, int temp,
+				      int err, bool sync)
+{
+	struct thermal_dev_sample *s = &tdev->sample;
+
+	spin_lock(&thermal_dev_sample_lock);
+	if (!err)
+		s->temp = temp;
+	s->err = err;
+	s->stamp = jiffies;
+	if (sync)
+		s->sync++;
+	else
+		s->reads++;
+	if (err)
+		s->errors++;
+	spin_unlock(&thermal_dev_sample_lock);
+}
+
+/*
+ * Returns the cached reading of @tdev if it is valid and at most max_age_ms
+ * old, otherwise reads the sensor and refreshes the cache.
+ */
+static int thermal_dev_read_temp(struct thermal_dev *tdev, int *temp)
+{
+	struct thermal_dev_sample *s = &tdev->sample;
+	unsigned long age;
+	int err;
+
+	if (sample_ms) {
+		spin_lock(&thermal_dev_sample_lock);
+		age = jiffies - s->stamp;
+		if ((s->reads || s->sync) && !s->err &&
+		    age <= msecs_to_jiffies(max_age_ms)) {
+			*temp = s->temp;
+			if (age > s->max_age)
+				s->max_age = age;
+			spin_unlock(&thermal_dev_sample_lock);
+			return 0;
+		}
+		spin_unlock(&thermal_dev_sample_lock);
+	}
+
+	err = tdev->dev_ops->get_temp(tdev, temp);
+	thermal_dev_sample_update(tdev, *temp, err, true);
+	return err;
+}
+
+static struct i2c_adapter *thermal_dev_i2c_adapter(struct thermal_dev *tdev)
+{
+	struct i2c_client *client;
+
+	if (!IS_BUILTIN(CONFIG_I2C) || !tdev->dev)
+		return NULL;
+
+	client = i2c_verify_client(tdev->dev);
+	return client ? client->adapter : NULL;
+}
+
+static bool thermal_dev_sample_due(struct thermal_dev *tdev, unsigned long now,
+				   unsigned int pass)
+{
+	return tdev->sample.pass != pass &&
+	       time_after_eq(now, tdev->sample.next);
+}
+
+static void thermal_dev_sample_one(struct thermal_dev *tdev, unsigned long now,
+				   unsigned int pass)
+{
+	int temp = 0, err;
+
+	err = tdev->dev_ops->get_temp(tdev, &temp);
+	thermal_dev_sample_update(tdev, temp, err, false);
+	tdev->sample.next = now + thermal_dev_sample_period(tdev);
+	tdev->sample.pass = pass;
+}
+
+/*
+ * Reads the sensors that are due. Once a sensor on an I2C bus has been
+ * read, the other sensors on that bus due within half a period are read
+ * right after it, so the bus and its controller wake up once per pass
+ * rather than once per sensor.
+ */
+static void thermal_dev_sample_work_fn(struct work_struct *work)
+{
+	static unsigned int pass;
+	struct thermal_dev *tdev, *peer;
+	struct i2c_adapter *adap;
+	unsigned long now = jiffies, next = 0;
+	bool pending = false;
+
+	if (!sample_ms)
+		return;
+
+	mutex_lock(&virtual_sensor_dev_lock);
+	pass++;
+	list_for_each_entry(tdev, &global_virtual_sensor_dev_list, node) {
+		if (!thermal_dev_sample_due(tdev, now, pass))
+			continue;
+
+		thermal_dev_sample_one(tdev, now, pass);
+
+		adap = thermal_dev_i2c_adapter(tdev);
+		if (!adap)
+			continue;
+
+		peer = tdev;
+		list_for_each_entry_continue(peer,
+				&global_virtual_sensor_dev_list, node) {
+			if (thermal_dev_i2c_adapter(peer) == adap &&
+			    thermal_dev_sample_due(peer,
+				now + thermal_dev_sample_period(peer) / 2,
+				pass))
+				thermal_dev_sample_one(peer, now, pass);
+		}
+	}
+
+	list_for_each_entry(tdev, &global_virtual_sensor_dev_list, node) {
+		if (!pending || time_before(tdev->sample.next, next))
+			next = tdev->sample.next;
+		pending = true;
+	}
+	mutex_unlock(&virtual_sensor_dev_lock);
+
+	if (pending)
+		queue_delayed_work(system_freezable_wq,
+				   &thermal_dev_sample_work,
+				   max_t(long, next - jiffies, 1));
+}
+
+static int sample_ms_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && sample_ms)
+		mod_delayed_work(system_freezable_wq,
+				 &thermal_dev_sample_work, 0);
+	return ret;
+}
+
+static const struct kernel_param_ops sample_ms_ops = {
+	.set = sample_ms_set,
+	.get = param_get_uint,
+};
+module_param_cb(sample_ms, &sample_ms_ops, &sample_ms, 0644);
+
+/*
+ * Returns the temperature the zone acts on: the forecast when it is above
+ * the measured temperature @temp. Like emulation in thermal_zone_get_temp(),
+ * the forecast alone never takes the zone to its critical trip.
+ */
+static int virtual_sensor_forecast_temp(struct virtual_thermal_zone *vtz,
+					int temp)
+{
+	struct thermal_zone_device *tz = vtz->virtual_sensor_tzd;
+	enum thermal_trip_type type;
+	int forecast, crit_temp, i;
+
+	forecast = amazon_thermal_model_update(vtz->model, temp,
+					       amazon_thermal_get_power());
+	if (forecast <= temp)
+		return temp;
+
+	for (i = 0; i < tz->trips; i++) {
+		if (tz->ops->get_trip_type(tz, i, &type) ||
+		    type != THERMAL_TRIP_CRITICAL ||
+		    tz->ops->get_trip_temp(tz, i, &crit_temp))
+			continue;
+		if (temp < crit_temp && forecast >= crit_temp)
+			forecast = crit_temp - 1;
+	}
+
+	return forecast;
+}
+
 static int virtual_sensor_get_temp(void *data, int *t)
 {
 	struct virtual_thermal_dev *vtdev;
@@ -273,7 +477,7 @@ static int virtual_sensor_get_temp(void *data, int *t)
 			}
 			vtdev->valid_temp_recorded = true;
 		}
-		ret = tdev->dev_ops->get_temp(tdev, &curr_temp);
+		ret = thermal_dev_read_temp(tdev, &curr_temp);
 		if (ret) {
 			pr_debug("%s get_temp error(%d)\n",
 				tdev->name, ret);
@@ -310,6 +514,9 @@ static int virtual_sensor_get_temp(void *data, int *t)
 	if (vtz->vs_ma && tempv)
 		tempv = virtual_sensor_update_ma_and_return_roc(vtz->vs_ma,
 									tempv);
+	else if (vtz->model && vtz->model->horizon_ms &&
+		 !IS_ERR_OR_NULL(vtz->virtual_sensor_tzd) && tempv > 0)
+		tempv = virtual_sensor_forecast_temp(vtz, tempv);
 	/*
 	 * if the temp is negative (which won't be the case with our devices)
 	 * then the metrics can be skewed because the back-end is expecting
@@ -476,6 +683,93 @@ static ssize_t _store_ma(struct device *dev, struct device_attribute *devattr,
 
 static DEVICE_ATTR(ma, 0644, _show_ma, _store_ma);
 
+static ssize_t _show_model(struct device *dev,
+			   struct device_attribute *devattr, char *buf)
+{
+	struct virtual_thermal_zone *vtz = dev_get_drvdata(dev);
+	ssize_t n;
+
+	mutex_lock(&vtz->lock);
+
+	if (vtz->model)
+		n = amazon_thermal_model_show(vtz->model, buf);
+	else
+		n = sprintf(buf, "NA\n");
+
+	mutex_unlock(&vtz->lock);
+
+	return n;
+}
+
+static ssize_t _store_model(struct device *dev,
+			    struct device_attribute *devattr,
+			    const char *buf, size_t count)
+{
+	unsigned int prop[AMAZON_THERMAL_MODEL_NR_PROP];
+	struct virtual_thermal_zone *vtz = dev_get_drvdata(dev);
+	ssize_t ret;
+
+	if (!vtz)
+		return -EINVAL;
+
+	if (sscanf(buf, "%u %u %u %u %u %u", &prop[0], &prop[1], &prop[2],
+		   &prop[3], &prop[4], &prop[5]) != AMAZON_THERMAL_MODEL_NR_PROP)
+		return -EINVAL;
+
+	mutex_lock(&vtz->lock);
+
+	if (!vtz->model)
+		vtz->model = devm_kzalloc(dev, sizeof(*vtz->model),
+					  GFP_KERNEL);
+	if (vtz->model)
+		ret = amazon_thermal_model_set_params(vtz->model, prop) ? :
+		      count;
+	else
+		ret = -ENOMEM;
+
+	mutex_unlock(&vtz->lock);
+
+	return ret;
+}
+
+static DEVICE_ATTR(model, 0644, _show_model, _store_model);
+
+static ssize_t _show_samples(struct device *dev,
+			     struct device_attribute *devattr, char *buf)
+{
+	struct virtual_thermal_zone *vtz = dev_get_drvdata(dev);
+	struct virtual_thermal_dev *vtdev;
+	struct thermal_dev_sample s;
+	int n = 0;
+
+	mutex_lock(&vtz->lock);
+
+	list_for_each_entry(vtdev, &vtz->virtual_sensor_dev_list, node) {
+		if (!vtdev->tdev)
+			continue;
+
+		spin_lock(&thermal_dev_sample_lock);
+		s = vtdev->tdev->sample;
+		spin_unlock(&thermal_dev_sample_lock);
+
+		n += scnprintf(buf + n, PAGE_SIZE - n,
+			"%s : age: %ums period: %ums max_age: %ums reads: %lu sync: %lu errors: %lu\n",
+			vtdev->tdev->name,
+			s.reads || s.sync ?
+				jiffies_to_msecs(jiffies - s.stamp) : 0,
+			jiffies_to_msecs(
+				thermal_dev_sample_period(vtdev->tdev)),
+			jiffies_to_msecs(s.max_age), s.reads, s.sync,
+			s.errors);
+	}
+
+	mutex_unlock(&vtz->lock);
+
+	return n;
+}
+
+static DEVICE_ATTR(samples, 0444, _show_samples, NULL);
+
 static int virtual_sensor_thermal_probe(struct platform_device *pdev)
 {
 	struct virtual_thermal_zone *vtz;
@@ -486,6 +780,7 @@ static int virtual_sensor_thermal_probe(struct platform_device *pdev)
 	struct platform_device *phys_sensor;
 	struct of_phandle_args args;
 	unsigned int ma_prop[NUM_OF_MOVING_AVG_PROP];
+	unsigned int model_prop[AMAZON_THERMAL_MODEL_NR_PROP];
 
 	if (!cpufreq_frequency_get_table(0)) {
 		dev_info(&pdev->dev, "Frequency table not initialized. Deferring probe...\n");
@@ -594,6 +889,24 @@ static int virtual_sensor_thermal_probe(struct platform_device *pdev)
 		}
 	}
 
+	if (of_property_read_bool(np, "thermal-model-prop")) {
+		vtz->model = devm_kzalloc(&pdev->dev, sizeof(*vtz->model),
+					  GFP_KERNEL);
+		if (!vtz->model) {
+			mutex_unlock(&virtual_thermal_zone_lock);
+			return -ENOMEM;
+		}
+		if (of_property_read_u32_array(np, "thermal-model-prop",
+				model_prop, AMAZON_THERMAL_MODEL_NR_PROP) ||
+		    amazon_thermal_model_set_params(vtz->model, model_prop)) {
+			dev_err(&pdev->dev,
+				"%s Invalid thermal-model-properties\n",
+				__func__);
+			devm_kfree(&pdev->dev, vtz->model);
+			vtz->model = NULL;
+		}
+	}
+
 	mutex_init(&vtz->lock);
 
 	list_add_tail(&vtz->node, &global_virtual_thermal_zone_list);
@@ -630,6 +943,16 @@ static int virtual_sensor_thermal_probe(struct platform_device *pdev)
 		pr_warn("%s Failed to create ma attr - error (%d)\n",
 			__func__, error);
 
+	error = device_create_file(&pdev->dev, &dev_attr_model);
+	if (error)
+		pr_warn("%s Failed to create model attr - error (%d)\n",
+			__func__, error);
+
+	error = device_create_file(&pdev->dev, &dev_attr_samples);
+	if (error)
+		pr_warn("%s Failed to create samples attr - error (%d)\n",
+			__func__, error);
+
 	return 0;
 }
 static int virtual_sensor_thermal_remove(struct platform_device *pdev)
@@ -674,9 +997,14 @@ int thermal_dev_register(struct thermal_dev *tdev)
 			}
 		}
 	}
+	tdev->sample.next = jiffies;
 	list_add_tail(&tdev->node, &global_virtual_sensor_dev_list);
 	mutex_unlock(&virtual_sensor_dev_lock);
 	mutex_unlock(&virtual_thermal_zone_lock);
+
+	if (sample_ms)
+		mod_delayed_work(system_freezable_wq,
+				 &thermal_dev_sample_work, 0);
 	return 0;
 }
 EXPORT_SYMBOL(thermal_dev_register);
@@ -730,6 +1058,7 @@ static int __init virtual_sensor_thermal_init(void)
 }
 static void __exit virtual_sensor_thermal_exit(void)
 {
+	cancel_delayed_work_sync(&thermal_dev_sample_work);
 	platform_driver_unregister(&virtual_sensor_driver);
 }
 
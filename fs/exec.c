@@ -56,6 +56,7 @@
 #include <linux/pipe_fs_i.h>
 #include <linux/oom.h>
 #include <linux/compat.h>
+#include <linux/launch_readahead.h>
 
 #include <asm/uaccess.h>
 #include <asm/mmu_context.h>
@@ -1594,6 +1595,7 @@ static int do_execveat_common(int fd, struct filename *filename,
 	/* execve succeeded */
 	current->fs->in_exec = 0;
 	current->in_execve = 0;
+	launch_ra_exec(bprm->file);
 	acct_update_integrals(current);
 	task_numa_free(current);
 	free_bprm(bprm);
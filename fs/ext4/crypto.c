@@ -33,6 +33,10 @@
 #include <linux/mutex.h>
 #include <linux/random.h>
 #include <linux/scatterlist.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/spinlock.h>
 #include <linux/spinlock_types.h>
 
 #include "ext4_extents.h"
@@ -52,12 +56,161 @@ MODULE_PARM_DESC(num_prealloc_crypto_ctxs,
 
 static mempool_t *ext4_bounce_page_pool;
 
+/*
+ * Per-CPU cache of bounce pages in front of ext4_bounce_page_pool. It is
+ * refilled EXT4_BOUNCE_BATCH pages at a time from the page allocator, and
+ * pages freed by write completion go back to the local cache first, so the
+ * mempool is only touched when the system is short of memory. Pages taken
+ * from the mempool always go back to it so its reserve is refilled; only
+ * pages from the page allocator are cached. Completions may fill the
+ * caches of CPUs that never write, so the cached pages are handed back to
+ * reclaim by ext4_bounce_shrinker. The lock is only taken by the owning
+ * CPU and the shrinker.
+ */
+#define EXT4_BOUNCE_BATCH	16
+#define EXT4_BOUNCE_CACHED	(2 * EXT4_BOUNCE_BATCH)
+
+struct ext4_bounce_cache {
+	spinlock_t lock;
+	unsigned int nr;
+	struct page *pages[EXT4_BOUNCE_CACHED];
+};
+
+struct ext4_crypto_stats {
+	u64 bounce_hits;
+	u64 bounce_refills;
+	u64 bounce_mempool;
+	u64 encrypt_pages;
+	u64 encrypt_ns;
+};
+
+static DEFINE_PER_CPU(struct ext4_bounce_cache, ext4_bounce_cache);
+static DEFINE_PER_CPU(struct ext4_crypto_stats, ext4_crypto_stats);
+
 static LIST_HEAD(ext4_free_crypto_ctxs);
 static DEFINE_SPINLOCK(ext4_crypto_ctx_lock);
 
 static struct kmem_cache *ext4_crypto_ctx_cachep;
 struct kmem_cache *ext4_crypt_info_cachep;
 
+static struct page *bounce_cache_get(void)
+{
+	struct ext4_bounce_cache *bc;
+	struct page *page = NULL;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	bc = this_cpu_ptr(&ext4_bounce_cache);
+	spin_lock(&bc->lock);
+	if (bc->nr)
+		page = bc->pages[--bc->nr];
+	spin_unlock(&bc->lock);
+	local_irq_restore(flags);
+	return page;
+}
+
+static void bounce_cache_refill(void)
+{
+	struct page *pages[EXT4_BOUNCE_BATCH];
+	struct ext4_bounce_cache *bc;
+	unsigned long flags;
+	int i = 0, n;
+
+	for (n = 0; n < EXT4_BOUNCE_BATCH; n++) {
+		pages[n] = alloc_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!pages[n])
+			break;
+	}
+
+	local_irq_save(flags);
+	bc = this_cpu_ptr(&ext4_bounce_cache);
+	spin_lock(&bc->lock);
+	while (i < n && bc->nr < ARRAY_SIZE(bc->pages))
+		bc->pages[bc->nr++] = pages[i++];
+	spin_unlock(&bc->lock);
+	local_irq_restore(flags);
+
+	/* we migrated to a CPU whose cache is already full */
+	while (i < n)
+		__free_page(pages[i++]);
+}
+
+/* Called from write completion, possibly in interrupt context */
+static void free_bounce_page(struct page *page, bool from_mempool)
+{
+	struct ext4_bounce_cache *bc;
+	unsigned long flags;
+
+	if (from_mempool) {
+		mempool_free(page, ext4_bounce_page_pool);
+		return;
+	}
+
+	local_irq_save(flags);
+	bc = this_cpu_ptr(&ext4_bounce_cache);
+	spin_lock(&bc->lock);
+	if (bc->nr < ARRAY_SIZE(bc->pages)) {
+		bc->pages[bc->nr++] = page;
+		page = NULL;
+	}
+	spin_unlock(&bc->lock);
+	local_irq_restore(flags);
+
+	if (page)
+		__free_page(page);
+}
+
+/* Frees up to @nr cached pages, returns how many were freed */
+static unsigned long bounce_cache_drain(unsigned long nr)
+{
+	struct page *pages[EXT4_BOUNCE_CACHED];
+	struct ext4_bounce_cache *bc;
+	unsigned long freed = 0;
+	unsigned long flags;
+	unsigned int n;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (freed >= nr)
+			break;
+		bc = per_cpu_ptr(&ext4_bounce_cache, cpu);
+		n = 0;
+		spin_lock_irqsave(&bc->lock, flags);
+		while (bc->nr && freed + n < nr)
+			pages[n++] = bc->pages[--bc->nr];
+		spin_unlock_irqrestore(&bc->lock, flags);
+
+		freed += n;
+		while (n)
+			__free_page(pages[--n]);
+	}
+	return freed;
+}
+
+static unsigned long bounce_cache_count(struct shrinker *shrink,
+					struct shrink_control *sc)
+{
+	unsigned long cached = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		cached += READ_ONCE(per_cpu_ptr(&ext4_bounce_cache, cpu)->nr);
+	return cached;
+}
+
+static unsigned long bounce_cache_scan(struct shrinker *shrink,
+				       struct shrink_control *sc)
+{
+	return bounce_cache_drain(sc->nr_to_scan);
+}
+
+static struct shrinker ext4_bounce_shrinker = {
+	.count_objects	= bounce_cache_count,
+	.scan_objects	= bounce_cache_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+static bool ext4_bounce_shrinker_registered;
+
 /**
  * ext4_release_crypto_ctx() - Releases an encryption context
  * @ctx: The encryption context to release.
@@ -72,7 +225,8 @@ void ext4_release_crypto_ctx(struct ext4_crypto_ctx *ctx)
 	unsigned long flags;
 
 	if (ctx->flags & EXT4_WRITE_PATH_FL && ctx->w.bounce_page)
-		mempool_free(ctx->w.bounce_page, ext4_bounce_page_pool);
+		free_bounce_page(ctx->w.bounce_page,
+				 ctx->flags & EXT4_BOUNCE_MEMPOOL_FL);
 	ctx->w.bounce_page = NULL;
 	ctx->w.control_page = NULL;
 	if (ctx->flags & EXT4_CTX_REQUIRES_FREE_ENCRYPT_FL) {
@@ -129,7 +283,7 @@ struct ext4_crypto_ctx *ext4_get_crypto_ctx(struct inode *inode)
 	} else {
 		ctx->flags &= ~EXT4_CTX_REQUIRES_FREE_ENCRYPT_FL;
 	}
-	ctx->flags &= ~EXT4_WRITE_PATH_FL;
+	ctx->flags &= ~(EXT4_WRITE_PATH_FL | EXT4_BOUNCE_MEMPOOL_FL);
 
 out:
 	if (res) {
@@ -153,6 +307,10 @@ void ext4_exit_crypto(void)
 	list_for_each_entry_safe(pos, n, &ext4_free_crypto_ctxs, free_list)
 		kmem_cache_free(ext4_crypto_ctx_cachep, pos);
 	INIT_LIST_HEAD(&ext4_free_crypto_ctxs);
+	if (ext4_bounce_shrinker_registered)
+		unregister_shrinker(&ext4_bounce_shrinker);
+	ext4_bounce_shrinker_registered = false;
+	bounce_cache_drain(ULONG_MAX);
 	if (ext4_bounce_page_pool)
 		mempool_destroy(ext4_bounce_page_pool);
 	ext4_bounce_page_pool = NULL;
@@ -182,6 +340,8 @@ int ext4_init_crypto(void)
 	mutex_lock(&crypto_init);
 	if (ext4_read_workqueue)
 		goto already_initialized;
+	for_each_possible_cpu(i)
+		spin_lock_init(&per_cpu_ptr(&ext4_bounce_cache, i)->lock);
 	ext4_read_workqueue = alloc_workqueue("ext4_crypto", WQ_HIGHPRI, 0);
 	if (!ext4_read_workqueue)
 		goto fail;
@@ -213,6 +373,11 @@ int ext4_init_crypto(void)
 		res = -ENOMEM;
 		goto fail;
 	}
+
+	res = register_shrinker(&ext4_bounce_shrinker);
+	if (res)
+		goto fail;
+	ext4_bounce_shrinker_registered = true;
 already_initialized:
 	mutex_unlock(&crypto_init);
 	return 0;
@@ -222,6 +387,33 @@ fail:
 	return res;
 }
 
+int ext4_seq_crypto_stats_show(struct seq_file *seq, void *offset)
+{
+	struct ext4_crypto_stats sum = { 0 };
+	unsigned int cached = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ext4_crypto_stats *st = per_cpu_ptr(&ext4_crypto_stats,
+							   cpu);
+
+		sum.bounce_hits += st->bounce_hits;
+		sum.bounce_refills += st->bounce_refills;
+		sum.bounce_mempool += st->bounce_mempool;
+		sum.encrypt_pages += st->encrypt_pages;
+		sum.encrypt_ns += st->encrypt_ns;
+		cached += READ_ONCE(per_cpu_ptr(&ext4_bounce_cache, cpu)->nr);
+	}
+
+	seq_printf(seq, "bounce_cached: %u\n", cached);
+	seq_printf(seq, "bounce_hits: %llu\n", sum.bounce_hits);
+	seq_printf(seq, "bounce_refills: %llu\n", sum.bounce_refills);
+	seq_printf(seq, "bounce_mempool: %llu\n", sum.bounce_mempool);
+	seq_printf(seq, "encrypt_pages: %llu\n", sum.encrypt_pages);
+	seq_printf(seq, "encrypt_us: %llu\n", div_u64(sum.encrypt_ns, 1000));
+	return 0;
+}
+
 void ext4_restore_control_page(struct page *data_page)
 {
 	struct ext4_crypto_ctx *ctx =
@@ -253,31 +445,36 @@ typedef enum {
 	EXT4_ENCRYPT,
 } ext4_direction_t;
 
-static int ext4_page_crypto(struct inode *inode,
-			    ext4_direction_t rw,
-			    pgoff_t index,
-			    struct page *src_page,
-			    struct page *dest_page)
-
+static struct ablkcipher_request *ext4_alloc_crypt_req(struct inode *inode,
+						 struct ext4_completion_result *ecr)
 {
-	u8 xts_tweak[EXT4_XTS_TWEAK_SIZE];
-	struct ablkcipher_request *req = NULL;
-	DECLARE_EXT4_COMPLETION_RESULT(ecr);
-	struct scatterlist dst, src;
 	struct ext4_crypt_info *ci = EXT4_I(inode)->i_crypt_info;
-	struct crypto_ablkcipher *tfm = ci->ci_ctfm;
-	int res = 0;
+	struct ablkcipher_request *req;
 
-	req = ablkcipher_request_alloc(tfm, GFP_NOFS);
+	req = ablkcipher_request_alloc(ci->ci_ctfm, GFP_NOFS);
 	if (!req) {
 		printk_ratelimited(KERN_ERR
 				   "%s: crypto_request_alloc() failed\n",
 				   __func__);
-		return -ENOMEM;
+		return NULL;
 	}
 	ablkcipher_request_set_callback(
 		req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
-		ext4_crypt_complete, &ecr);
+		ext4_crypt_complete, ecr);
+	return req;
+}
+
+/* @req may be reused for the next page once this returns */
+static int ext4_req_page_crypto(struct ablkcipher_request *req,
+				struct ext4_completion_result *ecr,
+				ext4_direction_t rw,
+				pgoff_t index,
+				struct page *src_page,
+				struct page *dest_page)
+{
+	u8 xts_tweak[EXT4_XTS_TWEAK_SIZE];
+	struct scatterlist dst, src;
+	int res = 0;
 
 	BUILD_BUG_ON(EXT4_XTS_TWEAK_SIZE < sizeof(index));
 	memcpy(xts_tweak, &index, sizeof(index));
@@ -290,15 +487,15 @@ static int ext4_page_crypto(struct inode *inode,
 	sg_set_page(&src, src_page, PAGE_CACHE_SIZE, 0);
 	ablkcipher_request_set_crypt(req, &src, &dst, PAGE_CACHE_SIZE,
 				     xts_tweak);
+	reinit_completion(&ecr->completion);
 	if (rw == EXT4_DECRYPT)
 		res = crypto_ablkcipher_decrypt(req);
 	else
 		res = crypto_ablkcipher_encrypt(req);
 	if (res == -EINPROGRESS || res == -EBUSY) {
-		wait_for_completion(&ecr.completion);
-		res = ecr.res;
+		wait_for_completion(&ecr->completion);
+		res = ecr->res;
 	}
-	ablkcipher_request_free(req);
 	if (res) {
 		printk_ratelimited(
 			KERN_ERR
@@ -309,9 +506,44 @@ static int ext4_page_crypto(struct inode *inode,
 	return 0;
 }
 
+static int ext4_page_crypto(struct inode *inode,
+			    ext4_direction_t rw,
+			    pgoff_t index,
+			    struct page *src_page,
+			    struct page *dest_page)
+
+{
+	struct ablkcipher_request *req;
+	DECLARE_EXT4_COMPLETION_RESULT(ecr);
+	int res;
+
+	req = ext4_alloc_crypt_req(inode, &ecr);
+	if (!req)
+		return -ENOMEM;
+	res = ext4_req_page_crypto(req, &ecr, rw, index, src_page, dest_page);
+	ablkcipher_request_free(req);
+	return res;
+}
+
 static struct page *alloc_bounce_page(struct ext4_crypto_ctx *ctx)
 {
-	ctx->w.bounce_page = mempool_alloc(ext4_bounce_page_pool, GFP_NOWAIT);
+	struct page *page;
+
+	page = bounce_cache_get();
+	if (page) {
+		this_cpu_inc(ext4_crypto_stats.bounce_hits);
+	} else {
+		bounce_cache_refill();
+		this_cpu_inc(ext4_crypto_stats.bounce_refills);
+		page = bounce_cache_get();
+	}
+	if (!page) {
+		page = mempool_alloc(ext4_bounce_page_pool, GFP_NOWAIT);
+		this_cpu_inc(ext4_crypto_stats.bounce_mempool);
+		if (page)
+			ctx->flags |= EXT4_BOUNCE_MEMPOOL_FL;
+	}
+	ctx->w.bounce_page = page;
 	if (ctx->w.bounce_page == NULL)
 		return ERR_PTR(-ENOMEM);
 	ctx->flags |= EXT4_WRITE_PATH_FL;
@@ -338,6 +570,7 @@ struct page *ext4_encrypt(struct inode *inode,
 {
 	struct ext4_crypto_ctx *ctx;
 	struct page *ciphertext_page = NULL;
+	u64 start;
 	int err;
 
 	BUG_ON(!PageLocked(plaintext_page));
@@ -351,8 +584,11 @@ struct page *ext4_encrypt(struct inode *inode,
 	if (IS_ERR(ciphertext_page))
 		goto errout;
 	ctx->w.control_page = plaintext_page;
+	start = local_clock();
 	err = ext4_page_crypto(inode, EXT4_ENCRYPT, plaintext_page->index,
 			       plaintext_page, ciphertext_page);
+	this_cpu_add(ext4_crypto_stats.encrypt_ns, local_clock() - start);
+	this_cpu_inc(ext4_crypto_stats.encrypt_pages);
 	if (err) {
 		ciphertext_page = ERR_PTR(err);
 	errout:
@@ -384,6 +620,46 @@ int ext4_decrypt(struct page *page)
 				EXT4_DECRYPT, page->index, page, page);
 }
 
+/**
+ * ext4_decrypt_bio() - Decrypts all pages of a read bio in-place
+ * @bio: The completed read bio. Its pages must be locked and belong to
+ *       the same inode.
+ *
+ * One cipher request is set up for the whole bio and reused for every
+ * page. Each page is marked uptodate, or in error if its decryption
+ * failed, and unlocked.
+ *
+ * Called from the read completion path, in process context.
+ */
+void ext4_decrypt_bio(struct bio *bio)
+{
+	struct inode *inode = bio->bi_io_vec[0].bv_page->mapping->host;
+	struct ablkcipher_request *req;
+	DECLARE_EXT4_COMPLETION_RESULT(ecr);
+	struct bio_vec *bv;
+	int i;
+
+	req = ext4_alloc_crypt_req(inode, &ecr);
+
+	bio_for_each_segment_all(bv, bio, i) {
+		struct page *page = bv->bv_page;
+		int ret = -ENOMEM;
+
+		if (req)
+			ret = ext4_req_page_crypto(req, &ecr, EXT4_DECRYPT,
+						   page->index, page, page);
+		if (ret) {
+			WARN_ON_ONCE(1);
+			SetPageError(page);
+		} else
+			SetPageUptodate(page);
+		unlock_page(page);
+	}
+
+	if (req)
+		ablkcipher_request_free(req);
+}
+
 int ext4_encrypted_zeroout(struct inode *inode, struct ext4_extent *ex)
 {
 	struct ext4_crypto_ctx	*ctx;
@@ -2261,6 +2261,8 @@ void ext4_restore_control_page(struct page *data_page);
 struct page *ext4_encrypt(struct inode *inode,
 			  struct page *plaintext_page);
 int ext4_decrypt(struct page *page);
+void ext4_decrypt_bio(struct bio *bio);
+int ext4_seq_crypto_stats_show(struct seq_file *seq, void *offset);
 int ext4_encrypted_zeroout(struct inode *inode, struct ext4_extent *ex);
 extern const struct dentry_operations ext4_encrypted_d_ops;
 
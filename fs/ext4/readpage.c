@@ -48,8 +48,17 @@
 #include <trace/events/android_fs.h>
 
 /*
- * Call ext4_decrypt on every single page, reusing the encryption
- * context.
+ * Encrypted read bios of at most this many pages are decrypted by the
+ * completing task itself when it is allowed to sleep; anything larger, or
+ * completed from interrupt context, goes to ext4_read_workqueue. The task
+ * is usually the block driver thread, such as mmcqd, which cannot issue
+ * the next request meanwhile, so only a single page is decrypted there.
+ */
+#define EXT4_INLINE_DECRYPT_PAGES	1
+
+/*
+ * Decrypt every page of the bio with a single cipher request, reusing
+ * the encryption context.
  */
 static void completion_pages(struct work_struct *work)
 {
@@ -57,20 +66,8 @@ static void completion_pages(struct work_struct *work)
 	struct ext4_crypto_ctx *ctx =
 		container_of(work, struct ext4_crypto_ctx, r.work);
 	struct bio	*bio	= ctx->r.bio;
-	struct bio_vec	*bv;
-	int		i;
-
-	bio_for_each_segment_all(bv, bio, i) {
-		struct page *page = bv->bv_page;
 
-		int ret = ext4_decrypt(page);
-		if (ret) {
-			WARN_ON_ONCE(1);
-			SetPageError(page);
-		} else
-			SetPageUptodate(page);
-		unlock_page(page);
-	}
+	ext4_decrypt_bio(bio);
 	ext4_release_crypto_ctx(ctx);
 	bio_put(bio);
 #else
@@ -126,7 +123,15 @@ static void mpage_end_io(struct bio *bio)
 		} else {
 			INIT_WORK(&ctx->r.work, completion_pages);
 			ctx->r.bio = bio;
-			queue_work(ext4_read_workqueue, &ctx->r.work);
+			/*
+			 * ext4_read_workqueue is bound, so the large bios are
+			 * still decrypted on the completing CPU.
+			 */
+			if (bio->bi_vcnt <= EXT4_INLINE_DECRYPT_PAGES &&
+			    preemptible())
+				completion_pages(&ctx->r.work);
+			else
+				queue_work(ext4_read_workqueue, &ctx->r.work);
 			return;
 		}
 	}
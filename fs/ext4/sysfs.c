@@ -371,6 +371,9 @@ static const struct file_operations ext4_seq_##name##_fops = { \
 
 PROC_FILE_SHOW_DEFN(es_shrinker_info);
 PROC_FILE_SHOW_DEFN(options);
+#ifdef CONFIG_EXT4_FS_ENCRYPTION
+PROC_FILE_SHOW_DEFN(crypto_stats);
+#endif
 
 static struct ext4_proc_files {
 	const char *name;
@@ -435,6 +438,11 @@ int __init ext4_init_sysfs(void)
 		kset_unregister(&ext4_kset);
 	else
 		ext4_proc_root = proc_mkdir(proc_dirname, NULL);
+#ifdef CONFIG_EXT4_FS_ENCRYPTION
+	if (ext4_proc_root)
+		proc_create("crypto_stats", S_IRUGO, ext4_proc_root,
+			    &ext4_seq_crypto_stats_fops);
+#endif
 	return ret;
 }
 
@@ -442,6 +450,10 @@ void ext4_exit_sysfs(void)
 {
 	kobject_put(&ext4_feat);
 	kset_unregister(&ext4_kset);
+#ifdef CONFIG_EXT4_FS_ENCRYPTION
+	if (ext4_proc_root)
+		remove_proc_entry("crypto_stats", ext4_proc_root);
+#endif
 	remove_proc_entry(proc_dirname, NULL);
 	ext4_proc_root = NULL;
 }
@@ -161,6 +161,12 @@ struct shash_desc {
  * @export: see struct ahash_alg
  * @import: see struct ahash_alg
  * @setkey: see struct ahash_alg
+ * @finup_mb: Finish up @num_msgs messages of @len bytes at once, each on top
+ *	      of the state in the descriptor, which is left unchanged. Lets
+ *	      the algorithm interleave the messages to make better use of the
+ *	      CPU. Only called with 2 <= @num_msgs <= @mb_max_msgs, may return
+ *	      -EOPNOTSUPP to have the messages hashed one at a time.
+ * @mb_max_msgs: Maximum number of messages @finup_mb takes, 1 without it
  * @digestsize: see struct ahash_alg
  * @statesize: see struct ahash_alg
  * @descsize: Size of the operational state for the message digest. This state
@@ -181,6 +187,10 @@ struct shash_alg {
 	int (*import)(struct shash_desc *desc, const void *in);
 	int (*setkey)(struct crypto_shash *tfm, const u8 *key,
 		      unsigned int keylen);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
+	unsigned int mb_max_msgs;
 
 	unsigned int descsize;
 
@@ -701,6 +711,18 @@ static inline unsigned int crypto_shash_digestsize(struct crypto_shash *tfm)
 	return crypto_shash_alg(tfm)->digestsize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the number of messages hashed at once
+ * @tfm: cipher handle
+ *
+ * Return: the largest number of messages crypto_shash_finup_mb() hashes
+ *	   together, 1 if the algorithm hashes them one at a time
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline unsigned int crypto_shash_statesize(struct crypto_shash *tfm)
 {
 	return crypto_shash_alg(tfm)->statesize;
@@ -872,4 +894,23 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - calculate message digests of several buffers
+ * @desc: operational state handle, left unchanged
+ * @data: the @num_msgs buffers to hash
+ * @len: length of each of the buffers
+ * @outs: the @num_msgs output buffers, see crypto_shash_final()
+ * @num_msgs: number of messages
+ *
+ * Computes crypto_shash_finup() of each buffer on top of the state already
+ * in @desc, such as a salt. Up to crypto_shash_mb_max_msgs() messages are
+ * interleaved by the algorithm, which is faster than hashing them in turn.
+ *
+ * Return: 0 if the message digest creation was successful; < 0 if an error
+ *	   occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 #endif	/* _CRYPTO_HASH_H */
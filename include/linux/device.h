@@ -289,6 +289,7 @@ extern struct device_driver *driver_find(const char *name,
 					 struct bus_type *bus);
 extern int driver_probe_done(void);
 extern void wait_for_device_probe(void);
+extern void driver_deferred_probe_trigger(void);
 
 
 /* sysfs interface for exporting driver attributes */
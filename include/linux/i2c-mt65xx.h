@@ -0,0 +1,53 @@
+/*
+ * i2c-mt65xx.h - batched transfers on MediaTek I2C adapters
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_I2C_MT65XX_H
+#define _LINUX_I2C_MT65XX_H
+
+#include <linux/i2c.h>
+
+/*
+ * Reading two registers of two devices in one window:
+ *
+ *	struct i2c_msg msgs[] = {
+ *		{ .addr = 0x70, .len = 1, .buf = &reg_a },
+ *		{ .addr = 0x70, .flags = I2C_M_RD, .len = 2, .buf = val_a },
+ *		{ .addr = 0x38, .len = 1, .buf = &reg_b },
+ *		{ .addr = 0x38, .flags = I2C_M_RD, .len = 1, .buf = val_b },
+ *	};
+ *	static const u8 nums[] = { 2, 2 };
+ *
+ *	ret = mtk_i2c_transfer_batch(adap, msgs, nums, ARRAY_SIZE(nums));
+ *
+ * Other adapters get one i2c_transfer() per transaction.
+ */
+#if IS_REACHABLE(CONFIG_I2C_MT65XX)
+int mtk_i2c_transfer_batch(struct i2c_adapter *adap, struct i2c_msg *msgs,
+			   const u8 *nums, int nr);
+#else
+static inline int mtk_i2c_transfer_batch(struct i2c_adapter *adap,
+					 struct i2c_msg *msgs,
+					 const u8 *nums, int nr)
+{
+	int i, ret = 0;
+
+	for (i = 0; i < nr; msgs += nums[i++]) {
+		ret = i2c_transfer(adap, msgs, nums[i]);
+		if (ret < 0)
+			break;
+	}
+	return i ? i : ret;
+}
+#endif
+
+#endif /* _LINUX_I2C_MT65XX_H */
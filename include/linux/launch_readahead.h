@@ -0,0 +1,23 @@
+#ifndef _LINUX_LAUNCH_READAHEAD_H
+#define _LINUX_LAUNCH_READAHEAD_H
+
+#include <linux/types.h>
+
+struct file;
+
+#ifdef CONFIG_LAUNCH_READAHEAD
+extern void launch_ra_record(struct file *filp, pgoff_t offset,
+			     unsigned long nr);
+extern void launch_ra_exec(struct file *exe);
+#else
+static inline void launch_ra_record(struct file *filp, pgoff_t offset,
+				    unsigned long nr)
+{
+}
+
+static inline void launch_ra_exec(struct file *exe)
+{
+}
+#endif
+
+#endif /* _LINUX_LAUNCH_READAHEAD_H */
@@ -396,6 +396,25 @@ struct mm_rss_stat {
 };
 
 struct kioctx_table;
+#ifdef CONFIG_MTK_MLOG
+/*
+ * Last per-process sample written by the binary memory log. Owned by the
+ * mlog sampler; dup_mm() copies it, so it is only trusted when @pid
+ * matches the owner.
+ */
+struct mlog_mm_snapshot {
+	pid_t pid;
+	int adj;
+	unsigned int gen;
+	bool emitted;
+	unsigned long rss;
+	unsigned long rswap;
+	unsigned long swap_in;
+	unsigned long swap_out;
+	unsigned long fm_flt;
+};
+#endif
+
 struct mm_struct {
 	struct vm_area_struct *mmap;		/* list of VMAs */
 	struct rb_root mm_rb;
@@ -518,6 +537,13 @@ struct mm_struct {
 #ifdef CONFIG_HUGETLB_PAGE
 	atomic_long_t hugetlb_usage;
 #endif
+#ifdef CONFIG_MTK_MLOG
+	struct mlog_mm_snapshot mlog_snap;
+#endif
+#ifdef CONFIG_WORKINGSET_PROTECT
+	/* 1 + ws_protect class of the owner, 0 if unprotected */
+	unsigned char ws_class;
+#endif
 };
 
 static inline void mm_init_cpumask(struct mm_struct *mm)
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014-2015 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef LINUX_MMC_MTK_SDIO_H
+#define LINUX_MMC_MTK_SDIO_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+struct sdio_func;
+
+#if IS_ENABLED(CONFIG_MMC_MTK_COMM_SDIO)
+/**
+ * sdio_batch_readl() - read several 32-bit registers of a function
+ * @func: SDIO function, on a host driven by mtk-sdio
+ * @addrs: register addresses
+ * @vals: filled with the values read
+ * @n: number of entries in @addrs and @vals
+ *
+ * The accesses run back to back on the polled PIO path of mtk-sdio,
+ * without a request round trip through the mmc core for each of them.
+ * Meant for drivers that poll a handful of status registers at a time.
+ * The caller must have claimed the host with sdio_claim_host().
+ *
+ * Return: 0, the first error met, or -EOPNOTSUPP if @func is not on an
+ * mtk-sdio host.
+ */
+extern int sdio_batch_readl(struct sdio_func *func, const u32 *addrs,
+			    u32 *vals, int n);
+
+/**
+ * sdio_batch_writel() - write several 32-bit registers of a function
+ * @func: SDIO function, on a host driven by mtk-sdio
+ * @addrs: register addresses
+ * @vals: values to write
+ * @n: number of entries in @addrs and @vals
+ *
+ * Same rules as sdio_batch_readl(). The writes stop at the first error.
+ *
+ * Return: 0, the first error met, or -EOPNOTSUPP if @func is not on an
+ * mtk-sdio host.
+ */
+extern int sdio_batch_writel(struct sdio_func *func, const u32 *addrs,
+			     const u32 *vals, int n);
+#else
+static inline int sdio_batch_readl(struct sdio_func *func, const u32 *addrs,
+				   u32 *vals, int n)
+{
+	return -EOPNOTSUPP;
+}
+
+static inline int sdio_batch_writel(struct sdio_func *func, const u32 *addrs,
+				    const u32 *vals, int n)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+#endif /* LINUX_MMC_MTK_SDIO_H */
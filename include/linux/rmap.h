@@ -262,9 +262,27 @@ static inline int page_mkclean(struct page *page)
 	return 0;
 }
 
-
 #endif	/* CONFIG_MMU */
 
+/*
+ * page_referenced() that also returns 1 + the most important working set
+ * protection class of the mms mapping the page, 0 if none is protected.
+ */
+#ifdef CONFIG_WORKINGSET_PROTECT
+int page_referenced_class(struct page *, int is_locked,
+			  struct mem_cgroup *memcg, unsigned long *vm_flags,
+			  unsigned char *ws_class);
+#else
+static inline int page_referenced_class(struct page *page, int is_locked,
+					struct mem_cgroup *memcg,
+					unsigned long *vm_flags,
+					unsigned char *ws_class)
+{
+	*ws_class = 0;
+	return page_referenced(page, is_locked, memcg, vm_flags);
+}
+#endif
+
 /*
  * Return values of try_to_unmap
  */
@@ -424,6 +424,7 @@ struct spi_master {
 #define SPI_MASTER_NO_TX	BIT(2)		/* can't do buffer write */
 #define SPI_MASTER_MUST_RX      BIT(3)		/* requires rx */
 #define SPI_MASTER_MUST_TX      BIT(4)		/* requires tx */
+#define SPI_MASTER_DMA_PREMAPPED BIT(5)	/* honours is_dma_mapped */
 
 	/* lock and mutex for SPI bus locking */
 	spinlock_t		bus_lock_spinlock;
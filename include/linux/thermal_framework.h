@@ -48,6 +48,32 @@ struct thermal_dev_ops {
 	int (*is_temp_in_range)(struct thermal_dev *tdev, bool *temp_in_range);
 };
 
+/**
+ * struct thermal_dev_sample  - Cached reading of a thermal device.
+ * @period_ms: Sampling period, 0 to use the sample_ms module parameter
+ * @temp: Last temperature read, valid when @err is 0
+ * @err: Result of the last read
+ * @stamp: Time of the last read in jiffies
+ * @next: Time the sampler reads the device again in jiffies
+ * @reads: Number of reads done by the sampler
+ * @sync: Number of reads done by virtual zones finding the cache stale
+ * @errors: Number of failed reads
+ * @max_age: Oldest cached value used by a virtual zone, in jiffies
+ * @pass: Last sampler pass that read the device
+ */
+struct thermal_dev_sample {
+	unsigned int period_ms;
+	int temp;
+	int err;
+	unsigned long stamp;
+	unsigned long next;
+	unsigned long reads;
+	unsigned long sync;
+	unsigned long errors;
+	unsigned long max_age;
+	unsigned int pass;
+};
+
 /**
  * struct thermal_dev  - Structure for each thermal device.
  * @name: The name of the device that is registering to the framework
@@ -57,6 +83,7 @@ struct thermal_dev_ops {
  * @node: The list node of the
  * @current_temp: The current temperature reported for the specific domain
  * @vs: The virtual sensor to which thermal sensor links to.
+ * @sample: Reading cached by the virtual sensor sampler.
  *
  */
 struct thermal_dev {
@@ -66,6 +93,7 @@ struct thermal_dev {
 	struct list_head node;
 	int current_temp;
 	int vs;
+	struct thermal_dev_sample sample;
 };
 /**
  * API to register a temperature sensor with a thermal zone
@@ -0,0 +1,80 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mtk_thermal_atm
+
+#if !defined(_TRACE_MTK_THERMAL_ATM_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MTK_THERMAL_ATM_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(thermal_atm_pid,
+
+	TP_PROTO(int tj, int ttj, s32 err, s32 err_integral,
+		 s64 p, s64 i, s64 d, s32 output),
+
+	TP_ARGS(tj, ttj, err, err_integral, p, i, d, output),
+
+	TP_STRUCT__entry(
+		__field(int, tj)
+		__field(int, ttj)
+		__field(s32, err)
+		__field(s32, err_integral)
+		__field(s64, p)
+		__field(s64, i)
+		__field(s64, d)
+		__field(s32, output)
+	),
+
+	TP_fast_assign(
+		__entry->tj = tj;
+		__entry->ttj = ttj;
+		__entry->err = err;
+		__entry->err_integral = err_integral;
+		__entry->p = p;
+		__entry->i = i;
+		__entry->d = d;
+		__entry->output = output;
+	),
+
+	TP_printk("tj=%d ttj=%d err=%d err_integral=%d p=%lld i=%lld d=%lld output=%d",
+		__entry->tj, __entry->ttj, __entry->err, __entry->err_integral,
+		__entry->p, __entry->i, __entry->d, __entry->output)
+);
+
+TRACE_EVENT(thermal_atm_allocate,
+
+	TP_PROTO(u32 budget, u32 cpu_req, u32 gpu_req, u32 cam_req,
+		 u32 cpu_granted, u32 gpu_granted, u32 cam_granted),
+
+	TP_ARGS(budget, cpu_req, gpu_req, cam_req,
+		cpu_granted, gpu_granted, cam_granted),
+
+	TP_STRUCT__entry(
+		__field(u32, budget)
+		__field(u32, cpu_req)
+		__field(u32, gpu_req)
+		__field(u32, cam_req)
+		__field(u32, cpu_granted)
+		__field(u32, gpu_granted)
+		__field(u32, cam_granted)
+	),
+
+	TP_fast_assign(
+		__entry->budget = budget;
+		__entry->cpu_req = cpu_req;
+		__entry->gpu_req = gpu_req;
+		__entry->cam_req = cam_req;
+		__entry->cpu_granted = cpu_granted;
+		__entry->gpu_granted = gpu_granted;
+		__entry->cam_granted = cam_granted;
+	),
+
+	TP_printk("budget=%u req={cpu=%u gpu=%u cam=%u} granted={cpu=%u gpu=%u cam=%u}",
+		__entry->budget, __entry->cpu_req, __entry->gpu_req,
+		__entry->cam_req, __entry->cpu_granted, __entry->gpu_granted,
+		__entry->cam_granted)
+);
+
+#endif /* _TRACE_MTK_THERMAL_ATM_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2016 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#ifndef _UAPI_LINUX_ATF_LOG_H
+#define _UAPI_LINUX_ATF_LOG_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+ * mmap() reader protocol of /dev/atf_log
+ *
+ * The reserved region is mapped read-only: offset 0 holds the ATF log
+ * control block and the log ring follows at ATF_LOG_IOC_INFO's
+ * data_offset. A reader poll()s for POLLIN, parses the ring between the
+ * read and write positions of the control block (both physical
+ * addresses, see pos_base) in place and then hands the consumed byte
+ * count back with ATF_LOG_IOC_CONSUME so that ATF may reuse the space.
+ */
+struct atf_log_mmap_info {
+	__u32 data_offset;
+	__u32 data_size;
+	__u64 pos_base;
+};
+
+#define ATF_LOG_IOC_MAGIC	'A'
+#define ATF_LOG_IOC_INFO	_IOR(ATF_LOG_IOC_MAGIC, 1, struct atf_log_mmap_info)
+#define ATF_LOG_IOC_CONSUME	_IO(ATF_LOG_IOC_MAGIC, 2)
+
+#endif /* _UAPI_LINUX_ATF_LOG_H */
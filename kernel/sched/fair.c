@@ -2854,6 +2854,9 @@ static inline void update_load_avg(struct sched_entity *se, int update_tg)
 	long old_loadwop_avg = se->avg.loadwop_avg, loadwop_avg_delta;
 	unsigned long runnable_delta = 0;
 	unsigned long prev_load;
+#ifdef CONFIG_MTK_SCHED_RQAVG_US
+	unsigned long prev_heavy_load = se->avg.load_avg;
+#endif
 	int on_rq_task = entity_is_task(se) && se->on_rq;
 
 	if (on_rq_task) {
@@ -2876,8 +2879,10 @@ static inline void update_load_avg(struct sched_entity *se, int update_tg)
 	}
 
 #ifdef CONFIG_MTK_SCHED_RQAVG_US
-	if (entity_is_task(se) && se->on_rq)
+	if (on_rq_task) {
 		inc_nr_heavy_running("__update_load_avg+", task_of(se), 1, false);
+		sched_heavy_task_update(task_of(se), prev_heavy_load);
+	}
 #endif
 
 	if (update_cfs_rq_load_avg(now, cfs_rq) && update_tg)
@@ -4415,6 +4420,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 #endif
 #ifdef CONFIG_MTK_SCHED_RQAVG_US
 		inc_nr_heavy_running(__func__, p, 1, false);
+		sched_heavy_task_enqueue(p, 1);
 #endif
 	}
 
@@ -4504,6 +4510,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 #endif
 #ifdef CONFIG_MTK_SCHED_RQAVG_US
 		inc_nr_heavy_running(__func__, p, -1, false);
+		sched_heavy_task_enqueue(p, -1);
 #endif
 	}
 
@@ -4956,6 +4963,10 @@ static inline bool energy_aware(void)
 {
 #ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
 	return is_eas_enabled() && sched_feat(ENERGY_AWARE);
+#elif defined(CONFIG_MTK_CPU_ENERGY_MODEL)
+	/* the static tables describe another SoC, wait for the real model */
+	return static_branch_unlikely(&arch_cpu_energy_key) &&
+	       sched_feat(ENERGY_AWARE);
 #else
 	return sched_feat(ENERGY_AWARE);
 #endif
@@ -5004,12 +5015,13 @@ int calc_util_delta(struct energy_env *eenv, int cpu)
 }
 
 static
-unsigned long group_max_util(struct energy_env *eenv)
+unsigned long group_max_util(struct energy_env *eenv,
+			     const struct cpumask *cap_cpus)
 {
 	int i, delta;
 	unsigned long max_util = 0;
 
-	for_each_cpu(i, sched_group_cpus(eenv->sg_cap)) {
+	for_each_cpu(i, cap_cpus) {
 		delta = calc_util_delta(eenv, i);
 		max_util = max(max_util, __cpu_util(i, delta));
 		mt_sched_printf(sched_eas_energy_calc, "%s: cpu=%d cpu_util=%d task_delta=%d",
@@ -5049,10 +5061,11 @@ long group_norm_util(struct energy_env *eenv, struct sched_group *sg)
 }
 
 static int find_new_capacity(struct energy_env *eenv,
-	const struct sched_group_energy *const sge)
+	const struct sched_group_energy *const sge,
+	const struct cpumask *cap_cpus)
 {
 	int idx;
-	unsigned long util = group_max_util(eenv);
+	unsigned long util = group_max_util(eenv, cap_cpus);
 	unsigned long new_capacity = util;
 
 #ifdef CONFIG_CPU_FREQ_GOV_SCHED
@@ -5065,6 +5078,10 @@ static int find_new_capacity(struct energy_env *eenv,
 			break;
 	}
 
+	/* Saturate at the highest OPP rather than index past the table */
+	if (idx >= sge->nr_cap_states)
+		idx = sge->nr_cap_states - 1;
+
 	eenv->cap_idx = idx;
 
 	return idx;
@@ -5110,6 +5127,7 @@ static int sched_group_energy(struct energy_env *eenv)
 
 	while (!cpumask_empty(&visit_cpus)) {
 		struct sched_group *sg_shared_cap = NULL;
+		const struct cpumask *shared_span = NULL;
 
 		cpu = cpumask_first(&visit_cpus);
 
@@ -5146,6 +5164,13 @@ static int sched_group_energy(struct energy_env *eenv)
 
 		if (sd->parent)
 			sg_shared_cap = sd->parent->groups;
+		else if (sd->flags & SD_SHARE_CAP_STATES)
+			/*
+			 * Single frequency domain (e.g. one cluster): there is
+			 * no parent group, but the OPP is still set by the
+			 * busiest cpu of the whole domain.
+			 */
+			shared_span = sched_domain_span(sd);
 
 		for_each_domain(cpu, sd) {
 			sg = sd->groups;
@@ -5164,7 +5189,9 @@ static int sched_group_energy(struct energy_env *eenv)
 				else
 					eenv->sg_cap = sg;
 
-				cap_idx = find_new_capacity(eenv, sg->sge);
+				cap_idx = find_new_capacity(eenv, sg->sge,
+						shared_span ? shared_span :
+						sched_group_cpus(eenv->sg_cap));
 
 				if (sg->group_weight == 1) {
 					/* Remove capacity of src CPU (before task move) */
@@ -5408,6 +5435,7 @@ static int energy_diff(struct energy_env *eenv)
 	struct sched_group *sg;
 	int sd_cpu = -1, energy_before = 0, energy_after = 0;
 	int result;
+	bool single_fd;
 	struct energy_env eenv_before = {
 		.util_delta	= 0,
 		.src_cpu	= eenv->src_cpu,
@@ -5445,10 +5473,17 @@ static int energy_diff(struct energy_env *eenv)
 	mt_sched_printf(sched_eas_energy_calc, "0. %s: move task from src=%d to dst=%d util=%d",
 				__func__, eenv->src_cpu, eenv->dst_cpu, eenv->util_delta);
 
+	/*
+	 * When all cpus share one frequency domain, moving utilization can
+	 * change the OPP of every cpu, not only of src and dst.
+	 */
+	single_fd = !sd->parent && (sd->flags & SD_SHARE_CAP_STATES);
+
 	sg = sd->groups;
 
 	do {
-		if (cpu_in_sg(sg, eenv->src_cpu) || cpu_in_sg(sg, eenv->dst_cpu)) {
+		if (single_fd ||
+		    cpu_in_sg(sg, eenv->src_cpu) || cpu_in_sg(sg, eenv->dst_cpu)) {
 			eenv_before.sg_top = eenv->sg_top = sg;
 
 			mt_sched_printf(sched_eas_energy_calc, "1. %s: src=%d dst=%d mask=0x%lx (before)",
@@ -5792,6 +5827,7 @@ static int energy_aware_wake_cpu(struct task_struct *p, int target)
 	unsigned long new_util;
 	int i;
 	bool is_tiny = false;
+	bool single_fd;
 	int nrg_diff = 0;
 
 	sd = rcu_dereference(per_cpu(sd_ea, task_cpu(p)));
@@ -5799,6 +5835,14 @@ static int energy_aware_wake_cpu(struct task_struct *p, int target)
 	if (!sd)
 		return target;
 
+	/*
+	 * With a single frequency domain there is no smaller cluster to
+	 * steer to; the choice is between packing on a cpu that already runs
+	 * at a sufficient OPP and waking another one, which the energy model
+	 * arbitrates below.
+	 */
+	single_fd = !sd->parent && (sd->flags & SD_SHARE_CAP_STATES);
+
 	sg = sd->groups;
 	sg_target = sg;
 
@@ -5830,10 +5874,11 @@ static int energy_aware_wake_cpu(struct task_struct *p, int target)
 
 	/* Find cpu with sufficient capacity */
 	min_util = boosted_task_util(p);
-	if (!is_tiny || !sd->child)
+	if (!single_fd && (!is_tiny || !sd->child))
 		target_cpu = select_max_spare_capacity_cpu(p, group_first_cpu(sg_target));
 	else
-		for_each_cpu_and(i, tsk_cpus_allowed(p), sched_group_cpus(sg_target)) {
+		for_each_cpu_and(i, tsk_cpus_allowed(p), single_fd ?
+				 sched_domain_span(sd) : sched_group_cpus(sg_target)) {
 
 			if (!cpu_online(i))
 				continue;
@@ -5871,7 +5916,7 @@ static int energy_aware_wake_cpu(struct task_struct *p, int target)
 		}
 
 	/* no need energy calculation if the same domain */
-	if (is_the_same_domain(task_cpu(p), target_cpu))
+	if (!single_fd && is_the_same_domain(task_cpu(p), target_cpu))
 		return target_cpu;
 
 	/* no energy comparison if the same cluster */
@@ -81,9 +81,10 @@ SCHED_FEAT(SCHED_HMP, false)
 
 /*
  * Energy aware scheduling. Use platform energy model to guide scheduling
- * decisions optimizing for energy efficiency.
+ * decisions optimizing for energy efficiency. With CONFIG_MTK_CPU_ENERGY_MODEL
+ * it only takes effect once the platform has registered its model.
  */
-#ifdef CONFIG_MTK_SCHED_EAS_PLUS
+#if defined(CONFIG_MTK_SCHED_EAS_PLUS) || defined(CONFIG_MTK_CPU_ENERGY_MODEL)
 SCHED_FEAT(ENERGY_AWARE, true)
 #else
 SCHED_FEAT(ENERGY_AWARE, false)
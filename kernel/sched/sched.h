@@ -1371,6 +1371,8 @@ extern void sched_max_util_task(int *cpu, int *pid, int *util, int *boost);
 
 #ifdef CONFIG_MTK_SCHED_RQAVG_US
 extern int inc_nr_heavy_running(const char *invoker, struct task_struct *p, int inc, bool ack_cap);
+extern void sched_heavy_task_enqueue(struct task_struct *p, int inc);
+extern void sched_heavy_task_update(struct task_struct *p, unsigned long prev_load);
 #endif
 
 extern void init_max_cpu_capacity(struct max_cpu_capacity *mcc);
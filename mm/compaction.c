@@ -17,6 +17,9 @@
 #include <linux/balloon_compaction.h>
 #include <linux/page-isolation.h>
 #include <linux/kasan.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/timer.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -1182,6 +1185,9 @@ static inline bool is_via_compact_memory(int order)
 	return order == -1;
 }
 
+static unsigned int fragmentation_score_zone(struct zone *zone,
+					     unsigned int order);
+
 static int __compact_finished(struct zone *zone, struct compact_control *cc,
 			    const int migratetype)
 {
@@ -1208,6 +1214,15 @@ static int __compact_finished(struct zone *zone, struct compact_control *cc,
 		return COMPACT_COMPLETE;
 	}
 
+	if (cc->proactive) {
+		if (time_after(jiffies, cc->deadline) ||
+		    fragmentation_score_zone(zone,
+				sysctl_compaction_proactive_order) <=
+		    cc->score_target)
+			return COMPACT_PARTIAL;
+		return COMPACT_CONTINUE;
+	}
+
 	if (is_via_compact_memory(cc->order))
 		return COMPACT_CONTINUE;
 
@@ -1692,6 +1707,205 @@ static void compact_nodes(void)
 		compact_node(nid);
 }
 
+/*
+ * Proactive compaction.
+ *
+ * The fragmentation score of a zone is the percentage of its free memory
+ * that sits in blocks smaller than sysctl_compaction_proactive_order.
+ * Every sysctl_compaction_proactive_interval ms kcompactd compacts the
+ * zones scoring above 100 - sysctl_compaction_proactiveness, until the
+ * score drops COMPACTION_PROACTIVE_HYST points below that or the time
+ * slice runs out. The slice is sysctl_compaction_proactive_budget percent
+ * of the interval, which bounds the CPU kcompactd takes. A pass that does
+ * not lower the score doubles the interval, up to 1 << COMPACT_MAX_DEFER_SHIFT.
+ * The per-cpu LRU caches are only drained once some zone needs compacting.
+ */
+int sysctl_compaction_proactiveness = 20;
+int sysctl_compaction_proactive_order = 4;
+int sysctl_compaction_proactive_interval = 500;
+int sysctl_compaction_proactive_budget = 5;
+
+#define COMPACTION_PROACTIVE_HYST	10
+
+static struct task_struct *kcompactd;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+/* Set when the sysctls change, so kcompactd does not sit out its interval */
+static bool kcompactd_kick;
+
+static unsigned int fragmentation_score_zone(struct zone *zone,
+					     unsigned int order)
+{
+	unsigned long free = 0, suitable = 0;
+	unsigned int o;
+
+	for (o = 0; o < MAX_ORDER; o++) {
+		unsigned long pages = zone->free_area[o].nr_free << o;
+
+		free += pages;
+		if (o >= order)
+			suitable += pages;
+	}
+	if (!free)
+		return 0;
+
+	return (free - suitable) * 100 / free;
+}
+
+static bool proactive_compaction_suitable(struct zone *zone,
+					  unsigned int order,
+					  unsigned int wmark)
+{
+	int fragindex;
+
+	if (!populated_zone(zone) ||
+	    fragmentation_score_zone(zone, order) <= wmark)
+		return false;
+
+	/* Migration needs free order-0 pages, that is reclaim's job */
+	if (!zone_watermark_ok(zone, 0, low_wmark_pages(zone) + (2UL << order),
+			       0, 0))
+		return false;
+
+	/* A failure at this order would be due to low memory, not fragmentation */
+	fragindex = fragmentation_index(zone, order);
+	if (fragindex >= 0 && fragindex <= sysctl_extfrag_threshold)
+		return false;
+
+	return true;
+}
+
+static bool proactive_compaction_needed(void)
+{
+	unsigned int order = sysctl_compaction_proactive_order;
+	unsigned int wmark = 100 - sysctl_compaction_proactiveness;
+	struct zone *zone;
+
+	for_each_zone(zone)
+		if (proactive_compaction_suitable(zone, order, wmark))
+			return true;
+
+	return false;
+}
+
+/* Returns true if every zone compacted got under its target */
+static bool proactive_compact_nodes(unsigned long deadline)
+{
+	unsigned int order = sysctl_compaction_proactive_order;
+	unsigned int wmark = 100 - sysctl_compaction_proactiveness;
+	bool done = true;
+	struct zone *zone;
+
+	for_each_zone(zone) {
+		struct compact_control cc = {
+			.order = -1,
+			.mode = MIGRATE_SYNC_LIGHT,
+			.zone = zone,
+			.proactive = true,
+			.score_target = wmark > COMPACTION_PROACTIVE_HYST ?
+					wmark - COMPACTION_PROACTIVE_HYST : 0,
+			.deadline = deadline,
+		};
+
+		if (!proactive_compaction_suitable(zone, order, wmark))
+			continue;
+		if (time_after(jiffies, deadline)) {
+			done = false;
+			break;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		compact_zone(zone, &cc);
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (fragmentation_score_zone(zone, order) > cc.score_target)
+			done = false;
+	}
+
+	return done;
+}
+
+static void kcompactd_timeout(unsigned long data)
+{
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+static int kcompactd_fn(void *unused)
+{
+	unsigned int backoff = 0;
+	struct timer_list timer;
+
+	set_freezable();
+	set_user_nice(current, MAX_NICE);
+	/* Deferrable, an idle system is not woken up just to be checked */
+	setup_deferrable_timer_on_stack(&timer, kcompactd_timeout, 0);
+
+	while (!kthread_should_stop()) {
+		unsigned long interval =
+			msecs_to_jiffies(sysctl_compaction_proactive_interval);
+		unsigned long slice;
+
+		mod_timer(&timer, jiffies + (interval << backoff));
+		wait_event_freezable(kcompactd_wait,
+				kthread_should_stop() || !timer_pending(&timer) ||
+				READ_ONCE(kcompactd_kick));
+		if (kthread_should_stop())
+			break;
+		if (xchg(&kcompactd_kick, false))
+			backoff = 0;
+		if (!sysctl_compaction_proactiveness)
+			continue;
+		if (!proactive_compaction_needed()) {
+			backoff = 0;
+			continue;
+		}
+
+		slice = max(interval * sysctl_compaction_proactive_budget / 100,
+			    1UL);
+		count_compact_event(COMPACTPROACTIVE_RUN);
+		/* Flush pending updates to the LRU lists */
+		lru_add_drain_all();
+		if (proactive_compact_nodes(jiffies + slice)) {
+			count_compact_event(COMPACTPROACTIVE_SUCCESS);
+			backoff = 0;
+		} else if (backoff < COMPACT_MAX_DEFER_SHIFT) {
+			count_compact_event(COMPACTPROACTIVE_BACKOFF);
+			backoff++;
+		}
+	}
+
+	del_timer_sync(&timer);
+	destroy_timer_on_stack(&timer);
+
+	return 0;
+}
+
+int sysctl_compaction_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!ret && write) {
+		WRITE_ONCE(kcompactd_kick, true);
+		wake_up_interruptible(&kcompactd_wait);
+	}
+
+	return ret;
+}
+
+static int __init kcompactd_init(void)
+{
+	kcompactd = kthread_run(kcompactd_fn, NULL, "kcompactd");
+	if (IS_ERR(kcompactd)) {
+		pr_err("Failed to start kcompactd\n");
+		kcompactd = NULL;
+	}
+	return 0;
+}
+subsys_initcall(kcompactd_init);
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
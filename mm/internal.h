@@ -228,6 +228,9 @@ struct compact_control {
 					 * contention detected during
 					 * compaction
 					 */
+	bool proactive;			/* kcompactd background compaction */
+	unsigned int score_target;	/* proactive: stop at this score */
+	unsigned long deadline;		/* proactive: stop at this jiffy */
 };
 
 unsigned long
@@ -475,4 +478,18 @@ static inline void try_to_unmap_flush_dirty(void)
 }
 
 #endif /* CONFIG_ARCH_WANT_BATCHED_UNMAP_TLB_FLUSH */
+
+#ifdef CONFIG_WORKINGSET_PROTECT
+bool ws_protect_page(struct page *page, unsigned char ws_class, int priority);
+void ws_protect_refault(bool activate);
+#else
+static inline bool ws_protect_page(struct page *page, unsigned char ws_class,
+				   int priority)
+{
+	return false;
+}
+static inline void ws_protect_refault(bool activate)
+{
+}
+#endif /* CONFIG_WORKINGSET_PROTECT */
 #endif	/* __MM_INTERNAL_H */
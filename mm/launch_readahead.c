@@ -0,0 +1,701 @@
+/*
+ * mm/launch_readahead.c
+ *
+ * Launch readahead profiles
+ *
+ * For record_ms after a program is launched, the page cache misses of its
+ * thread group are recorded as (file, page range) extents. The extents are
+ * then sorted by file and offset, merged across small holes and kept as
+ * the profile of that program. When it is launched again, the profile is
+ * replayed from a workqueue as a few large readahead requests, ahead of
+ * the scattered small reads the program would otherwise issue. The misses
+ * of that launch are folded back into the profile, and the extents it did
+ * not touch at all are dropped from it.
+ *
+ * A program is identified by its executable when exec tracking is on, or
+ * by a name given by userspace for processes that do not exec, such as
+ * Android apps forked from zygote. /sys/kernel/debug/launch_ra/control
+ * takes
+ *
+ *   launch <pid> <name>	replay <name> if known, record and refine it
+ *   record <pid> <name>	record <name> from scratch
+ *   drop <name>		forget one profile
+ *   clear			forget all of them
+ *
+ * Profiles keep the path and inode of each of their files rather than a
+ * reference, so they do not pin deleted files or keep filesystems from
+ * being unmounted. The files are reopened for a replay and closed once the
+ * launch is over, those replaced since they were recorded are skipped.
+ */
+
+#include <linux/dcache.h>
+#include <linux/debugfs.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/launch_readahead.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/pagemap.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+
+#include "internal.h"
+
+#define LRA_NAME_LEN		64
+#define LRA_MAX_FILES		256
+#define LRA_MAX_EXTENTS		4096
+#define LRA_MAX_PROFILES	32
+#define LRA_MAX_SESSIONS	4
+/* holes of up to this many pages are read too, to merge their neighbours */
+#define LRA_MERGE_GAP		8
+/* 2MB per request, as force_page_cache_readahead() does */
+#define LRA_CHUNK_PAGES		((2 * 1024 * 1024) / PAGE_CACHE_SIZE)
+
+struct lra_extent {
+	u32 start;
+	u32 nr;
+	u16 file;
+	bool used;
+};
+
+struct lra_file {
+	dev_t dev;
+	unsigned long ino;
+	u32 gen;
+	char *path;
+};
+
+struct lra_stats {
+	unsigned long launches;
+	unsigned long replay_io;	/* pages read by replays */
+	unsigned long replay_cached;	/* pages replays found cached */
+	unsigned long miss;		/* pages still missed after a replay */
+	unsigned long wasted;		/* replayed pages left untouched */
+};
+
+struct lra_profile {
+	struct list_head list;
+	char name[LRA_NAME_LEN];
+	struct lra_file files[LRA_MAX_FILES];
+	unsigned int nr_files;
+	struct file **open;		/* files reopened for a replay */
+	struct lra_extent *ext;
+	unsigned int nr_ext;
+	unsigned long pages;
+	struct lra_stats st;
+};
+
+struct lra_session {
+	pid_t tgid;
+	struct lra_profile *rec;	/* misses of this launch */
+	struct lra_profile *replayed;	/* checked out of lra_profiles */
+	struct work_struct replay_work;
+	struct delayed_work done_work;
+};
+
+static u32 lra_enable = 1;
+static u32 lra_exec;
+static u32 lra_record_ms = 5000;
+
+/* lra_mutex protects the profile list, lra_lock the recording sessions */
+static DEFINE_MUTEX(lra_mutex);
+static LIST_HEAD(lra_profiles);
+static unsigned int lra_nr_profiles;
+
+static DEFINE_SPINLOCK(lra_lock);
+static struct lra_session *lra_sessions[LRA_MAX_SESSIONS];
+static atomic_t lra_active = ATOMIC_INIT(0);
+
+static struct lra_profile *lra_alloc_profile(const char *name)
+{
+	struct lra_profile *p;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return NULL;
+
+	p->ext = vmalloc(LRA_MAX_EXTENTS * sizeof(*p->ext));
+	if (!p->ext) {
+		kfree(p);
+		return NULL;
+	}
+	strlcpy(p->name, name, sizeof(p->name));
+	return p;
+}
+
+static void lra_close_files(struct lra_profile *p)
+{
+	unsigned int i;
+
+	if (!p->open)
+		return;
+
+	for (i = 0; i < p->nr_files; i++)
+		if (p->open[i])
+			fput(p->open[i]);
+	kfree(p->open);
+	p->open = NULL;
+}
+
+static void lra_free_profile(struct lra_profile *p)
+{
+	unsigned int i;
+
+	lra_close_files(p);
+	for (i = 0; i < p->nr_files; i++)
+		kfree(p->files[i].path);
+	kvfree(p->ext);
+	kfree(p);
+}
+
+static int lra_find_file(struct lra_profile *p, dev_t dev, unsigned long ino)
+{
+	unsigned int i;
+
+	/* newest first, launches tend to stay on a file for a while */
+	for (i = p->nr_files; i-- > 0; )
+		if (p->files[i].ino == ino && p->files[i].dev == dev)
+			return i;
+	return -1;
+}
+
+/* Takes over @path on success */
+static int lra_new_file(struct lra_profile *p, dev_t dev, unsigned long ino,
+			u32 gen, char *path)
+{
+	struct lra_file *f;
+
+	if (p->nr_files == LRA_MAX_FILES)
+		return -1;
+
+	f = &p->files[p->nr_files];
+	f->dev = dev;
+	f->ino = ino;
+	f->gen = gen;
+	f->path = path;
+	return p->nr_files++;
+}
+
+/* Called under lra_lock */
+static int lra_record_file(struct lra_profile *p, struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+	char *buf, *path;
+	int f;
+
+	f = lra_find_file(p, inode->i_sb->s_dev, inode->i_ino);
+	if (f >= 0 || p->nr_files == LRA_MAX_FILES)
+		return f;
+	if (d_unlinked(filp->f_path.dentry))
+		return -1;
+
+	buf = kmalloc(PATH_MAX, GFP_ATOMIC | __GFP_NOWARN);
+	if (!buf)
+		return -1;
+	path = d_path(&filp->f_path, buf, PATH_MAX);
+	path = IS_ERR(path) ? NULL : kstrdup(path, GFP_ATOMIC | __GFP_NOWARN);
+	kfree(buf);
+	if (!path)
+		return -1;
+
+	f = lra_new_file(p, inode->i_sb->s_dev, inode->i_ino,
+			 inode->i_generation, path);
+	if (f < 0)
+		kfree(path);
+	return f;
+}
+
+static int lra_copy_file(struct lra_profile *p, const struct lra_file *from)
+{
+	char *path;
+	int f;
+
+	f = lra_find_file(p, from->dev, from->ino);
+	if (f >= 0 || p->nr_files == LRA_MAX_FILES)
+		return f;
+
+	path = kstrdup(from->path, GFP_KERNEL);
+	if (!path)
+		return -1;
+
+	f = lra_new_file(p, from->dev, from->ino, from->gen, path);
+	if (f < 0)
+		kfree(path);
+	return f;
+}
+
+/* Reopens the files of a profile by path, skipping the replaced ones */
+static void lra_open_files(struct lra_profile *p)
+{
+	unsigned int i;
+
+	p->open = kcalloc(p->nr_files, sizeof(*p->open), GFP_KERNEL);
+	if (!p->open)
+		return;
+
+	for (i = 0; i < p->nr_files; i++) {
+		struct lra_file *f = &p->files[i];
+		struct file *filp;
+		struct inode *inode;
+
+		filp = filp_open(f->path, O_RDONLY | O_LARGEFILE, 0);
+		if (IS_ERR(filp))
+			continue;
+
+		inode = file_inode(filp);
+		/* the program was updated since it was recorded */
+		if (inode->i_sb->s_dev != f->dev || inode->i_ino != f->ino ||
+		    inode->i_generation != f->gen) {
+			fput(filp);
+			continue;
+		}
+		p->open[i] = filp;
+	}
+}
+
+static void lra_add(struct lra_profile *p, int f, pgoff_t offset,
+		    unsigned long nr)
+{
+	struct lra_extent *e;
+
+	if (p->nr_ext == LRA_MAX_EXTENTS || f < 0)
+		return;
+
+	p->pages += nr;
+	e = p->nr_ext ? &p->ext[p->nr_ext - 1] : NULL;
+	if (e && e->file == f && offset >= e->start &&
+	    offset <= e->start + e->nr) {
+		e->nr = max_t(u32, e->nr, offset + nr - e->start);
+		return;
+	}
+
+	e = &p->ext[p->nr_ext++];
+	e->file = f;
+	e->start = offset;
+	e->nr = nr;
+	e->used = true;
+}
+
+static int lra_ext_cmp(const void *a, const void *b)
+{
+	const struct lra_extent *x = a, *y = b;
+
+	if (x->file != y->file)
+		return x->file - y->file;
+	if (x->start != y->start)
+		return x->start < y->start ? -1 : 1;
+	return 0;
+}
+
+/* Sort and merge the extents, then trim the array to size */
+static void lra_compact(struct lra_profile *p)
+{
+	struct lra_extent *out, *ext;
+	unsigned int i;
+
+	if (!p->nr_ext)
+		return;
+
+	sort(p->ext, p->nr_ext, sizeof(*p->ext), lra_ext_cmp, NULL);
+
+	out = p->ext;
+	for (i = 1; i < p->nr_ext; i++) {
+		struct lra_extent *e = &p->ext[i];
+
+		if (e->file == out->file &&
+		    e->start <= out->start + out->nr + LRA_MERGE_GAP) {
+			out->nr = max(out->nr, e->start + e->nr - out->start);
+			continue;
+		}
+		*++out = *e;
+	}
+	p->nr_ext = out - p->ext + 1;
+
+	p->pages = 0;
+	for (i = 0; i < p->nr_ext; i++)
+		p->pages += p->ext[i].nr;
+
+	ext = kmalloc_array(p->nr_ext, sizeof(*ext), GFP_KERNEL | __GFP_NOWARN);
+	if (ext) {
+		memcpy(ext, p->ext, p->nr_ext * sizeof(*ext));
+		vfree(p->ext);
+		p->ext = ext;
+	}
+}
+
+static void lra_replay(struct lra_profile *p)
+{
+	unsigned int i;
+
+	lra_open_files(p);
+	if (!p->open)
+		return;
+
+	for (i = 0; i < p->nr_ext; i++) {
+		struct lra_extent *e = &p->ext[i];
+		struct file *filp = p->open[e->file];
+		pgoff_t index = e->start, end = e->start + e->nr;
+
+		if (!filp)
+			continue;
+
+		while (index < end) {
+			unsigned long nr = min_t(unsigned long, end - index,
+						 LRA_CHUNK_PAGES);
+			int ret;
+
+			ret = __do_page_cache_readahead(filp->f_mapping, filp,
+							index, nr, 0);
+			if (ret < 0)
+				break;
+			p->st.replay_io += ret;
+			p->st.replay_cached += nr - ret;
+			index += nr;
+		}
+		cond_resched();
+	}
+}
+
+/*
+ * Marks the extents the launch used and returns the number of replayed
+ * pages it never read nor mapped.
+ */
+static unsigned long lra_scan_unused(struct lra_profile *p)
+{
+	unsigned long wasted = 0;
+	unsigned int i;
+
+	for (i = 0; i < p->nr_ext; i++) {
+		struct lra_extent *e = &p->ext[i];
+		struct address_space *mapping;
+		pgoff_t index;
+
+		e->used = false;
+		if (!p->open || !p->open[e->file])
+			continue;
+		mapping = p->open[e->file]->f_mapping;
+		for (index = e->start; index < e->start + e->nr; index++) {
+			struct page *page = find_get_page(mapping, index);
+
+			if (!page)
+				continue;
+			if (PageReferenced(page) || page_mapped(page))
+				e->used = true;
+			else
+				wasted++;
+			page_cache_release(page);
+		}
+		cond_resched();
+	}
+	return wasted;
+}
+
+static struct lra_profile *lra_find_profile(const char *name)
+{
+	struct lra_profile *p;
+
+	list_for_each_entry(p, &lra_profiles, list)
+		if (!strcmp(p->name, name))
+			return p;
+	return NULL;
+}
+
+static void lra_insert(struct lra_profile *p)
+{
+	struct lra_profile *old;
+
+	mutex_lock(&lra_mutex);
+	old = lra_find_profile(p->name);
+	if (old) {
+		list_del(&old->list);
+		lra_nr_profiles--;
+	} else if (lra_nr_profiles == LRA_MAX_PROFILES) {
+		/* least recently launched */
+		old = list_last_entry(&lra_profiles, struct lra_profile, list);
+		list_del(&old->list);
+		lra_nr_profiles--;
+	}
+	list_add(&p->list, &lra_profiles);
+	lra_nr_profiles++;
+	mutex_unlock(&lra_mutex);
+
+	if (old)
+		lra_free_profile(old);
+}
+
+static void lra_replay_fn(struct work_struct *work)
+{
+	struct lra_session *s = container_of(work, struct lra_session,
+					     replay_work);
+
+	lra_replay(s->replayed);
+}
+
+static void lra_done_fn(struct work_struct *work)
+{
+	struct lra_session *s = container_of(to_delayed_work(work),
+					     struct lra_session, done_work);
+	struct lra_profile *p = s->rec, *old = s->replayed;
+	unsigned int i;
+
+	spin_lock(&lra_lock);
+	for (i = 0; i < LRA_MAX_SESSIONS; i++)
+		if (lra_sessions[i] == s)
+			lra_sessions[i] = NULL;
+	atomic_dec(&lra_active);
+	spin_unlock(&lra_lock);
+
+	if (old) {
+		flush_work(&s->replay_work);
+		p->st = old->st;
+		p->st.wasted += lra_scan_unused(old);
+		p->st.miss += p->pages;
+		for (i = 0; i < old->nr_ext; i++) {
+			struct lra_extent *e = &old->ext[i];
+
+			if (e->used)
+				lra_add(p, lra_copy_file(p,
+						&old->files[e->file]),
+					e->start, e->nr);
+		}
+		lra_free_profile(old);
+	}
+
+	lra_compact(p);
+	if (p->nr_ext)
+		lra_insert(p);
+	else
+		lra_free_profile(p);
+	kfree(s);
+}
+
+static int lra_start(pid_t tgid, const char *name, bool replay)
+{
+	struct lra_session *s;
+	struct lra_profile *old;
+	int i, slot = -1;
+
+	if (!lra_enable)
+		return -EPERM;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+	s->rec = lra_alloc_profile(name);
+	if (!s->rec) {
+		kfree(s);
+		return -ENOMEM;
+	}
+	s->tgid = tgid;
+	INIT_WORK(&s->replay_work, lra_replay_fn);
+	INIT_DELAYED_WORK(&s->done_work, lra_done_fn);
+
+	spin_lock(&lra_lock);
+	for (i = 0; i < LRA_MAX_SESSIONS; i++) {
+		if (lra_sessions[i] && lra_sessions[i]->tgid == tgid) {
+			slot = -1;
+			break;
+		}
+		if (!lra_sessions[i] && slot < 0)
+			slot = i;
+	}
+	if (slot >= 0) {
+		lra_sessions[slot] = s;
+		atomic_inc(&lra_active);
+	}
+	spin_unlock(&lra_lock);
+
+	if (slot < 0) {
+		lra_free_profile(s->rec);
+		kfree(s);
+		return -EBUSY;
+	}
+
+	/* the session owns the profile until the launch is over */
+	mutex_lock(&lra_mutex);
+	old = lra_find_profile(name);
+	if (old) {
+		list_del(&old->list);
+		lra_nr_profiles--;
+	}
+	mutex_unlock(&lra_mutex);
+
+	if (old && !replay) {
+		lra_free_profile(old);
+		old = NULL;
+	}
+	if (old) {
+		old->st.launches++;
+		s->replayed = old;
+		queue_work(system_unbound_wq, &s->replay_work);
+	}
+	queue_delayed_work(system_unbound_wq, &s->done_work,
+			   msecs_to_jiffies(lra_record_ms));
+	return 0;
+}
+
+static int lra_drop(const char *name)
+{
+	struct lra_profile *p, *tmp;
+	LIST_HEAD(drop);
+
+	mutex_lock(&lra_mutex);
+	list_for_each_entry_safe(p, tmp, &lra_profiles, list) {
+		if (name && strcmp(p->name, name))
+			continue;
+		list_move(&p->list, &drop);
+		lra_nr_profiles--;
+	}
+	mutex_unlock(&lra_mutex);
+
+	if (name && list_empty(&drop))
+		return -ENOENT;
+
+	list_for_each_entry_safe(p, tmp, &drop, list)
+		lra_free_profile(p);
+	return 0;
+}
+
+/* Called with the page range about to be read for a page cache miss */
+void launch_ra_record(struct file *filp, pgoff_t offset, unsigned long nr)
+{
+	struct lra_session *s;
+	int i;
+
+	if (!atomic_read(&lra_active) || !filp ||
+	    !S_ISREG(file_inode(filp)->i_mode))
+		return;
+
+	spin_lock(&lra_lock);
+	for (i = 0; i < LRA_MAX_SESSIONS; i++) {
+		s = lra_sessions[i];
+		if (s && s->tgid == current->tgid) {
+			lra_add(s->rec, lra_record_file(s->rec, filp), offset,
+				nr);
+			break;
+		}
+	}
+	spin_unlock(&lra_lock);
+}
+
+void launch_ra_exec(struct file *exe)
+{
+	struct inode *inode = file_inode(exe);
+	char name[LRA_NAME_LEN];
+
+	if (!lra_exec)
+		return;
+
+	snprintf(name, sizeof(name), "exe:%s:%lu", inode->i_sb->s_id,
+		 inode->i_ino);
+	lra_start(current->tgid, name, true);
+}
+
+static pid_t lra_tgid(pid_t pid)
+{
+	struct task_struct *task;
+	pid_t tgid = 0;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(pid);
+	if (task)
+		tgid = task_tgid_nr(task);
+	rcu_read_unlock();
+	return tgid;
+}
+
+static ssize_t lra_control_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	char buf[LRA_NAME_LEN + 32];
+	char name[LRA_NAME_LEN];
+	char *cmd;
+	pid_t tgid;
+	int pid, ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	cmd = strim(buf);
+
+	/* %63s: LRA_NAME_LEN - 1 */
+	if (sscanf(cmd, "launch %d %63s", &pid, name) == 2 ||
+	    sscanf(cmd, "record %d %63s", &pid, name) == 2) {
+		tgid = lra_tgid(pid);
+		ret = tgid ? lra_start(tgid, name, cmd[0] == 'l') : -ESRCH;
+	} else if (sscanf(cmd, "drop %63s", name) == 1) {
+		ret = lra_drop(name);
+	} else if (!strcmp(cmd, "clear")) {
+		ret = lra_drop(NULL);
+	} else {
+		ret = -EINVAL;
+	}
+
+	return ret < 0 ? ret : count;
+}
+
+static const struct file_operations lra_control_fops = {
+	.write		= lra_control_write,
+	.llseek		= noop_llseek,
+};
+
+static int lra_profiles_show(struct seq_file *m, void *v)
+{
+	struct lra_profile *p;
+
+	seq_puts(m, "name files extents pages launches replay_io replay_cached miss wasted hit%\n");
+	mutex_lock(&lra_mutex);
+	list_for_each_entry(p, &lra_profiles, list) {
+		struct lra_stats *st = &p->st;
+		unsigned long replayed = st->replay_io + st->replay_cached;
+		unsigned long used = replayed > st->wasted ?
+				     replayed - st->wasted : 0;
+
+		seq_printf(m, "%s %u %u %lu %lu %lu %lu %lu %lu %lu\n",
+			   p->name, p->nr_files, p->nr_ext, p->pages,
+			   st->launches, st->replay_io, st->replay_cached,
+			   st->miss, st->wasted,
+			   used + st->miss ? used * 100 / (used + st->miss) : 0);
+	}
+	mutex_unlock(&lra_mutex);
+	return 0;
+}
+
+static int lra_profiles_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lra_profiles_show, NULL);
+}
+
+static const struct file_operations lra_profiles_fops = {
+	.open		= lra_profiles_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init launch_ra_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("launch_ra", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_u32("enable", S_IRUGO | S_IWUSR, root, &lra_enable);
+	debugfs_create_u32("exec", S_IRUGO | S_IWUSR, root, &lra_exec);
+	debugfs_create_u32("record_ms", S_IRUGO | S_IWUSR, root,
+			   &lra_record_ms);
+	debugfs_create_file("control", S_IWUSR, root, NULL, &lra_control_fops);
+	debugfs_create_file("profiles", S_IRUGO, root, NULL,
+			    &lra_profiles_fops);
+	return 0;
+}
+late_initcall(launch_ra_init);
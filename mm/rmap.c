@@ -822,6 +822,9 @@ struct page_referenced_arg {
 	int referenced;
 	unsigned long vm_flags;
 	struct mem_cgroup *memcg;
+#ifdef CONFIG_WORKINGSET_PROTECT
+	unsigned char ws_class;
+#endif
 };
 /*
  * arg: page_referenced_arg will be passed
@@ -887,6 +890,11 @@ static int page_referenced_one(struct page *page, struct vm_area_struct *vma,
 		pte_unmap_unlock(pte, ptl);
 	}
 
+#ifdef CONFIG_WORKINGSET_PROTECT
+	if (mm->ws_class && (!pra->ws_class || mm->ws_class < pra->ws_class))
+		pra->ws_class = mm->ws_class;
+#endif
+
 	if (referenced)
 		clear_page_idle(page);
 	if (test_and_clear_page_young(page))
@@ -925,20 +933,15 @@ static bool invalid_page_referenced_vma(struct vm_area_struct *vma, void *arg)
  * Quick test_and_clear_referenced for all mappings to a page,
  * returns the number of ptes which referenced the page.
  */
-int page_referenced(struct page *page,
-		    int is_locked,
-		    struct mem_cgroup *memcg,
-		    unsigned long *vm_flags)
+static int __page_referenced(struct page *page, int is_locked,
+			     struct page_referenced_arg *pra,
+			     unsigned long *vm_flags)
 {
 	int ret;
 	int we_locked = 0;
-	struct page_referenced_arg pra = {
-		.mapcount = page_mapcount(page),
-		.memcg = memcg,
-	};
 	struct rmap_walk_control rwc = {
 		.rmap_one = page_referenced_one,
-		.arg = (void *)&pra,
+		.arg = (void *)pra,
 		.anon_lock = page_lock_anon_vma_read,
 	};
 
@@ -960,19 +963,49 @@ int page_referenced(struct page *page,
 	 * counting on behalf of references from different
 	 * cgroups
 	 */
-	if (memcg) {
+	if (pra->memcg) {
 		rwc.invalid_vma = invalid_page_referenced_vma;
 	}
 
 	ret = rmap_walk(page, &rwc);
-	*vm_flags = pra.vm_flags;
+	*vm_flags = pra->vm_flags;
 
 	if (we_locked)
 		unlock_page(page);
 
-	return pra.referenced;
+	return pra->referenced;
 }
 
+int page_referenced(struct page *page,
+		    int is_locked,
+		    struct mem_cgroup *memcg,
+		    unsigned long *vm_flags)
+{
+	struct page_referenced_arg pra = {
+		.mapcount = page_mapcount(page),
+		.memcg = memcg,
+	};
+
+	return __page_referenced(page, is_locked, &pra, vm_flags);
+}
+
+#ifdef CONFIG_WORKINGSET_PROTECT
+int page_referenced_class(struct page *page, int is_locked,
+			  struct mem_cgroup *memcg, unsigned long *vm_flags,
+			  unsigned char *ws_class)
+{
+	struct page_referenced_arg pra = {
+		.mapcount = page_mapcount(page),
+		.memcg = memcg,
+	};
+	int referenced;
+
+	referenced = __page_referenced(page, is_locked, &pra, vm_flags);
+	*ws_class = pra.ws_class;
+	return referenced;
+}
+#endif
+
 static int page_mkclean_one(struct page *page, struct vm_area_struct *vma,
 			    unsigned long address, void *arg)
 {
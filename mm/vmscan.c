@@ -839,9 +839,10 @@ static enum page_references page_check_references(struct page *page,
 {
 	int referenced_ptes, referenced_page;
 	unsigned long vm_flags;
+	unsigned char ws_class;
 
-	referenced_ptes = page_referenced(page, 1, sc->target_mem_cgroup,
-					  &vm_flags);
+	referenced_ptes = page_referenced_class(page, 1, sc->target_mem_cgroup,
+						&vm_flags, &ws_class);
 	referenced_page = TestClearPageReferenced(page);
 
 	/*
@@ -851,6 +852,15 @@ static enum page_references page_check_references(struct page *page,
 	if (vm_flags & VM_LOCKED)
 		return PAGEREF_RECLAIM;
 
+	/*
+	 * Mapped file pages of a protected working set stay on the LRU,
+	 * on the active list if they are in use.
+	 */
+	if (page_is_file_cache(page) &&
+	    ws_protect_page(page, ws_class, sc->priority))
+		return referenced_ptes || referenced_page ?
+			PAGEREF_ACTIVATE : PAGEREF_KEEP;
+
 	if (referenced_ptes) {
 		if (PageSwapBacked(page))
 			return PAGEREF_ACTIVATE;
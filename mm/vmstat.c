@@ -824,6 +824,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_proactive_run",
+	"compact_proactive_success",
+	"compact_proactive_backoff",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
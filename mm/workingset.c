@@ -13,6 +13,8 @@
 #include <linux/fs.h>
 #include <linux/mm.h>
 
+#include "internal.h"
+
 /*
  *		Double CLOCK lists
  *
@@ -238,8 +240,10 @@ bool workingset_refault(void *shadow)
 
 	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
 		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		ws_protect_refault(true);
 		return true;
 	}
+	ws_protect_refault(false);
 	return false;
 }
 
@@ -0,0 +1,273 @@
+/*
+ * mm/ws_protect.c
+ *
+ * Working set protection
+ *
+ * Processes are sorted into classes by oom_score_adj, the same levels
+ * lowmemorykiller uses: a process belongs to the first class whose adj is
+ * not below its own oom_score_adj. Each class gets a reservation of
+ * min_kb, and while the mapped file pages of a class fit in it, reclaim
+ * leaves them on the LRU. When a class maps more than its reservation,
+ * only that share of its pages is spared, so the class does not keep
+ * more than min_kb away from reclaim. The last reclaim priority before
+ * the OOM killer ignores all reservations.
+ *
+ * For example, writing "-900,0" to /sys/module/ws_protect/parameters/adj
+ * and "16384,65536" to /sys/module/ws_protect/parameters/min_kb reserves
+ * 16MB for native daemons such as the audio server and 64MB for the
+ * foreground app. Per-class usage and refaults are in /proc/ws_protect.
+ *
+ * The class of each mm and the usage of each class are refreshed every
+ * WSP_UPDATE_INTERVAL by a deferrable work, outside of reclaim. Usage is
+ * counted like Pss, a page mapped by several processes is split between
+ * them, so shared libraries are not counted once per process. Reclaim
+ * learns the most important class mapping a page from the page_referenced()
+ * walk it does anyway.
+ */
+
+#include <linux/atomic.h>
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/mm_inline.h>
+#include <linux/module.h>
+#include <linux/oom.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
+
+#include "internal.h"
+
+#define WSP_MAX_CLASSES		4
+#define WSP_MAX_MMS		256
+#define WSP_UPDATE_INTERVAL	HZ
+/* fixed point fraction of a page in the Pss sums */
+#define WSP_PSS_SHIFT		12
+
+struct wsp_class_stat {
+	unsigned long usage;		/* mapped file pages */
+	atomic_t seq;
+	atomic_long_t protected;	/* pages spared by reclaim */
+	atomic_long_t refault;
+	atomic_long_t activate;		/* refaults of the working set */
+};
+
+static short wsp_adj[WSP_MAX_CLASSES] = {
+	-900,
+	0,
+};
+static int wsp_adj_size = 2;
+static int wsp_min_kb[WSP_MAX_CLASSES];
+static int wsp_min_kb_size = 2;
+
+static struct wsp_class_stat wsp_stat[WSP_MAX_CLASSES];
+
+/* mms of the protected classes, only used by wsp_update_fn() */
+static struct {
+	struct mm_struct *mm;
+	int class;
+} wsp_mms[WSP_MAX_MMS];
+
+static void wsp_update_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(wsp_update_work, wsp_update_fn);
+
+static int wsp_nr_classes(void)
+{
+	return min(wsp_adj_size, wsp_min_kb_size);
+}
+
+static int wsp_class(short oom_score_adj)
+{
+	int nr = wsp_nr_classes();
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (oom_score_adj <= wsp_adj[i])
+			return i;
+	return -1;
+}
+
+static bool wsp_enabled(void)
+{
+	int nr = wsp_nr_classes();
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (wsp_min_kb[i] > 0)
+			return true;
+	return false;
+}
+
+/* only file mappings hold pages reclaim may spare */
+static int wsp_test_walk(unsigned long start, unsigned long end,
+			 struct mm_walk *walk)
+{
+	return walk->vma->vm_file ? 0 : 1;
+}
+
+static int wsp_pmd_range(pmd_t *pmd, unsigned long addr, unsigned long end,
+			 struct mm_walk *walk)
+{
+	u64 *pss = walk->private;
+	spinlock_t *ptl;
+	pte_t *pte;
+
+	if (pmd_trans_huge(*pmd) || pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		struct page *page;
+
+		if (!pte_present(*pte))
+			continue;
+		page = vm_normal_page(walk->vma, addr, *pte);
+		if (!page || !page_is_file_cache(page))
+			continue;
+		*pss += (1U << WSP_PSS_SHIFT) / max(page_mapcount(page), 1);
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+	cond_resched();
+	return 0;
+}
+
+static void wsp_update_fn(struct work_struct *work)
+{
+	u64 usage[WSP_MAX_CLASSES] = { 0 };
+	struct task_struct *tsk;
+	int nr = 0, i;
+
+	if (!wsp_enabled())
+		goto out;
+
+	rcu_read_lock();
+	for_each_process(tsk) {
+		struct task_struct *p;
+		int c;
+
+		if (tsk->flags & PF_KTHREAD)
+			continue;
+
+		p = find_lock_task_mm(tsk);
+		if (!p)
+			continue;
+
+		c = wsp_class(p->signal->oom_score_adj);
+		p->mm->ws_class = c + 1;
+		if (c >= 0 && nr < WSP_MAX_MMS) {
+			atomic_inc(&p->mm->mm_users);
+			wsp_mms[nr].mm = p->mm;
+			wsp_mms[nr++].class = c;
+		}
+		task_unlock(p);
+	}
+	rcu_read_unlock();
+
+	for (i = 0; i < nr; i++) {
+		struct mm_struct *mm = wsp_mms[i].mm;
+		struct mm_walk walk = {
+			.pmd_entry = wsp_pmd_range,
+			.test_walk = wsp_test_walk,
+			.mm = mm,
+			.private = &usage[wsp_mms[i].class],
+		};
+
+		down_read(&mm->mmap_sem);
+		walk_page_range(0, mm->highest_vm_end, &walk);
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+	}
+
+	for (i = 0; i < WSP_MAX_CLASSES; i++)
+		wsp_stat[i].usage = usage[i] >> WSP_PSS_SHIFT;
+out:
+	schedule_delayed_work(&wsp_update_work, WSP_UPDATE_INTERVAL);
+}
+
+/*
+ * Returns true if reclaim should spare @page, a locked file page, for the
+ * working set of @ws_class, 1 + the most important class mapping it as
+ * found by page_referenced_class().
+ */
+bool ws_protect_page(struct page *page, unsigned char ws_class, int priority)
+{
+	struct wsp_class_stat *st;
+	unsigned long min_pages;
+
+	if (!priority || !ws_class || ws_class > wsp_nr_classes() ||
+	    !wsp_enabled())
+		return false;
+
+	st = &wsp_stat[ws_class - 1];
+	min_pages = (unsigned long)max(wsp_min_kb[ws_class - 1], 0) >>
+		    (PAGE_SHIFT - 10);
+	if (!min_pages)
+		return false;
+	if (st->usage > min_pages &&
+	    (unsigned int)atomic_inc_return(&st->seq) % st->usage >= min_pages)
+		return false;
+
+	atomic_long_inc(&st->protected);
+	return true;
+}
+
+/* Accounts a refault to the class of the task faulting the page back in */
+void ws_protect_refault(bool activate)
+{
+	int c;
+
+	if (current->flags & PF_KTHREAD)
+		return;
+
+	c = wsp_class(current->signal->oom_score_adj);
+	if (c < 0)
+		return;
+
+	atomic_long_inc(&wsp_stat[c].refault);
+	if (activate)
+		atomic_long_inc(&wsp_stat[c].activate);
+}
+
+static int ws_protect_show(struct seq_file *m, void *v)
+{
+	int nr = wsp_nr_classes();
+	int i;
+
+	seq_puts(m, "adj min_kb usage_kb protected refault refault_activate\n");
+	for (i = 0; i < nr; i++) {
+		struct wsp_class_stat *st = &wsp_stat[i];
+
+		seq_printf(m, "%d %d %lu %ld %ld %ld\n",
+			   wsp_adj[i], wsp_min_kb[i],
+			   st->usage << (PAGE_SHIFT - 10),
+			   atomic_long_read(&st->protected),
+			   atomic_long_read(&st->refault),
+			   atomic_long_read(&st->activate));
+	}
+	return 0;
+}
+
+static int ws_protect_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ws_protect_show, NULL);
+}
+
+static const struct file_operations ws_protect_fops = {
+	.open		= ws_protect_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ws_protect_init(void)
+{
+	proc_create("ws_protect", S_IRUGO, NULL, &ws_protect_fops);
+	schedule_delayed_work(&wsp_update_work, WSP_UPDATE_INTERVAL);
+	return 0;
+}
+module_init(ws_protect_init);
+
+module_param_array_named(adj, wsp_adj, short, &wsp_adj_size,
+			 S_IRUGO | S_IWUSR);
+module_param_array_named(min_kb, wsp_min_kb, int, &wsp_min_kb_size,
+			 S_IRUGO | S_IWUSR);
@@ -20,6 +20,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/firmware.h>
 #include <linux/gpio.h>
+#include <linux/interrupt.h>
 #include <linux/of_gpio.h>
 #include <linux/ktime.h>
 #include <linux/spinlock.h>
@@ -37,6 +38,12 @@
 #include "dough.h"
 #include "amzn-mt-spi-pcm.h"
 
+#ifdef CONFIG_MTPROF
+#include "bootprof.h"
+#else
+#define log_boot(str) do { } while (0)
+#endif
+
 /* Debugging Purpose:: Use this mode to enable FPGA Test Pattern.
  * Keep it off for audio
  * #define FPGA_TEST_PATTERN_ENABLE
@@ -60,6 +67,7 @@
 #define SPI_SETUP_BUF_SIZE 32
 #define FPGA_VCC_DELAY_MS 10
 #define CDONE_MAX_READS 10
+#define CDONE_TIMEOUT_MS 10
 
 enum PINCTRL_PIN_STATE {
 	PIN_STATE_DEFAULT = 0,
@@ -451,7 +459,7 @@ static void print_raw24(uint8_t *buf, size_t len)
 #endif
 
 static int spi_txrx(struct spi_device *spi, void *txb, void *rxb, int len,
-			int dma_enable, dma_addr_t paddr)
+			int dma_enable, dma_addr_t tx_paddr, dma_addr_t rx_paddr)
 {
 	struct spi_message msg = {};
 	struct spi_transfer xfer = {};
@@ -465,7 +473,8 @@ static int spi_txrx(struct spi_device *spi, void *txb, void *rxb, int len,
 
 	if (dma_enable) {
 		msg.is_dma_mapped = 1;
-		xfer.rx_dma = paddr;
+		xfer.tx_dma = tx_paddr;
+		xfer.rx_dma = rx_paddr;
 	}
 
 	spi_message_add_tail(&xfer, &msg);
@@ -535,6 +544,9 @@ static void spi_data_read(struct work_struct *work)
 	struct snd_soc_pcm_runtime *soc_runtime = ss->private_data;
 	struct spi_device *spi = to_spi_device(soc_runtime->platform->dev);
 	struct dough_frame *tx_df = 0, *rx_df = 0;
+	struct device *dma_dev = spi->master->dev.parent;
+	dma_addr_t tx_paddr = 0, rx_paddr = 0;
+	bool premapped = spi->master->flags & SPI_MASTER_DMA_PREMAPPED;
 	void *dst_ptr, *src_ptr;
 	size_t n_bytes, bytes, copied, elapsed_threshold;
 	struct task_struct *kworker_task;
@@ -553,6 +565,26 @@ static void spi_data_read(struct work_struct *work)
 		pr_err("%s: Failed to allocate spi buffer\n", __func__);
 		return;
 	}
+#endif
+	/* the frames are mapped once and reused for the whole stream */
+	if (premapped) {
+		tx_paddr = dma_map_single(dma_dev, tx_df, sizeof(*tx_df),
+					  DMA_TO_DEVICE);
+		if (dma_mapping_error(dma_dev, tx_paddr))
+			premapped = false;
+	}
+#ifdef SPI_USES_LOCAL_DMA
+	rx_paddr = spi_data.dma_paddr;
+#else
+	if (premapped) {
+		rx_paddr = dma_map_single(dma_dev, rx_df, sizeof(*rx_df),
+					  DMA_FROM_DEVICE);
+		if (dma_mapping_error(dma_dev, rx_paddr)) {
+			dma_unmap_single(dma_dev, tx_paddr, sizeof(*tx_df),
+					 DMA_TO_DEVICE);
+			premapped = false;
+		}
+	}
 #endif
 	spi_priv_data->elapsed = 0;
 	spi_priv_data->cur_write_offset = 0;
@@ -580,11 +612,19 @@ static void spi_data_read(struct work_struct *work)
 	while (get_run_thread()) {
 #ifdef SPI_USES_LOCAL_DMA
 		ret = spi_txrx(spi, (void *)tx_df, spi_data.dma_vaddr,
-			sizeof(struct dough_frame), 1, spi_data.dma_paddr);
+			sizeof(struct dough_frame), premapped, tx_paddr,
+			rx_paddr);
 		rx_df = (struct dough_frame *)spi_data.dma_vaddr;
 #else
+		if (premapped)
+			dma_sync_single_for_device(dma_dev, rx_paddr,
+					sizeof(*rx_df), DMA_FROM_DEVICE);
 		ret = spi_txrx(spi, (void *)tx_df, (void *) rx_df,
-				sizeof(struct dough_frame), 0, 0);
+				sizeof(struct dough_frame), premapped,
+				tx_paddr, rx_paddr);
+		if (premapped)
+			dma_sync_single_for_cpu(dma_dev, rx_paddr,
+					sizeof(*rx_df), DMA_FROM_DEVICE);
 #endif
 		if (ret < 0) {
 			pr_err("%s: Failed to rx SPI audio\n", __func__);
@@ -743,6 +783,14 @@ delay:
 	}
 
 fail:
+	if (premapped) {
+		dma_unmap_single(dma_dev, tx_paddr, sizeof(*tx_df),
+				 DMA_TO_DEVICE);
+#ifndef SPI_USES_LOCAL_DMA
+		dma_unmap_single(dma_dev, rx_paddr, sizeof(*rx_df),
+				 DMA_FROM_DEVICE);
+#endif
+	}
 	kfree(rx_df);
 	kfree(tx_df);
 
@@ -906,9 +954,17 @@ static const struct snd_soc_component_driver amzn_mt_spi_cpu_dai_component = {
 	.name = "amzn-mt-spi-cpu-dai",
 };
 
+/* CDONE goes high once the FPGA has taken the whole bitstream */
+static irqreturn_t fpga_cdone_isr(int irq, void *dev_id)
+{
+	complete(dev_id);
+	return IRQ_HANDLED;
+}
+
 static int amzn_mt_spi_probe(struct spi_device *spi)
 {
-	int rc = 0, rst_gpio, cdone_gpio, i, cdone_value;
+	int rc = 0, rst_gpio, cdone_gpio, cdone_irq, i, cdone_value;
+	DECLARE_COMPLETION_ONSTACK(cdone);
 	const struct firmware *fw_entry;
 	struct device_node *node;
 	struct dough_frame *tx_df, *rx_df;
@@ -922,6 +978,7 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 #endif
 
 	pr_info("%s\n", __func__);
+	log_boot("amzn-mt-spi-pcm: probe");
 
 #ifdef CONFIG_abe123
 	/* VCCIO2 Enabled */
@@ -1056,6 +1113,18 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 	}
 	gpio_direction_input(cdone_gpio);
 
+	/* Fall back to polling CDONE if it can't interrupt */
+	cdone_irq = gpio_to_irq(cdone_gpio);
+	if (cdone_irq >= 0) {
+		rc = request_irq(cdone_irq, fpga_cdone_isr, IRQF_TRIGGER_RISING,
+				"fpga-cdone", &cdone);
+		if (rc) {
+			pr_warn("%s: CDONE irq %d request failed %d\n",
+				__func__, cdone_irq, rc);
+			cdone_irq = -1;
+		}
+	}
+
 	/* SET CS to low. CSK to high */
 	if (!IS_ERR(spi_data.pin_states[PIN_STATE_PRE_DOWNLOAD])) {
 		rc = pinctrl_select_state(spi_data.pinctrl,
@@ -1063,11 +1132,11 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 		if (rc) {
 			pr_err("%s: failed to PIN_STATE_PRE_DOWNLOAD state %d\n",
 			__func__, rc);
-			goto free_cgpio;
+			goto free_cirq;
 		}
 	} else {
 		pr_err("%s: Unable to find PIN_STATE_PRE_DOWNLOAD\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	/*
@@ -1079,10 +1148,11 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 	rc = spi_setup(spi);
 	if (rc < 0) {
 		pr_err("%s: SPI setup failed\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
-    /* Reset FPGA */
+	/* Reset FPGA */
+	log_boot("amzn-mt-spi-pcm: fpga reset");
 	gpio_set_value(rst_gpio, 0);
 	msleep(FPGA_DELAY_MS);
 	gpio_set_value(rst_gpio, 1);
@@ -1095,21 +1165,21 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 		if (rc) {
 			pr_err("%s: failed to PIN_STATE_SPI_SS_HIGH state %d\n",
 			__func__, rc);
-			goto free_cgpio;
+			goto free_cirq;
 		}
 	} else {
 		pr_err("%s: Unable to find PIN_STATE_SPI_SS_HIGH\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	/* 8 dummy clk cycles */
 	/* There isn't a way to generate 8 cycles from spi driver. This
 	 * doesn't seem to cause issue eihter. Enable if needed
 	rc = spi_txrx(spi, (void *)tx_df, (void *)rx_df,
-			1, 0, 0);
+			1, 0, 0, 0);
 	if (rc < 0) {
 		pr_err("%s: Failed to send dummy cycles\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 	*/
 
@@ -1125,18 +1195,18 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 		if (rc) {
 			pr_err("%s: failed to PIN_STATE_SPI_SS_LOW state %d\n",
 			__func__, rc);
-			goto free_cgpio;
+			goto free_cirq;
 		}
 	} else {
 		pr_err("%s: Unable to find PIN_STATE_SPI_SS_LOW\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	/* Now load the actual firmware */
 	rc = request_firmware(&fw_entry, FPGA_FIRMWARE_NAME, &spi->dev);
 	if (rc) {
 		pr_err("%s: FPGA Firmware couldn't be requested\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	bytes = roundup(fw_entry->size, 1024) + 1024;
@@ -1144,28 +1214,44 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 		pr_err("%s: FPGA firmware too big\n", __func__);
 		rc = -1;
 		release_firmware(fw_entry);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
-	memcpy(fw_buf, (void *)fw_entry->data, bytes);
+	/* fw_buf is zeroed, the tail pads the bitstream with dummy clocks */
+	memcpy(fw_buf, (void *)fw_entry->data, fw_entry->size);
+	log_boot("amzn-mt-spi-pcm: bitstream loaded");
 
-	rc = spi_txrx(spi, fw_buf, NULL, bytes, 0, 0);
+	/*
+	 * One transfer for the whole bitstream: it is a multiple of the 1K
+	 * packet size, so spi-mt65xx sends it as a single DMA burst.
+	 */
+	rc = spi_txrx(spi, fw_buf, NULL, bytes, 0, 0, 0);
 	if (rc < 0) {
 		pr_err("%s: FPGA load failed to initiate sync SPI transfer error %d\n",
 			__func__, rc);
 		release_firmware(fw_entry);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 	release_firmware(fw_entry);
-
-	while (i < CDONE_MAX_READS) {
+	log_boot("amzn-mt-spi-pcm: bitstream sent");
+
+	if (cdone_irq >= 0) {
+		if (!gpio_get_value(cdone_gpio))
+			wait_for_completion_timeout(&cdone,
+					msecs_to_jiffies(CDONE_TIMEOUT_MS));
+		free_irq(cdone_irq, &cdone);
+		cdone_irq = -1;
 		cdone_value = gpio_get_value(cdone_gpio);
-		pr_info("%s: CDONE FPGA = %d\n", __func__, cdone_value);
-		if (cdone_value)
-			break;
-		msleep(1);
-		i++;
+	} else {
+		for (i = 0; i < CDONE_MAX_READS; i++) {
+			cdone_value = gpio_get_value(cdone_gpio);
+			if (cdone_value)
+				break;
+			msleep(1);
+		}
 	}
+	pr_info("%s: CDONE FPGA = %d\n", __func__, cdone_value);
+	log_boot("amzn-mt-spi-pcm: fpga configured");
 	msleep(PINCTRL_DELAY_MS);
 
 	/* SPI_SS CS */
@@ -1175,24 +1261,24 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 		if (rc) {
 			pr_err("%s: failed to PIN_STATE_SPI_SS_CS state %d\n",
 			__func__, rc);
-			goto free_cgpio;
+			goto free_cirq;
 		}
 	} else {
 		pr_err("%s: Unable to find PIN_STATE_SPI_SS_CS\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	/* Verify FW is active and reporting correct version */
 	rc = spi_txrx(spi, (void *)tx_df, (void *)rx_df,
-		sizeof(struct dough_frame), 0, 0);
+		sizeof(struct dough_frame), 0, 0, 0);
 	if (rc < 0) {
 		pr_err("%s: Failed to get FPGA rev version\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	if (!verify_fpga_frm_ver(rx_df->dsf.fpga_rev)) {
 		rc = -EINVAL;
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	pr_info("%s: FPGA Revision = %u\n", __func__, rx_df->dsf.fpga_rev);
@@ -1203,10 +1289,10 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 #else
 	buf[0] = dough_fw_i2s;
 #endif
-	rc = spi_txrx(spi, buf, NULL, SPI_SETUP_BUF_SIZE, 0, 0);
+	rc = spi_txrx(spi, buf, NULL, SPI_SETUP_BUF_SIZE, 0, 0, 0);
 	if (rc < 0) {
 		pr_err("%s: failed to initiate async SPI transfer\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	/*
@@ -1220,7 +1306,7 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 			ARRAY_SIZE(amzn_mt_spi_cpu_dai));
 	if (rc < 0) {
 		pr_err("%s: cpu dai component registration error\n", __func__);
-		goto free_cgpio;
+		goto free_cirq;
 	}
 
 	/*
@@ -1228,7 +1314,12 @@ static int amzn_mt_spi_probe(struct spi_device *spi)
 	 * and makes it available in "platform_name" for the machine driver.
 	 */
 	rc = snd_soc_register_platform(&spi->dev, &amzn_mt_spi_pltfm_drv);
+	if (!rc)
+		log_boot("amzn-mt-spi-pcm: pcm registered");
 
+free_cirq:
+	if (cdone_irq >= 0)
+		free_irq(cdone_irq, &cdone);
 free_cgpio:
 	gpio_free(cdone_gpio);
 free_rgpio:
@@ -1266,6 +1357,8 @@ static struct spi_driver amzn_mt_spi_driver = {
 		.owner = THIS_MODULE,
 		.of_match_table = of_match_ptr(amzn_mt_spi_dt_ids),
 		.bus = &spi_bus_type,
+		/* FPGA download overlaps the rest of boot */
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 	.probe = amzn_mt_spi_probe,
 	.remove = amzn_mt_spi_remove,